@@ -0,0 +1,70 @@
+#
+# Pre-build script: prepare the web UI for the filesystem image.
+#
+# When a filesystem image is built (`pio run -t buildfs` / `uploadfs`), data/
+# is staged into the build directory and the image is made from that copy:
+#   - web assets (.html, .js, .css, .ico, .svg) are stored gzip-compressed as
+#     "<name>.gz" in place of the original (unless that would not be smaller),
+#   - /assets.json lists each of them with a content hash, served as its ETag,
+#     and marks bundles whose file name already carries a hash (webpack's
+#     app.<hash>.js) immutable.
+# Everything else (the *.json configs the firmware rewrites) is copied as is.
+# See src/static_assets.h for the serving side.
+#
+import gzip
+import hashlib
+import json
+import os
+import re
+import shutil
+
+from SCons.Script import COMMAND_LINE_TARGETS
+
+Import("env")
+
+COMPRESSED_TYPES = (".html", ".htm", ".js", ".css", ".ico", ".svg")
+HASHED_NAME = re.compile(r"\.[0-9a-f]{8,}\.[A-Za-z0-9]+$")
+FS_TARGETS = {"buildfs", "uploadfs", "uploadfsota"}
+MANIFEST = "assets.json"
+
+
+def stage_assets(source, target):
+    if os.path.isdir(target):
+        shutil.rmtree(target)
+    manifest = {}
+    saved = 0
+    for root, _, files in os.walk(source):
+        for name in sorted(files):
+            src = os.path.join(root, name)
+            rel = os.path.relpath(src, source)
+            dst = os.path.join(target, rel)
+            os.makedirs(os.path.dirname(dst), exist_ok=True)
+            if not name.lower().endswith(COMPRESSED_TYPES):
+                shutil.copy2(src, dst)
+                continue
+
+            with open(src, "rb") as f:
+                data = f.read()
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            use_gzip = len(packed) < len(data)
+            with open(dst + ".gz" if use_gzip else dst, "wb") as f:
+                f.write(packed if use_gzip else data)
+            if use_gzip:
+                saved += len(data) - len(packed)
+
+            manifest["/" + rel.replace(os.sep, "/")] = {
+                "etag": hashlib.sha256(data).hexdigest()[:16],
+                "gzip": use_gzip,
+                "immutable": bool(HASHED_NAME.search(name)),
+            }
+
+    with open(os.path.join(target, MANIFEST), "w") as f:
+        json.dump(manifest, f, separators=(",", ":"), sort_keys=True)
+    print("Web assets: %d staged, %d KiB saved by gzip"
+          % (len(manifest), saved // 1024))
+
+
+if FS_TARGETS & set(COMMAND_LINE_TARGETS):
+    staged = os.path.join(env.subst("$BUILD_DIR"), "data")
+    stage_assets(env.subst("$PROJECT_DATA_DIR"), staged)
+    env.Replace(PROJECT_DATA_DIR=staged)
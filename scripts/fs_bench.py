@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# Filesystem benchmark of a keypad over USB serial. Sends FS_BENCH, which
+# times exists / open / read / write of the config files on the mounted
+# backend, and prints the averages. Save a run from a LittleFS build and one
+# from a SPIFFS build (-D STORAGE_SPIFFS) to compare the two.
+#
+#   scripts/fs_bench.py /dev/cu.usbmodem1101
+#   scripts/fs_bench.py /dev/ttyACM0 --save littlefs.json
+#   scripts/fs_bench.py --compare spiffs.json littlefs.json
+#
+# Needs pyserial (pip install pyserial) to talk to the device.
+#
+import argparse
+import json
+import sys
+import time
+
+BEGIN = "<<<BENCH_BEGIN>>>"
+END = "<<<BENCH_END>>>"
+OPERATIONS = ["existsUs", "openUs", "readUs", "writeUs"]
+
+
+def run(port, baud, timeout):
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required: pip install pyserial")
+
+    with serial.Serial(port, baud, timeout=0.2) as device:
+        device.reset_input_buffer()
+        device.write(b"FS_BENCH\n")
+        output = ""
+        deadline = time.monotonic() + timeout
+        while END not in output:
+            if time.monotonic() > deadline:
+                sys.exit("no benchmark result from %s" % port)
+            output += device.read(256).decode("utf-8", "replace")
+    return json.loads(output.split(BEGIN, 1)[1].split(END, 1)[0])
+
+
+def report(result):
+    print("%s, %d rounds" % (result["backend"], result["rounds"]))
+    print("%-16s %8s" % ("file", "bytes") +
+          "".join("%10s" % op[:-2] for op in OPERATIONS))
+    for name, timing in sorted(result.get("files", {}).items()):
+        print("%-16s %8d" % (name, timing["bytes"]) +
+              "".join("%7d us" % timing[op] for op in OPERATIONS))
+
+
+def compare(before, after):
+    print("%s -> %s (time ratio, lower is faster)" %
+          (before["backend"], after["backend"]))
+    print("%-16s" % "file" + "".join("%10s" % op[:-2] for op in OPERATIONS))
+    for name, old in sorted(before.get("files", {}).items()):
+        new = after.get("files", {}).get(name)
+        if not new:
+            continue
+        print("%-16s" % name +
+              "".join("%9.2fx" % (new[op] / max(old[op], 1))
+                      for op in OPERATIONS))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Config file latency on the keypad filesystem.")
+    parser.add_argument("port", nargs="?", help="serial port of the keypad")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=30,
+                        help="seconds to wait for the result")
+    parser.add_argument("--save", help="also write the result to this file")
+    parser.add_argument("--compare", nargs=2, metavar=("BEFORE", "AFTER"),
+                        help="compare two saved results instead")
+    args = parser.parse_args()
+
+    if args.compare:
+        with open(args.compare[0]) as a, open(args.compare[1]) as b:
+            compare(json.load(a), json.load(b))
+        return
+    if not args.port:
+        parser.error("a serial port (or --compare) is required")
+
+    result = run(args.port, args.baud, args.timeout)
+    report(result)
+    if args.save:
+        with open(args.save, "w") as out:
+            json.dump(result, out, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+#
+# HTTP load test for the configuration server on a running keypad (Wi-Fi
+# mode). Replays what the web UI does on page load -- the page, its assets
+# and the API calls, all at once -- from several parallel clients, and
+# reports per-path latency, bytes on the wire and overall throughput. Run it
+# against the old and the new firmware to compare.
+#
+# Requests ask for gzip like a browser does. With --revalidate each path is
+# fetched once for its ETag and then requested conditionally (If-None-Match),
+# which is what a browser reloading the page sends; 304 counts as success.
+#
+#   scripts/http_load_test.py schnell.local
+#   scripts/http_load_test.py schnell.local --revalidate
+#   scripts/http_load_test.py 192.168.4.1 -c 8 -n 200 --path /api/config
+#
+# Standard library only.
+#
+import argparse
+import concurrent.futures
+import gzip
+import re
+import time
+import urllib.error
+import urllib.request
+
+API_PATHS = ["/api/config", "/api/network", "/api/spiffs"]
+OK_STATUS = (200, 304)
+
+
+def fetch(base, path, timeout, etag=None):
+    headers = {"Accept-Encoding": "gzip"}
+    if etag:
+        headers["If-None-Match"] = etag
+    request = urllib.request.Request(base + path, headers=headers)
+    start = time.perf_counter()
+    try:
+        with urllib.request.urlopen(request, timeout=timeout) as response:
+            size = len(response.read())
+            status = response.status
+    except urllib.error.HTTPError as err:
+        size, status = 0, err.code
+    except Exception:
+        size, status = 0, None
+    return path, status, size, time.perf_counter() - start
+
+
+def page_paths(base, timeout):
+    """The page, the local files it references, and the API calls."""
+    # The firmware sends stored .gz assets whatever the client accepts
+    request = urllib.request.Request(base + "/",
+                                     headers={"Accept-Encoding": "gzip"})
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        body = response.read()
+        if response.headers.get("Content-Encoding") == "gzip":
+            body = gzip.decompress(body)
+    html = body.decode("utf-8", "replace")
+    assets = re.findall(r'(?:src|href)="(/[^"/][^"]*)"', html)
+    return ["/"] + sorted(set(assets)) + API_PATHS
+
+
+def etag_of(base, path, timeout):
+    request = urllib.request.Request(base + path,
+                                     headers={"Accept-Encoding": "gzip"})
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        response.read()
+        return response.headers.get("ETag")
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(fraction * len(sorted_values)))
+    return sorted_values[index]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Load test the keypad configuration server")
+    parser.add_argument("host", help="keypad address, e.g. schnell.local")
+    parser.add_argument("-c", "--concurrency", type=int, default=4,
+                        help="parallel clients (default 4)")
+    parser.add_argument("-n", "--rounds", type=int, default=50,
+                        help="times each path is requested (default 50)")
+    parser.add_argument("--path", action="append",
+                        help="path to request (repeatable; default: the "
+                             "web UI page, its assets and API calls)")
+    parser.add_argument("--revalidate", action="store_true",
+                        help="send If-None-Match with each path's ETag")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+
+    base = args.host if "://" in args.host else "http://" + args.host
+    paths = args.path or page_paths(base, args.timeout)
+    etags = {}
+    if args.revalidate:
+        etags = {p: etag_of(base, p, args.timeout) for p in paths}
+    jobs = [p for _ in range(args.rounds) for p in paths]
+
+    results = []
+    started = time.perf_counter()
+    with concurrent.futures.ThreadPoolExecutor(args.concurrency) as pool:
+        futures = [pool.submit(fetch, base, p, args.timeout, etags.get(p))
+                   for p in jobs]
+        for future in concurrent.futures.as_completed(futures):
+            results.append(future.result())
+    elapsed = time.perf_counter() - started
+
+    print(f"{len(results)} requests, {args.concurrency} clients, "
+          f"{elapsed:.2f} s")
+    print(f"{'path':<24} {'ok':>5} {'err':>5} {'p50 ms':>8} {'p95 ms':>8} "
+          f"{'max ms':>8} {'KiB':>8}")
+    for path in paths:
+        mine = [r for r in results if r[0] == path]
+        ok = [r for r in mine if r[1] in OK_STATUS]
+        latencies = sorted(r[3] * 1000 for r in ok)
+        kib = sum(r[2] for r in ok) / 1024
+        print(f"{path:<24} {len(ok):>5} {len(mine) - len(ok):>5} "
+              f"{percentile(latencies, 0.5):>8.1f} "
+              f"{percentile(latencies, 0.95):>8.1f} "
+              f"{(latencies[-1] if latencies else 0):>8.1f} {kib:>8.1f}")
+    ok_total = sum(1 for r in results if r[1] in OK_STATUS)
+    print(f"throughput: {ok_total / elapsed:.1f} req/s")
+
+
+if __name__ == "__main__":
+    main()
@@ -3,8 +3,8 @@
 # flashable image at offset 0x0.
 #
 # Defining the target here is cheap; the merge only runs when explicitly
-# invoked with `pio run -t mergebin`. The filesystem image (SPIFFS) is NOT
-# merged in -- it is released separately as spiffs.bin.
+# invoked with `pio run -t mergebin`. The filesystem image (LittleFS) is NOT
+# merged in -- it is released separately as littlefs.bin.
 #
 from os.path import join
 
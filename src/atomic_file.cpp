@@ -0,0 +1,135 @@
+#include "atomic_file.h"
+
+#include <Preferences.h>
+#include <esp_rom_crc.h>
+
+#include "file_stream.h"
+
+namespace {
+// Updated from the loop, the input task and the HTTP server
+AtomicFile::Stats gStats = {0, 0, 0};
+
+const char *const kWearNamespace = "wear";
+
+String backupPath(const char *path) { return String(path) + ".bak"; }
+
+// NVS key for a file: its name, cut to the 15 characters NVS allows
+String wearKey(const char *path) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    return String(name).substring(0, 15);
+}
+
+void countWrite(const char *path) {
+    __atomic_fetch_add(&gStats.writes, 1, __ATOMIC_RELAXED);
+    Preferences wear;
+    if (!wear.begin(kWearNamespace)) return;
+    String key = wearKey(path);
+    wear.putUInt(key.c_str(), wear.getUInt(key.c_str(), 0) + 1);
+    wear.end();
+}
+}  // namespace
+
+namespace AtomicFile {
+
+size_t CrcPrint::write(const uint8_t *data, size_t size) {
+    size_t written = out_.write(data, size);
+    crc_ = esp_rom_crc32_le(crc_, data, written);
+    size_ += written;
+    return written;
+}
+
+String tempPath(const char *path) { return String(path) + ".tmp"; }
+
+bool verify(FS &fs, const char *path, uint32_t crc, size_t size) {
+    String temp = tempPath(path);
+    bool ok = false;
+    File file = fs.open(temp, FILE_READ);
+    if (file && size != SIZE_MAX && file.size() == size) {
+        uint8_t chunk[FileStream::kChunkSize];
+        uint32_t readCrc = 0;
+        for (;;) {
+            size_t read = file.read(chunk, sizeof(chunk));
+            if (read == 0) break;
+            readCrc = esp_rom_crc32_le(readCrc, chunk, read);
+        }
+        ok = readCrc == crc;
+    }
+    if (file) file.close();
+    if (!ok) {
+        fs.remove(temp);
+        __atomic_fetch_add(&gStats.failures, 1, __ATOMIC_RELAXED);
+        Serial.println("AtomicFile: write of " + String(path) + " failed");
+    }
+    return ok;
+}
+
+bool install(FS &fs, const char *path) {
+    return install(fs, tempPath(path).c_str(), path);
+}
+
+/**
+ * The current version is moved to .bak first: it is the fallback, and
+ * SPIFFS cannot rename over an existing file anyway. If the power goes
+ * between the two renames, recover() brings the .bak back on the next boot.
+ *
+ */
+bool install(FS &fs, const char *from, const char *path) {
+    String backup = backupPath(path);
+    bool hadCurrent = fs.exists(path);
+    if (hadCurrent) {
+        fs.remove(backup);
+        if (!fs.rename(path, backup)) {
+            fs.remove(from);
+            __atomic_fetch_add(&gStats.failures, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    }
+    if (!fs.rename(from, path)) {
+        if (hadCurrent) fs.rename(backup, path);
+        fs.remove(from);
+        __atomic_fetch_add(&gStats.failures, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    countWrite(path);
+    return true;
+}
+
+bool copy(FS &fs, const char *from, const char *to) {
+    return write(fs, to, [&](Print &out) {
+        File in = fs.open(from, FILE_READ);
+        if (!in) return false;
+        size_t size = in.size();
+        bool complete = FileStream::copy(in, out) == size;
+        in.close();
+        return complete;
+    });
+}
+
+bool restore(FS &fs, const char *path) {
+    String backup = backupPath(path);
+    if (!fs.exists(backup)) return false;
+    fs.remove(path);
+    if (!fs.rename(backup, path)) return false;
+    __atomic_fetch_add(&gStats.rollbacks, 1, __ATOMIC_RELAXED);
+    Serial.println("AtomicFile: restored previous " + String(path));
+    return true;
+}
+
+void recover(FS &fs, const char *path) {
+    String temp = tempPath(path);
+    if (fs.exists(temp)) fs.remove(temp);
+    if (!fs.exists(path)) restore(fs, path);
+}
+
+uint32_t writeCount(const char *path) {
+    Preferences wear;
+    if (!wear.begin(kWearNamespace, true)) return 0;
+    uint32_t count = wear.getUInt(wearKey(path).c_str(), 0);
+    wear.end();
+    return count;
+}
+
+const Stats &stats() { return gStats; }
+
+}  // namespace AtomicFile
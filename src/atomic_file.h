@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Crash-safe replacement of config files. A new version is written to
+// "<path>.tmp", read back and checked against the CRC-32 of what was
+// written, and only then renamed into place; the version it replaces stays
+// behind as "<path>.bak", the fallback for restore(). A brownout at any
+// point leaves the old or the new file intact, and recover() finishes an
+// interrupted swap on the next boot. Each replacement is counted per file
+// in NVS as a flash wear indicator.
+namespace AtomicFile {
+
+struct Stats {
+    uint32_t writes;     // files replaced
+    uint32_t failures;   // writes abandoned (short write, bad read-back)
+    uint32_t rollbacks;  // files restored from .bak
+};
+
+// Print that forwards to a file and keeps a CRC-32 of what went through.
+class CrcPrint : public Print {
+   public:
+    explicit CrcPrint(Print &out) : out_(out), crc_(0), size_(0) {}
+    size_t write(uint8_t byte) override { return write(&byte, 1); }
+    size_t write(const uint8_t *data, size_t size) override;
+    uint32_t crc() const { return crc_; }
+    size_t size() const { return size_; }
+
+   private:
+    Print &out_;
+    uint32_t crc_;
+    size_t size_;
+};
+
+String tempPath(const char *path);
+// Check the written "<path>.tmp" against `crc` / `size` (SIZE_MAX: the
+// write itself failed); removes it and counts a failure if it does not
+// match.
+bool verify(FS &fs, const char *path, uint32_t crc, size_t size);
+
+// Write "<path>.tmp" with produce(Print &out) -> bool and verify it.
+template <typename Produce>
+bool prepare(FS &fs, const char *path, Produce produce) {
+    String temp = tempPath(path);
+    File file = fs.open(temp, FILE_WRITE);
+    if (!file) return verify(fs, path, 0, SIZE_MAX);
+    CrcPrint out(file);
+    bool produced = produce(static_cast<Print &>(out));
+    file.close();
+    return verify(fs, path, out.crc(), produced ? out.size() : SIZE_MAX);
+}
+
+// Swap a prepared "<path>.tmp" (or any finished file `from`) into place,
+// keeping the current version as "<path>.bak". On a failed rename the
+// current version is put back.
+bool install(FS &fs, const char *path);
+bool install(FS &fs, const char *from, const char *path);
+
+// prepare() + install().
+template <typename Produce>
+bool write(FS &fs, const char *path, Produce produce) {
+    return prepare(fs, path, produce) && install(fs, path);
+}
+
+// Replace `to` with a copy of `from`, in FileStream blocks.
+bool copy(FS &fs, const char *from, const char *to);
+
+// Put "<path>.bak" back in place of `path`.
+bool restore(FS &fs, const char *path);
+// Boot-time cleanup after an interrupted swap: bring back "<path>.bak" if
+// `path` is missing, drop a stale "<path>.tmp".
+void recover(FS &fs, const char *path);
+
+// Times `path` has been replaced, across reboots.
+uint32_t writeCount(const char *path);
+const Stats &stats();
+
+}  // namespace AtomicFile
@@ -12,17 +12,11 @@ namespace BleHid {
 
 void begin() { bleKeyboard.begin(); }
 
-void press(uint8_t keyStroke) { bleKeyboard.press(keyStroke); }
-
-void release(uint8_t keyStroke) { bleKeyboard.release(keyStroke); }
-
-void write(uint8_t keyStroke) { bleKeyboard.write(keyStroke); }
-
-void releaseAll() { bleKeyboard.releaseAll(); }
-
-void print(const String &text) { bleKeyboard.print(text); }
-
-void println(const String &text) { bleKeyboard.println(text); }
+void sendReport(const uint8_t *report) {
+    KeyReport keys;
+    memcpy(&keys, report, sizeof(keys));
+    bleKeyboard.sendReport(&keys);
+}
 
 bool isConnected() { return bleKeyboard.isConnected(); }
 
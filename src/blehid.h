@@ -8,12 +8,8 @@
 // HID_SUBCLASS_*) and cannot be compiled together. Mirrors src/usbhid.h.
 namespace BleHid {
 void begin();
-void press(uint8_t keyStroke);
-void release(uint8_t keyStroke);
-void write(uint8_t keyStroke);
-void releaseAll();
-void print(const String &text);
-void println(const String &text);
+// Send one 8-byte boot keyboard report (modifiers, reserved, 6 usages).
+void sendReport(const uint8_t *report);
 bool isConnected();
 void setBatteryLevel(uint8_t level);
 }  // namespace BleHid
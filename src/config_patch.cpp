@@ -0,0 +1,102 @@
+#include "config_patch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config_schema.h"
+#include "keymap.h"
+
+namespace {
+bool fail(char *error, size_t errorSize, const char *message) {
+    snprintf(error, errorSize, "%s", message);
+    return false;
+}
+
+bool isIndex(JsonVariantConst value, size_t count) {
+    return value.is<int>() && value.as<int>() >= 0 &&
+           (size_t)value.as<int>() < count;
+}
+}  // namespace
+
+bool ConfigPatch::fromJson(JsonVariantConst json, size_t layers,
+                           size_t macros, char *error, size_t errorSize) {
+    if (!isIndex(json["layer"], layers)) {
+        return fail(error, errorSize, "layer out of range");
+    }
+    layer = json["layer"].as<int>();
+
+    if (json.containsKey("ext")) {
+        if (!isIndex(json["ext"], EXT_KEYS)) {
+            return fail(error, errorSize, "ext out of range");
+        }
+        target = kExtKey;
+        row = 0;
+        col = json["ext"].as<int>();
+    } else {
+        if (!isIndex(json["row"], ROWS) || !isIndex(json["col"], COLS)) {
+            return fail(error, errorSize, "row/col out of range");
+        }
+        target = kMatrixKey;
+        row = json["row"].as<int>();
+        col = json["col"].as<int>();
+    }
+
+    JsonVariantConst text = json["info"];
+    if (!ConfigSchema::isValidKey(json["keyStroke"], text, layers, macros)) {
+        return fail(error, errorSize,
+                    "keyStroke must be 0-255 and info a label of an "
+                    "existing macro/layer");
+    }
+    keyStroke = json["keyStroke"].as<int>();
+    hasInfo = !text.isNull();
+    const char *label = text.as<const char *>();
+    if (hasInfo && strlen(label) >= kInfoSize) {
+        return fail(error, errorSize, "info too long");
+    }
+    strncpy(info, hasInfo ? label : "", kInfoSize);
+    return true;
+}
+
+void ConfigPatch::toJson(JsonObject json) const {
+    json["layer"] = layer;
+    if (target == kExtKey) {
+        json["ext"] = col;
+    } else {
+        json["row"] = row;
+        json["col"] = col;
+    }
+    json["keyStroke"] = keyStroke;
+    if (hasInfo) {
+        json["info"] = info;
+    } else {
+        json["info"] = nullptr;
+    }
+}
+
+bool ConfigPatch::fits(size_t layers, size_t macros) const {
+    return layer < layers &&
+           ConfigSchema::isValidLabel(hasInfo ? info : nullptr, layers,
+                                      macros);
+}
+
+bool ConfigPatch::applyTo(JsonVariant root) const {
+    JsonObject config =
+        target == kExtKey ? root["rotaryExtension"][layer].as<JsonObject>()
+                          : root["keyConfig"][layer].as<JsonObject>();
+    JsonArray keymap = config["keymap"].as<JsonArray>();
+    JsonArray keyInfo = config["keyInfo"].as<JsonArray>();
+    if (target == kMatrixKey) {
+        keymap = keymap[row].as<JsonArray>();
+        keyInfo = keyInfo[row].as<JsonArray>();
+    }
+    if (col >= keymap.size() || col >= keyInfo.size()) return false;
+
+    keymap[col] = keyStroke;
+    // Non-const char *: the document keeps its own copy
+    if (hasInfo) {
+        keyInfo[col] = const_cast<char *>(info);
+    } else {
+        keyInfo[col] = nullptr;
+    }
+    return true;
+}
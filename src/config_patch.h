@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+// One key binding edit from PATCH /api/config: the key code and label of a
+// matrix key or an extension board key on one layer. The same JSON object is
+// the request item and the line kept in the change log:
+//
+//   {"layer": 0, "row": 1, "col": 2, "keyStroke": 97, "info": "a"}
+//   {"layer": 0, "ext": 1, "keyStroke": 98, "info": "MACRO_2"}
+//
+// An edit sets values outright, so applying one twice is harmless.
+struct ConfigPatch {
+    static const size_t kInfoSize = 32;
+    enum Target : uint8_t { kMatrixKey, kExtKey };
+
+    uint8_t target;
+    uint8_t layer;
+    uint8_t row;  // kMatrixKey only
+    uint8_t col;  // kMatrixKey: column; kExtKey: key index
+    uint8_t keyStroke;
+    bool hasInfo;  // false: null label
+    char info[kInfoSize];
+
+    // Read one edit for a config of `layers` layers and `macros` macros.
+    // Returns false with a message if it is malformed or out of range.
+    bool fromJson(JsonVariantConst json, size_t layers, size_t macros,
+                  char *error, size_t errorSize);
+    void toJson(JsonObject json) const;
+    // Whether the edit still names an existing layer, macro and layer keys
+    // of a config of `layers` layers and `macros` macros.
+    bool fits(size_t layers, size_t macros) const;
+
+    // Write the edit into a parsed keyconfig document. Returns false if the
+    // document has no such key.
+    bool applyTo(JsonVariant root) const;
+};
@@ -0,0 +1,221 @@
+#include "config_schema.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "keymap.h"
+#include "macro_program.h"
+
+namespace {
+
+struct Context {
+    JsonArrayConst layerConfig;
+    size_t layers;
+    size_t macros;
+    char *error;
+    size_t errorSize;
+};
+
+bool fail(Context &ctx, const char *where, size_t index, const char *what) {
+    snprintf(ctx.error, ctx.errorSize, "%s[%u]: %s", where, (unsigned)index,
+             what);
+    return false;
+}
+
+bool isKeyCode(JsonVariantConst value) {
+    if (!value.is<int>()) return false;
+    int code = value.as<int>();
+    return code >= 0 && code <= UINT8_MAX;
+}
+
+// Labels that reference a macro or a layer must point at one that exists.
+bool isValidInfo(size_t layers, size_t macros, JsonVariantConst info) {
+    if (info.isNull()) return true;
+    const char *text = info.as<const char *>();
+    return text && ConfigSchema::isValidLabel(text, layers, macros);
+}
+
+// `codes` and `infos` must be arrays of exactly `count` key codes / labels.
+bool isKeyRow(const Context &ctx, JsonVariantConst codes,
+              JsonVariantConst infos, size_t count) {
+    JsonArrayConst codeArray = codes.as<JsonArrayConst>();
+    JsonArrayConst infoArray = infos.as<JsonArrayConst>();
+    if (codeArray.isNull() || codeArray.size() != count) return false;
+    if (infoArray.isNull() || infoArray.size() != count) return false;
+    for (size_t i = 0; i < count; i++) {
+        if (!ConfigSchema::isValidKey(codeArray[i], infoArray[i], ctx.layers,
+                                      ctx.macros)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkLayer(Context &ctx, JsonVariantConst layer, size_t index) {
+    if (!layer.is<JsonObjectConst>()) {
+        return fail(ctx, "keyConfig", index, "not an object");
+    }
+    JsonArrayConst keymap = layer["keymap"];
+    JsonArrayConst keyInfo = layer["keyInfo"];
+    if (keymap.size() != ROWS || keyInfo.size() != ROWS) {
+        return fail(ctx, "keyConfig", index, "expected 5 keymap/keyInfo rows");
+    }
+    for (size_t r = 0; r < ROWS; r++) {
+        if (!isKeyRow(ctx, keymap[r], keyInfo[r], COLS)) {
+            return fail(ctx, "keyConfig", index,
+                        "keymap/keyInfo row needs 7 key codes 0-255 and "
+                        "labels of existing macros/layers");
+        }
+    }
+    return true;
+}
+
+bool checkEncoder(Context &ctx, const char *where, JsonVariantConst encoder,
+                  size_t index) {
+    if (encoder.isNull()) return true;
+    if (!isKeyRow(ctx, encoder["rotaryMap"], encoder["rotaryInfo"], 3)) {
+        return fail(ctx, where, index,
+                    "rotaryMap/rotaryInfo need 3 key codes and labels");
+    }
+    JsonVariantConst accel = encoder["acceleration"];
+    if (!accel["fastMap"].isNull() &&
+        !isKeyRow(ctx, accel["fastMap"], accel["fastInfo"], 2)) {
+        return fail(ctx, where, index,
+                    "acceleration fastMap/fastInfo need 2 key codes");
+    }
+    return true;
+}
+
+// A press/release/tap operand: one key code or an array of them.
+bool isKeyOperand(JsonVariantConst keys) {
+    if (!keys.is<JsonArrayConst>()) return isKeyCode(keys);
+    for (JsonVariantConst key : keys.as<JsonArrayConst>()) {
+        if (!isKeyCode(key)) return false;
+    }
+    return true;
+}
+
+// A macro "layer" step: a layer index or title (case insensitive).
+bool isLayerRef(const Context &ctx, JsonVariantConst layer) {
+    if (layer.is<int>()) {
+        int index = layer.as<int>();
+        return index >= 0 && (size_t)index < ctx.layers;
+    }
+    const char *title = layer.as<const char *>();
+    if (!title) return false;
+    for (JsonVariantConst config : ctx.layerConfig) {
+        const char *candidate = config["title"];
+        if (candidate && strcasecmp(candidate, title) == 0) return true;
+    }
+    return false;
+}
+
+bool checkSteps(Context &ctx, JsonVariantConst steps, size_t macro,
+                uint8_t depth) {
+    if (!steps.is<JsonArrayConst>()) {
+        return fail(ctx, "macros", macro, "steps must be an array");
+    }
+    for (JsonVariantConst step : steps.as<JsonArrayConst>()) {
+        const char *keyOps[] = {"press", "release", "tap"};
+        for (size_t i = 0; i < 3; i++) {
+            if (step.containsKey(keyOps[i]) && !isKeyOperand(step[keyOps[i]])) {
+                return fail(ctx, "macros", macro, "key code out of range");
+            }
+        }
+        if (step.containsKey("layer") && !isLayerRef(ctx, step["layer"])) {
+            return fail(ctx, "macros", macro, "layer step for unknown layer");
+        }
+        if (step.containsKey("repeat")) {
+            if (depth >= MacroProgram::kMaxDepth) {
+                return fail(ctx, "macros", macro, "repeat nested too deep");
+            }
+            if (!checkSteps(ctx, step["steps"], macro, depth + 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool checkMacro(Context &ctx, JsonVariantConst macro, size_t index) {
+    if (!macro.is<JsonObjectConst>()) {
+        return fail(ctx, "macros", index, "not an object");
+    }
+    if (macro.containsKey("steps")) {
+        return checkSteps(ctx, macro["steps"], index, 0);
+    }
+    JsonVariantConst keyStrokes = macro["keyStrokes"];
+    if (!keyStrokes.isNull() && !isKeyOperand(keyStrokes)) {
+        return fail(ctx, "macros", index, "key code out of range");
+    }
+    return true;
+}
+
+}  // namespace
+
+namespace ConfigSchema {
+
+bool isValidKey(JsonVariantConst keyStroke, JsonVariantConst info,
+                size_t layers, size_t macros) {
+    return isKeyCode(keyStroke) && isValidInfo(layers, macros, info);
+}
+
+bool isValidLabel(const char *info, size_t layers, size_t macros) {
+    if (!info) return true;
+
+    static const char *const kLayerPrefixes[] = {"TT_", "MO_", "TG_", "OSL_"};
+    if (strncmp(info, "MACRO_", 6) == 0) {
+        return (size_t)atoi(info + 6) < macros;
+    }
+    if (strncmp(info, "MT_", 3) == 0) {
+        int code = atoi(info + 3);
+        return code > 0 && code <= UINT8_MAX;
+    }
+    for (size_t i = 0; i < sizeof(kLayerPrefixes) / sizeof(*kLayerPrefixes);
+         i++) {
+        size_t length = strlen(kLayerPrefixes[i]);
+        if (strncmp(info, kLayerPrefixes[i], length) == 0) {
+            return (size_t)atoi(info + length) < layers;
+        }
+    }
+    return true;
+}
+
+bool validate(JsonVariantConst root, char *error, size_t errorSize) {
+    JsonArrayConst layers = root["keyConfig"];
+    if (layers.isNull() || layers.size() == 0) {
+        snprintf(error, errorSize, "keyConfig: needs at least one layer");
+        return false;
+    }
+    Context ctx = {layers, layers.size(), 0, error, errorSize};
+    JsonArrayConst macros = root["macros"];
+    ctx.macros = macros.isNull() ? 0 : macros.size();
+
+    for (size_t i = 0; i < ctx.layers; i++) {
+        if (!checkLayer(ctx, layers[i], i)) return false;
+    }
+
+    JsonVariantConst onboard = root["onBoardRotaryEncoder"];
+    JsonVariantConst extension = root["rotaryExtension"];
+    for (size_t i = 0; i < ctx.layers; i++) {
+        if (!checkEncoder(ctx, "onBoardRotaryEncoder", onboard[i], i)) {
+            return false;
+        }
+        JsonVariantConst board = extension[i];
+        if (board.isNull()) continue;
+        if (!isKeyRow(ctx, board["keymap"], board["keyInfo"], EXT_KEYS)) {
+            return fail(ctx, "rotaryExtension", i,
+                        "keymap/keyInfo need 3 key codes and labels");
+        }
+        if (!checkEncoder(ctx, "rotaryExtension", board, i)) return false;
+    }
+
+    for (size_t i = 0; i < ctx.macros; i++) {
+        if (!checkMacro(ctx, macros[i], i)) return false;
+    }
+    return true;
+}
+
+}  // namespace ConfigSchema
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+// Structural check of a keyconfig.json document before it replaces the live
+// one: layer table dimensions, key code ranges, that every MACRO_<n> and
+// layer key label refers to an existing macro / layer, and that every
+// MT_<code> holds a key code 1-255. Anything ConfigStore
+// would silently clamp or drop is accepted; anything that would compile into
+// a broken keymap is not.
+namespace ConfigSchema {
+
+// Returns true if `root` is a usable keyconfig. Otherwise writes a short
+// description of the first problem found ("keyConfig[1].keymap: ...") to
+// `error`.
+bool validate(JsonVariantConst root, char *error, size_t errorSize);
+
+// One binding: a key code 0-255 and a label (string or null) that, if it
+// names a macro or layer, names one of the `macros` / `layers` there are.
+bool isValidKey(JsonVariantConst keyStroke, JsonVariantConst info,
+                size_t layers, size_t macros);
+// The label half of isValidKey(); nullptr is a null label.
+bool isValidLabel(const char *info, size_t layers, size_t macros);
+
+}  // namespace ConfigSchema
@@ -1,23 +1,336 @@
 #include "config_store.h"
 
-#include <SPIFFS.h>
+#include <algorithm>
 
-bool ConfigStore::reload() {
-    File file = SPIFFS.open("/keyconfig.json");
-    if (!file) {
-        Serial.println("ConfigStore: failed to open /keyconfig.json");
-        return false;
-    }
+namespace {
+const Keymap::Layer kEmptyLayer = {};
+
+// Numeric suffix of a "MACRO_<n>" / layer key label, clamped to a byte.
+uint8_t parseActionArg(const char *digits) {
+    int value = atoi(digits);
+    if (value < 0) return 0;
+    if (value > UINT8_MAX) return UINT8_MAX;
+    return value;
+}
+}  // namespace
 
-    doc_.clear();
-    DeserializationError err =
-        deserializeJson(doc_, file, DeserializationOption::NestingLimit(5));
-    file.close();
+bool ConfigStore::reload(KeyconfigFile &file) {
+    return file.load([this](JsonDocument &doc) {
+        xSemaphoreTake(lock_, portMAX_DELAY);
+        compile(doc.as<JsonVariantConst>());
+        xSemaphoreGive(lock_);
+    });
+}
 
-    if (err) {
-        Serial.print(F("ConfigStore: deserializeJson() failed: "));
-        Serial.println(err.c_str());
-        return false;
+bool ConfigStore::applyPatch(const ConfigPatch &patch) {
+    if (!patch.fits(layers_.size(), macros_.count())) return false;
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    Keymap::Layer &layer = layers_[patch.layer];
+    Keymap::KeyEntry entry =
+        compileKey(patch.keyStroke, patch.hasInfo ? patch.info : nullptr);
+    if (patch.target == ConfigPatch::kExtKey) {
+        layer.extKeys[patch.col] = entry;
+    } else {
+        layer.keys[patch.row][patch.col] = entry;
     }
+    xSemaphoreGive(lock_);
     return true;
 }
+
+const Keymap::Layer &ConfigStore::layer(size_t index) const {
+    if (index >= layers_.size()) return kEmptyLayer;
+    return layers_[index];
+}
+
+Keymap::KeyEntry ConfigStore::compileKey(JsonVariantConst keyStroke,
+                                         JsonVariantConst info) {
+    return compileKey(keyStroke.as<uint8_t>(), info.as<const char *>());
+}
+
+Keymap::KeyEntry ConfigStore::compileKey(uint8_t keyStroke,
+                                         const char *text) {
+    Keymap::KeyEntry entry;
+    entry.keyStroke = keyStroke;
+    entry.action = Keymap::kActionKey;
+    entry.arg = 0;
+    entry.label = labels_.intern(text);
+
+    if (!text) return entry;
+    if (strncmp(text, "MACRO_", 6) == 0) {
+        entry.action = Keymap::kActionMacro;
+        entry.arg = parseActionArg(text + 6);
+    } else if (strncmp(text, "TT_", 3) == 0) {
+        entry.action = Keymap::kActionTapToggle;
+        entry.arg = parseActionArg(text + 3);
+    } else if (strncmp(text, "MO_", 3) == 0) {
+        entry.action = Keymap::kActionMomentary;
+        entry.arg = parseActionArg(text + 3);
+    } else if (strncmp(text, "TG_", 3) == 0) {
+        entry.action = Keymap::kActionToggleLayer;
+        entry.arg = parseActionArg(text + 3);
+    } else if (strncmp(text, "OSL_", 4) == 0) {
+        entry.action = Keymap::kActionOneShot;
+        entry.arg = parseActionArg(text + 4);
+    } else if (strncmp(text, "MT_", 3) == 0) {
+        entry.action = Keymap::kActionModTap;
+        entry.arg = parseActionArg(text + 3);
+    } else if (strcmp(text, "TRNS") == 0) {
+        entry.action = Keymap::kActionTransparent;
+        entry.keyStroke = 0;
+    } else if (strcmp(text, "FN") == 0) {
+        entry.action = Keymap::kActionFn;
+    }
+    return entry;
+}
+
+Keymap::EncoderEntry ConfigStore::compileEncoder(JsonVariantConst config) {
+    JsonVariantConst rotaryMap = config["rotaryMap"];
+    JsonVariantConst rotaryInfo = config["rotaryInfo"];
+    Keymap::EncoderEntry entry;
+    entry.button = compileKey(rotaryMap[0], rotaryInfo[0]);
+    entry.ccw = compileKey(rotaryMap[1], rotaryInfo[1]);
+    entry.cw = compileKey(rotaryMap[2], rotaryInfo[2]);
+
+    JsonVariantConst accel = config["acceleration"];
+    int fastMs = accel["fastMs"] | 0;
+    int repeat = accel["repeat"] | 1;
+    entry.accel.fastMs = std::min(std::max(fastMs, 0), (int)UINT8_MAX);
+    entry.accel.repeat = std::min(std::max(repeat, 1), (int)UINT8_MAX);
+    JsonVariantConst fastMap = accel["fastMap"];
+    JsonVariantConst fastInfo = accel["fastInfo"];
+    entry.accel.fastCcw = compileKey(fastMap[0], fastInfo[0]);
+    entry.accel.fastCw = compileKey(fastMap[1], fastInfo[1]);
+    return entry;
+}
+
+/**
+ * Read the "debounce" section: {"mode": "eager" | "deferred" | "asymmetric",
+ * "pressMs": n, "releaseMs": n}. Missing fields keep their defaults.
+ *
+ */
+void ConfigStore::compileDebounce(JsonVariantConst config) {
+    debounce_ = kDefaultDebounce;
+    if (config.isNull()) return;
+
+    const char *mode = config["mode"] | "eager";
+    if (strcmp(mode, "deferred") == 0) {
+        debounce_.mode = kDebounceDeferred;
+    } else if (strcmp(mode, "asymmetric") == 0) {
+        debounce_.mode = kDebounceAsymmetric;
+    } else {
+        debounce_.mode = kDebounceEager;
+    }
+    int pressMs = config["pressMs"] | (int)kDefaultDebounce.pressMs;
+    int releaseMs = config["releaseMs"] | (int)kDefaultDebounce.releaseMs;
+    debounce_.pressMs = std::min(std::max(pressMs, 0), (int)UINT8_MAX);
+    debounce_.releaseMs = std::min(std::max(releaseMs, 0), (int)UINT8_MAX);
+}
+
+/**
+ * Read the "macroDelay" section: {"usb": n, "ble": n}, the gap in ms between
+ * typed macro characters on each transport. Missing fields keep their
+ * defaults.
+ *
+ */
+void ConfigStore::compileMacroDelay(JsonVariantConst config) {
+    int usbMs = config["usb"] | (int)kDefaultMacroDelay.usbMs;
+    int bleMs = config["ble"] | (int)kDefaultMacroDelay.bleMs;
+    macroDelay_.usbMs = std::min(std::max(usbMs, 0), (int)UINT8_MAX);
+    macroDelay_.bleMs = std::min(std::max(bleMs, 0), (int)UINT8_MAX);
+}
+
+/**
+ * Resolve a macro "layer" step: a layout index or a layout title (case
+ * insensitive). Returns -1 if no such layout.
+ *
+ */
+int ConfigStore::findLayer(JsonVariantConst layer) const {
+    if (layer.is<int>()) {
+        int index = layer.as<int>();
+        return index >= 0 && index < (int)layers_.size() ? index : -1;
+    }
+    const char *title = layer.as<const char *>();
+    if (!title) return -1;
+    for (size_t i = 0; i < layers_.size(); i++) {
+        if (strcasecmp(labels_.get(layers_[i].title), title) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * Compile a "tap" step: a single key code, or an array of key codes pressed
+ * in order and released in reverse (a chord).
+ *
+ */
+void ConfigStore::compileTap(JsonVariantConst keys) {
+    if (!keys.is<JsonArrayConst>()) {
+        macros_.emit(MacroProgram::kOpTap);
+        macros_.emit(keys.as<uint8_t>());
+        return;
+    }
+    JsonArrayConst chord = keys.as<JsonArrayConst>();
+    for (JsonVariantConst key : chord) {
+        macros_.emit(MacroProgram::kOpPress);
+        macros_.emit(key.as<uint8_t>());
+    }
+    for (size_t i = chord.size(); i > 0; i--) {
+        macros_.emit(MacroProgram::kOpRelease);
+        macros_.emit(chord[i - 1].as<uint8_t>());
+    }
+}
+
+/**
+ * Compile a macro's "steps" array into bytecode. Each step is an object with
+ * one of: "press" / "release" (key code or array), "tap" (key code or chord
+ * array), "delay" (ms), "type" (text), "layer" (index or title),
+ * "releaseAll", or "repeat" (count) with nested "steps".
+ *
+ */
+void ConfigStore::compileSteps(JsonArrayConst steps, uint8_t depth) {
+    for (JsonObjectConst step : steps) {
+        if (step.containsKey("press") || step.containsKey("release")) {
+            bool press = step.containsKey("press");
+            JsonVariantConst keys = press ? step["press"] : step["release"];
+            uint8_t op = press ? MacroProgram::kOpPress
+                               : MacroProgram::kOpRelease;
+            if (keys.is<JsonArrayConst>()) {
+                for (JsonVariantConst key : keys.as<JsonArrayConst>()) {
+                    macros_.emit(op);
+                    macros_.emit(key.as<uint8_t>());
+                }
+            } else {
+                macros_.emit(op);
+                macros_.emit(keys.as<uint8_t>());
+            }
+        } else if (step.containsKey("tap")) {
+            compileTap(step["tap"]);
+        } else if (step.containsKey("delay")) {
+            int ms = step["delay"].as<int>();
+            macros_.emit(MacroProgram::kOpDelay);
+            macros_.emit16(std::min(std::max(ms, 0), (int)UINT16_MAX));
+        } else if (step.containsKey("type")) {
+            macros_.emit(MacroProgram::kOpType);
+            macros_.emit16(labels_.intern(step["type"].as<const char *>()));
+        } else if (step.containsKey("layer")) {
+            int index = findLayer(step["layer"]);
+            if (index < 0) {
+                Serial.println("ConfigStore: macro step for unknown layer");
+                continue;
+            }
+            macros_.emit(MacroProgram::kOpLayer);
+            macros_.emit(index);
+        } else if (step.containsKey("releaseAll")) {
+            macros_.emit(MacroProgram::kOpReleaseAll);
+        } else if (step.containsKey("repeat")) {
+            if (depth >= MacroProgram::kMaxDepth) {
+                Serial.println("ConfigStore: macro repeat nested too deep");
+                continue;
+            }
+            int times = step["repeat"].as<int>();
+            macros_.emit(MacroProgram::kOpRepeat);
+            macros_.emit(std::min(std::max(times, 0), (int)UINT8_MAX));
+            size_t lengthAt = macros_.mark();
+            macros_.emit16(0);
+            compileSteps(step["steps"].as<JsonArrayConst>(), depth + 1);
+            macros_.patch16(lengthAt, macros_.mark() - lengthAt - 2);
+        } else {
+            Serial.println("ConfigStore: unknown macro step");
+        }
+    }
+}
+
+/**
+ * Compile the "macros" section into macros_. Macros with "steps" compile
+ * those; older entries use "type": 0 presses "keyStrokes" together for
+ * 50 ms, 1 types "stringContent", 2 types it and presses Enter.
+ *
+ */
+void ConfigStore::compileMacros(JsonArrayConst macros) {
+    macros_.clear();
+    for (JsonObjectConst macro : macros) {
+        macros_.beginProgram(labels_.intern(macro["name"].as<const char *>()));
+
+        if (macro.containsKey("steps")) {
+            compileSteps(macro["steps"].as<JsonArrayConst>(), 0);
+        } else {
+            int type = macro["type"] | 0;
+            JsonArrayConst keyStrokes = macro["keyStrokes"];
+            if (type == 0) {
+                for (JsonVariantConst key : keyStrokes) {
+                    uint8_t keyStroke = key.as<uint8_t>();
+                    if (!keyStroke) continue;
+                    macros_.emit(MacroProgram::kOpPress);
+                    macros_.emit(keyStroke);
+                }
+                macros_.emit(MacroProgram::kOpDelay);
+                macros_.emit16(50);
+                macros_.emit(MacroProgram::kOpReleaseAll);
+            } else if (type == 1 || type == 2) {
+                const char *text = macro["stringContent"] | "";
+                macros_.emit(MacroProgram::kOpType);
+                macros_.emit16(labels_.intern(text));
+                if (type == 2) {
+                    macros_.emit(MacroProgram::kOpTap);
+                    macros_.emit('\n');
+                }
+            }
+        }
+
+        macros_.endProgram();
+    }
+}
+
+/**
+ * Flatten every layer of the parsed document into layers_. Missing arrays
+ * (e.g. no rotaryExtension section) compile to key code 0 with an empty label.
+ *
+ */
+void ConfigStore::compile(JsonVariantConst root) {
+    JsonArrayConst keyConfig = root["keyConfig"].as<JsonArrayConst>();
+    JsonArrayConst onboardEncoder =
+        root["onBoardRotaryEncoder"].as<JsonArrayConst>();
+    JsonArrayConst rotaryExtension =
+        root["rotaryExtension"].as<JsonArrayConst>();
+
+    if (onboardEncoder.isNull()) {
+        Serial.println("No onboard rotary encoder config found");
+    }
+    if (rotaryExtension.isNull()) {
+        Serial.println("No rotary extension config found");
+    }
+
+    labels_.clear();
+    layers_.assign(keyConfig.size(), kEmptyLayer);
+
+    for (size_t i = 0; i < layers_.size(); i++) {
+        Keymap::Layer &layer = layers_[i];
+        JsonVariantConst config = keyConfig[i];
+
+        layer.title = labels_.intern(config["title"].as<const char *>());
+
+        for (int r = 0; r < ROWS; r++) {
+            for (int c = 0; c < COLS; c++) {
+                layer.keys[r][c] = compileKey(config["keymap"][r][c],
+                                              config["keyInfo"][r][c]);
+            }
+        }
+
+        layer.onboardEncoder = compileEncoder(onboardEncoder[i]);
+
+        JsonVariantConst extension = rotaryExtension[i];
+        for (int k = 0; k < EXT_KEYS; k++) {
+            layer.extKeys[k] =
+                compileKey(extension["keymap"][k], extension["keyInfo"][k]);
+        }
+        layer.extEncoder = compileEncoder(extension);
+    }
+
+    compileDebounce(root["debounce"]);
+    compileMacroDelay(root["macroDelay"]);
+    compileMacros(root["macros"].as<JsonArrayConst>());
+
+    Serial.println((String) "ConfigStore: compiled " + layers_.size() +
+                   " layers, " + macros_.count() + " macros (" +
+                   macros_.arenaSize() + " bytes), " + labels_.size() +
+                   " labels");
+}
@@ -2,23 +2,90 @@
 
 #include <ArduinoJson.h>
 
-// Loads and caches the parsed keyconfig.json. The keymap, macros and layout
-// lookups all read this single in-memory document instead of re-reading the
-// file and re-parsing the ~16 KB JSON on every call and every layer switch.
+#include <vector>
+
+#include "config_patch.h"
+#include "debounce.h"
+#include "keymap.h"
+#include "keyconfig_file.h"
+#include "label_pool.h"
+#include "macro_player.h"
+#include "macro_program.h"
+
+// Loads keyconfig.json and compiles every layer into a flat Keymap::Layer
+// table, so the keymap, macros and layout lookups never re-read or re-parse
+// the file and a layer switch is a pointer swap with no JSON walk and no heap
+// allocation. The parsed document only lives for the duration of reload().
+//
+// The input task owns the store: it is the only writer and reads it without
+// locking. Other tasks (the HTTP handlers) read it only inside a Reader,
+// which never waits: while a reload or key edit is being compiled, ok() is
+// false and they answer "busy" instead.
 class ConfigStore {
    public:
-    ConfigStore() : doc_(kCapacity) {}
+    class Reader {
+       public:
+        explicit Reader(const ConfigStore &store)
+            : lock_(store.lock_), ok_(xSemaphoreTake(lock_, 0) == pdTRUE) {}
+        ~Reader() {
+            if (ok_) xSemaphoreGive(lock_);
+        }
+        bool ok() const { return ok_; }
+
+       private:
+        SemaphoreHandle_t lock_;
+        bool ok_;
+    };
+
+    ConfigStore() : lock_(xSemaphoreCreateMutex()) {}
+
+    // (Re)read the keyconfig (file plus logged edits) into a transient
+    // document sized to the file and recompile the layer tables. Returns
+    // false on open/parse failure (tables left unchanged on failure).
+    // Streams straight from the file, no intermediate String.
+    bool reload(KeyconfigFile &file);
 
-    // (Re)read /keyconfig.json from SPIFFS and parse it into the cached
-    // document. Returns false on open/parse failure (cache left unchanged on
-    // open failure). Streams straight from the file, no intermediate String.
-    bool reload();
+    // Rebind one key of one compiled layer in place (a logged single-key
+    // edit), without a reload. Returns false, changing nothing, if the edit
+    // no longer fits the compiled config (a reload since it was accepted).
+    bool applyPatch(const ConfigPatch &patch);
 
-    // Parsed configuration. Valid after a successful reload().
-    JsonDocument &doc() { return doc_; }
+    // Compiled layers. layer() returns an all-zero layer for out-of-range
+    // indexes (e.g. a stale layout index restored from EEPROM).
+    size_t layerCount() const { return layers_.size(); }
+    const Keymap::Layer &layer(size_t index) const;
+
+    // Text of a label id referenced by the compiled tables.
+    const char *label(uint16_t id) const { return labels_.get(id); }
+    const LabelPool &labels() const { return labels_; }
+
+    // Compiled "macros" section, indexed by the n of "MACRO_<n>".
+    const MacroTable &macros() const { return macros_; }
+
+    // "debounce" section, or kDefaultDebounce when absent.
+    const DebounceConfig &debounce() const { return debounce_; }
+
+    // "macroDelay" section, or kDefaultMacroDelay when absent.
+    const MacroDelayConfig &macroDelay() const { return macroDelay_; }
 
    private:
-    // Sized for up to ~10 layers (was the project-wide jsonDocSize).
-    static const size_t kCapacity = 16384;
-    DynamicJsonDocument doc_;
+    void compile(JsonVariantConst root);
+    Keymap::KeyEntry compileKey(JsonVariantConst keyStroke,
+                                JsonVariantConst info);
+    Keymap::KeyEntry compileKey(uint8_t keyStroke, const char *text);
+    Keymap::EncoderEntry compileEncoder(JsonVariantConst config);
+    void compileDebounce(JsonVariantConst config);
+    void compileMacroDelay(JsonVariantConst config);
+    void compileMacros(JsonArrayConst macros);
+    void compileSteps(JsonArrayConst steps, uint8_t depth);
+    void compileTap(JsonVariantConst keys);
+    int findLayer(JsonVariantConst layer) const;
+
+    // Held by the input task while it changes the tables, and by Readers
+    SemaphoreHandle_t lock_;
+    std::vector<Keymap::Layer> layers_;
+    LabelPool labels_;
+    MacroTable macros_;
+    DebounceConfig debounce_ = kDefaultDebounce;
+    MacroDelayConfig macroDelay_ = kDefaultMacroDelay;
 };
@@ -0,0 +1,72 @@
+#include "config_upload.h"
+
+#include "config_schema.h"
+#include "json_file.h"
+
+bool ConfigUpload::begin() {
+    abort();
+    failed_ = false;
+    bytes_ = 0;
+    error_[0] = '\0';
+    file_ = fs_.open(tempPath_, FILE_WRITE);
+    if (!file_) return fail("cannot create temporary file");
+    return true;
+}
+
+bool ConfigUpload::write(const uint8_t *data, size_t size) {
+    if (failed_) return false;
+    if (!file_) return fail("no upload in progress");
+    if (file_.write(data, size) != size) {
+        return fail("file system full");
+    }
+    bytes_ += size;
+    return true;
+}
+
+void ConfigUpload::abort() {
+    if (file_) file_.close();
+    fs_.remove(tempPath_);
+}
+
+bool ConfigUpload::fail(const char *message) {
+    if (!failed_) {
+        strncpy(error_, message, sizeof(error_) - 1);
+        error_[sizeof(error_) - 1] = '\0';
+    }
+    failed_ = true;
+    abort();
+    return false;
+}
+
+bool ConfigUpload::finish() {
+    if (failed_) return false;
+    if (!file_) return fail("no upload in progress");
+    file_.close();
+    if (bytes_ == 0) return fail("empty config");
+
+    File file = fs_.open(tempPath_, FILE_READ);
+    if (!file) return fail("cannot reopen temporary file");
+
+    bool valid = false;
+    DeserializationError err = JsonFile::parse(file, [&](JsonDocument &doc) {
+        valid = ConfigSchema::validate(doc.as<JsonVariantConst>(), error_,
+                                       sizeof(error_));
+    });
+    file.close();
+
+    if (err) {
+        char message[48];
+        snprintf(message, sizeof(message), "invalid JSON: %s", err.c_str());
+        return fail(message);
+    }
+    if (!valid) {
+        // validate() already wrote error_
+        failed_ = true;
+        abort();
+        return false;
+    }
+    if (!live_.replace(tempPath_)) {
+        return fail("cannot rename new config into place");
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <FS.h>
+
+#include "keyconfig_file.h"
+
+// Receives a replacement keyconfig.json in chunks of any size (HTTP body
+// buffers, Serial reads) and only swaps it in once the whole file is known to
+// be good. Chunks go straight to a temporary file, so no upload is ever held
+// in RAM; finish() then parses and validates the file and has KeyconfigFile
+// install it. Any failure leaves the live config untouched.
+class ConfigUpload {
+   public:
+    ConfigUpload(FS &fs, const char *tempPath, KeyconfigFile &live)
+        : fs_(fs),
+          tempPath_(tempPath),
+          live_(live),
+          bytes_(0),
+          failed_(false) {
+        error_[0] = '\0';
+    }
+
+    // Start a new upload, dropping any unfinished one.
+    bool begin();
+    // Append the next chunk. Returns false once the upload has failed.
+    bool write(const uint8_t *data, size_t size);
+    // Discard the upload (client went away, transfer stalled).
+    void abort();
+    // Validate the received file and make it the live config. On false,
+    // error() says why and the temporary file is gone.
+    bool finish();
+
+    bool active() const { return (bool)file_; }
+    size_t bytes() const { return bytes_; }
+    const char *error() const { return error_; }
+
+   private:
+    bool fail(const char *message);
+
+    FS &fs_;
+    const char *tempPath_;
+    KeyconfigFile &live_;
+    File file_;
+    size_t bytes_;
+    bool failed_;
+    char error_[96];
+};
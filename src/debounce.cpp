@@ -0,0 +1,95 @@
+#include "debounce.h"
+
+#include <string.h>
+
+Debouncer::Debouncer(uint8_t keyCount)
+    : config_(kDefaultDebounce),
+      keyCount_(keyCount > kMaxKeys ? kMaxKeys : keyCount),
+      stable_(0),
+      lastRaw_(0),
+      locked_(0) {
+    memset(stamps_, 0, sizeof(stamps_));
+}
+
+bool Debouncer::isEager(bool press) const {
+    switch (config_.mode) {
+        case kDebounceEager:
+            return true;
+        case kDebounceAsymmetric:
+            return press;
+        default:
+            return false;
+    }
+}
+
+Debouncer::State Debouncer::update(State raw, uint32_t nowMs) {
+    uint16_t now = nowMs;
+    State rawChanged = raw ^ lastRaw_;
+    State pending = raw ^ stable_;
+    lastRaw_ = raw;
+
+    // Nothing moved and nothing is waiting out a window: the common case.
+    if (!rawChanged && !pending) return 0;
+
+    State changed = 0;
+    State candidates = rawChanged | pending;
+    while (candidates) {
+        int i = __builtin_ctzll(candidates);
+        candidates &= candidates - 1;
+        if (i >= keyCount_) break;
+
+        State bit = (State)1 << i;
+        Stamp &stamp = stamps_[i];
+        if (rawChanged & bit) stamp.changedAt = now;
+        if (!(pending & bit)) continue;
+
+        bool press = (raw & bit) != 0;
+
+        // After an eager edge the key ignores input for that edge's window.
+        if (locked_ & bit) {
+            bool lastWasPress = (stable_ & bit) != 0;
+            uint16_t lockout =
+                lastWasPress ? config_.pressMs : config_.releaseMs;
+            if ((uint16_t)(now - stamp.edgeAt) < lockout) continue;
+            locked_ &= ~bit;
+        }
+
+        if (isEager(press)) {
+            locked_ |= bit;
+        } else {
+            uint16_t window = press ? config_.pressMs : config_.releaseMs;
+            if ((uint16_t)(now - stamp.changedAt) < window) continue;
+        }
+
+        stable_ ^= bit;
+        stamp.edgeAt = now;
+        changed |= bit;
+    }
+    return changed;
+}
+
+// word_ holds mode, pressMs, releaseMs and the publish count, one byte each
+// from the low end. The count starts at 1 so the first poll configures.
+DebounceSettings::DebounceSettings()
+    : word_(kDefaultDebounce.mode | kDefaultDebounce.pressMs << 8 |
+            kDefaultDebounce.releaseMs << 16 | 1u << 24) {}
+
+// One publisher (the input task), so the count needs no read-modify-write.
+void DebounceSettings::publish(const DebounceConfig &config) {
+    uint32_t count = (__atomic_load_n(&word_, __ATOMIC_RELAXED) >> 24) + 1;
+    // 0 is reserved for "never polled"
+    if ((count & 0xFF) == 0) count = 1;
+    uint32_t word = config.mode | config.pressMs << 8 |
+                    config.releaseMs << 16 | (count & 0xFF) << 24;
+    __atomic_store_n(&word_, word, __ATOMIC_RELEASE);
+}
+
+bool DebounceSettings::poll(uint32_t &seen, DebounceConfig *config) const {
+    uint32_t word = __atomic_load_n(&word_, __ATOMIC_ACQUIRE);
+    if (word == seen) return false;
+    seen = word;
+    config->mode = (DebounceMode)(word & 0xFF);
+    config->pressMs = word >> 8;
+    config->releaseMs = word >> 16;
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+// Debounce algorithm, selected by "debounce.mode" in keyconfig.json.
+enum DebounceMode : uint8_t {
+    // Report every edge immediately, then ignore the key for the window
+    // (lowest latency).
+    kDebounceEager = 0,
+    // Report an edge only once the raw level has been stable for the window.
+    kDebounceDeferred,
+    // Eager press, deferred release.
+    kDebounceAsymmetric,
+};
+
+struct DebounceConfig {
+    DebounceMode mode;
+    uint8_t pressMs;
+    uint8_t releaseMs;
+};
+
+// Default used when keyconfig.json has no "debounce" section.
+const DebounceConfig kDefaultDebounce = {kDebounceEager, 5, 5};
+
+// Per-key debouncer between a raw input sample (one bit per key) and the
+// press/release dispatch. Keeps two 16-bit millisecond timestamps per key:
+// when the raw level last changed and when the last edge was reported.
+class Debouncer {
+   public:
+    typedef uint64_t State;
+    static const uint8_t kMaxKeys = 64;
+
+    explicit Debouncer(uint8_t keyCount);
+
+    void configure(const DebounceConfig &config) { config_ = config; }
+
+    // Feed one raw sample taken at nowMs (bit set = key down). Returns the
+    // mask of keys whose debounced state changed.
+    State update(State raw, uint32_t nowMs);
+
+    // Debounced keys currently down.
+    State state() const { return stable_; }
+
+   private:
+    struct Stamp {
+        uint16_t changedAt;
+        uint16_t edgeAt;
+    };
+
+    bool isEager(bool press) const;
+
+    DebounceConfig config_;
+    uint8_t keyCount_;
+    State stable_;
+    State lastRaw_;
+    // Keys whose last reported edge was eager and may still be locked out.
+    State locked_;
+    Stamp stamps_[kMaxKeys];
+};
+
+// Debounce settings handed from the config reload to the tasks that own the
+// debouncers. A reload publishes; each owning task polls at the top of its
+// scan and configures its own debouncers, so configure() never runs beside
+// update(). The settings and a publish count share one 32-bit word.
+class DebounceSettings {
+   public:
+    DebounceSettings();
+
+    void publish(const DebounceConfig &config);
+
+    // True, with the settings in *config, when something was published
+    // since the last poll with `seen` (start it at 0).
+    bool poll(uint32_t &seen, DebounceConfig *config) const;
+
+   private:
+    uint32_t word_;
+};
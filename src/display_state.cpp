@@ -1,67 +1,115 @@
 #include "display_state.h"
 
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
 
 namespace {
-SemaphoreHandle_t gMutex = nullptr;
-String gTop;
-String gBottom;
+// Odd while a writer is mid-update; generation is gSeq / 2.
+uint32_t gSeq = 0;
+char gTop[Display::kLineSize] = "";
+char gBottom[Display::kLineSize] = "";
 int gIcon = 0;
-String gKeyInfo;
+
+// Serialises writers only (readers never take it). Held for one short copy.
+portMUX_TYPE gWriterMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Not part of the rendered state; guarded by gWriterMux alone
+char gKeyInfo[Display::kLineSize] = "";
 bool gKeyInfoPending = false;
+char gLayout[Display::kLineSize] = "";
 
-// RAII lock; a no-op until Display::begin() has created the mutex.
-struct Guard {
-    Guard() {
-        if (gMutex) xSemaphoreTake(gMutex, portMAX_DELAY);
-    }
-    ~Guard() {
-        if (gMutex) xSemaphoreGive(gMutex);
-    }
-};
-}  // namespace
+// Both called with gWriterMux held.
+void beginWrite() {
+    __atomic_store_n(&gSeq, gSeq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-namespace Display {
+void endWrite() { __atomic_store_n(&gSeq, gSeq + 1, __ATOMIC_RELEASE); }
 
-void begin() {
-    if (!gMutex) gMutex = xSemaphoreCreateMutex();
+void copyLine(char *line, const char *text) {
+    strncpy(line, text ? text : "", Display::kLineSize - 1);
+    line[Display::kLineSize - 1] = '\0';
 }
 
-void setTop(const String &text) {
-    Guard g;
-    gTop = text;
+// Called with gWriterMux held.
+void writeLine(char *line, const char *text) {
+    // Rewriting the same text (e.g. the idle message every pass) is not a
+    // change and leaves the generation alone.
+    if (strncmp(line, text, Display::kLineSize - 1) == 0) return;
+    beginWrite();
+    copyLine(line, text);
+    endWrite();
 }
 
-void setBottom(const String &text) {
-    Guard g;
-    gBottom = text;
+void setLine(char *line, const char *text) {
+    portENTER_CRITICAL(&gWriterMux);
+    writeLine(line, text ? text : "");
+    portEXIT_CRITICAL(&gWriterMux);
 }
+}  // namespace
+
+namespace Display {
+
+void setTop(const char *text) { setLine(gTop, text); }
+
+void setBottom(const char *text) { setLine(gBottom, text); }
 
 void setIcon(int icon) {
-    Guard g;
-    gIcon = icon;
+    portENTER_CRITICAL(&gWriterMux);
+    if (gIcon != icon) {
+        beginWrite();
+        gIcon = icon;
+        endWrite();
+    }
+    portEXIT_CRITICAL(&gWriterMux);
 }
 
-void setKeyInfo(const String &text) {
-    Guard g;
-    gKeyInfo = text;
+void setKeyInfo(const char *label) {
+    portENTER_CRITICAL(&gWriterMux);
+    copyLine(gKeyInfo, label);
     gKeyInfoPending = true;
+    portEXIT_CRITICAL(&gWriterMux);
 }
 
-bool takeKeyInfo(String &out) {
-    Guard g;
-    if (!gKeyInfoPending) return false;
-    out = gKeyInfo;
+bool takeKeyInfo(char *label) {
+    portENTER_CRITICAL(&gWriterMux);
+    bool pending = gKeyInfoPending;
+    if (pending) memcpy(label, gKeyInfo, kLineSize);
     gKeyInfoPending = false;
-    return true;
+    portEXIT_CRITICAL(&gWriterMux);
+    return pending;
+}
+
+void setLayout(const char *title) {
+    portENTER_CRITICAL(&gWriterMux);
+    copyLine(gLayout, title);
+    portEXIT_CRITICAL(&gWriterMux);
+}
+
+void showLayout() {
+    char text[kLineSize];
+    portENTER_CRITICAL(&gWriterMux);
+    snprintf(text, sizeof(text), "@%s", gLayout);
+    writeLine(gBottom, text);
+    portEXIT_CRITICAL(&gWriterMux);
+}
+
+void snapshot(State &out) {
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&gSeq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;  // writer mid-update
+        memcpy(out.top, gTop, sizeof(out.top));
+        memcpy(out.bottom, gBottom, sizeof(out.bottom));
+        out.icon = gIcon;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&gSeq, __ATOMIC_RELAXED) == seq) {
+            out.generation = seq / 2;
+            return;
+        }
+    }
 }
 
-void snapshot(String &top, String &bottom, int &icon) {
-    Guard g;
-    top = gTop;
-    bottom = gBottom;
-    icon = gIcon;
+uint32_t generation() {
+    return __atomic_load_n(&gSeq, __ATOMIC_ACQUIRE) / 2;
 }
 
 }  // namespace Display
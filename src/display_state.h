@@ -4,24 +4,49 @@
 
 // Thread-safe holder for the OLED screen state. The status lines, icon and the
 // "last pressed key" label are written from several tasks across both cores
-// (loop, generalTask, the encoder tasks). A mutex guards every access so the
-// String members are never read while another core is mutating them.
+// (loop, generalTask, the encoder tasks) and read by the render task.
+//
+// The state lives in fixed char buffers behind a sequence lock: writers copy
+// in under a short critical section and never wait on the renderer; readers
+// take no lock and retry if a write raced with their copy. Key labels and the
+// layout title are copied in as text too: the LabelPool they come from
+// belongs to the input task and is rebuilt on every reload.
 namespace Display {
 
-// Create the guarding mutex. Call once in setup() before any task starts.
-void begin();
+// Longest status line kept, including the terminator. Longer text is cut.
+const size_t kLineSize = 32;
 
-void setTop(const String &text);
-void setBottom(const String &text);
+struct State {
+    char top[kLineSize];
+    char bottom[kLineSize];
+    int icon;
+    // Bumped by every write that changed something.
+    uint32_t generation;
+};
+
+void setTop(const char *text);
+void setBottom(const char *text);
+inline void setTop(const String &text) { setTop(text.c_str()); }
+inline void setBottom(const String &text) { setBottom(text.c_str()); }
 void setIcon(int icon);
 
-// Record the most recently activated key/macro name to show on the next render.
-void setKeyInfo(const String &text);
-// If a new key info has been set since the last call, copy it into `out` and
-// return true (clearing the pending flag); otherwise return false.
-bool takeKeyInfo(String &out);
+// Record the label of the most recently activated key/macro to show on the
+// next render.
+void setKeyInfo(const char *label);
+// If a new key info has been set since the last call, copy it to `label`
+// (kLineSize bytes) and return true, clearing the pending flag; otherwise
+// return false.
+bool takeKeyInfo(char *label);
+
+// Title of the active layout, for the idle message.
+void setLayout(const char *title);
+// Show "@<layout title>" on the bottom line.
+void showLayout();
+
+// Copy a consistent view of the current state out for rendering.
+void snapshot(State &out);
 
-// Copy the current state out for rendering.
-void snapshot(String &top, String &bottom, int &icon);
+// Current State::generation, without copying the state.
+uint32_t generation();
 
 }  // namespace Display
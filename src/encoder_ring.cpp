@@ -0,0 +1,54 @@
+#include "encoder_ring.h"
+
+namespace {
+inline uint32_t IRAM_ATTR pack(int8_t direction, uint8_t count,
+                                uint16_t timeMs) {
+    return (uint8_t)direction | (count << 8) | ((uint32_t)timeMs << 16);
+}
+}  // namespace
+
+EncoderRing::PushResult IRAM_ATTR EncoderRing::push(int8_t direction,
+                                                    uint16_t timeMs) {
+    uint32_t head = head_;
+    uint32_t tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+
+    // Merge into the newest event unless the consumer has already taken it
+    // (the slot then reads 0 and the CAS fails).
+    if (head != tail) {
+        uint32_t *last = &slots_[(head - 1) & (kSize - 1)];
+        uint32_t old = __atomic_load_n(last, __ATOMIC_ACQUIRE);
+        while (old != 0 && (int8_t)(old & 0xFF) == direction &&
+               ((old >> 8) & 0xFF) < 0xFF) {
+            uint8_t count = ((old >> 8) & 0xFF) + 1;
+            if (__atomic_compare_exchange_n(last, &old,
+                                            pack(direction, count, timeMs),
+                                            false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                return kMerged;
+            }
+        }
+    }
+
+    if (head - tail >= kSize) {
+        dropped_++;
+        return kDropped;
+    }
+    __atomic_store_n(&slots_[head & (kSize - 1)], pack(direction, 1, timeMs),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&head_, head + 1, __ATOMIC_RELEASE);
+    return kAppended;
+}
+
+bool EncoderRing::pop(Event &out) {
+    uint32_t tail = tail_;
+    if (tail == __atomic_load_n(&head_, __ATOMIC_ACQUIRE)) return false;
+
+    uint32_t value =
+        __atomic_exchange_n(&slots_[tail & (kSize - 1)], 0, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&tail_, tail + 1, __ATOMIC_RELEASE);
+
+    out.direction = (int8_t)(value & 0xFF);
+    out.count = (value >> 8) & 0xFF;
+    out.timeMs = value >> 16;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Lock-free single-producer / single-consumer queue of encoder detents. The
+// producer (the onboard encoder ISR, or the extension board task) never
+// blocks: a detent in the same direction as the newest event the consumer has
+// not taken yet is folded into that event's count, so a fast spin becomes one
+// "CW x5" event instead of filling the ring. Only a full ring of events that
+// cannot be merged drops a detent (counted in dropped()).
+//
+// Each slot is one 32-bit word (direction, count, time) updated with atomic
+// CAS / exchange, which is what makes merging safe against the consumer
+// taking the same slot.
+class EncoderRing {
+   public:
+    static const uint32_t kSize = 16;  // power of two
+
+    struct Event {
+        int8_t direction;  // 1 CW, -1 CCW
+        uint8_t count;     // detents folded into this event
+        uint16_t timeMs;   // low 16 bits of millis() at the newest detent
+    };
+
+    EncoderRing() : head_(0), tail_(0), dropped_(0) {
+        memset(slots_, 0, sizeof(slots_));
+    }
+
+    enum PushResult : uint8_t { kDropped, kMerged, kAppended };
+
+    // Producer side. ISR safe. Only kAppended leaves a new event for the
+    // consumer; a merged detent rides on one it has not taken yet.
+    PushResult IRAM_ATTR push(int8_t direction, uint16_t timeMs);
+
+    // Consumer side. Returns false when empty.
+    bool pop(Event &out);
+
+    uint32_t dropped() const { return dropped_; }
+
+   private:
+    uint32_t slots_[kSize];  // 0 = free / taken by the consumer
+    uint32_t head_;          // written by the producer only
+    uint32_t tail_;          // written by the consumer only
+    uint32_t dropped_;
+};
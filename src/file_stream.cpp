@@ -0,0 +1,48 @@
+#include "file_stream.h"
+
+namespace {
+// Updated from the loop and the HTTP server
+FileStream::Stats gStats = {0, 0, 0};
+}  // namespace
+
+namespace FileStream {
+
+size_t copy(File &file, Print &out) {
+    uint8_t chunk[kChunkSize];
+    size_t total = 0;
+    for (;;) {
+        size_t read = file.read(chunk, sizeof(chunk));
+        if (read == 0) break;
+        size_t written = out.write(chunk, read);
+        total += written;
+        if (written < read) break;
+    }
+    __atomic_fetch_add(&gStats.transfers, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&gStats.bytes, total, __ATOMIC_RELAXED);
+    return total;
+}
+
+bool copy(FS &fs, const char *path, Print &out) {
+    File file = fs.open(path, "r");
+    if (!file) {
+        __atomic_fetch_add(&gStats.failures, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    copy(file, out);
+    file.close();
+    return true;
+}
+
+size_t fill(File &file, uint8_t *buffer, size_t size) {
+    size_t read = file.read(buffer, size);
+    if (read == 0) return 0;
+    __atomic_fetch_add(&gStats.bytes, read, __ATOMIC_RELAXED);
+    if (!file.available()) {
+        __atomic_fetch_add(&gStats.transfers, 1, __ATOMIC_RELAXED);
+    }
+    return read;
+}
+
+const Stats &stats() { return gStats; }
+
+}  // namespace FileStream
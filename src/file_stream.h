@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Copies files to a Print (Serial, an HTTP response) in fixed-size chunks
+// through a stack buffer, so sending a config costs kChunkSize bytes of stack
+// whatever the file size, instead of a String of the whole file plus parsed
+// and re-serialized copies of it.
+namespace FileStream {
+
+const size_t kChunkSize = 512;
+
+struct Stats {
+    uint32_t transfers;  // files copied
+    uint32_t bytes;      // bytes copied in total
+    uint32_t failures;   // files that could not be opened
+};
+
+// Copy the rest of `file` to `out`. Returns the bytes written.
+size_t copy(File &file, Print &out);
+// Open `path` on `fs` and copy it. Returns false if it cannot be opened.
+bool copy(FS &fs, const char *path, Print &out);
+
+// Pull-style copy for responses that ask for their next piece (async HTTP):
+// read up to `size` bytes of `file` into `buffer`. Returns the bytes read
+// (0 at the end of the file); the read that reaches the end counts the
+// transfer.
+size_t fill(File &file, uint8_t *buffer, size_t size);
+
+const Stats &stats();
+
+}  // namespace FileStream
@@ -0,0 +1,34 @@
+#include "frame_diff.h"
+
+#include <string.h>
+
+uint8_t FrameDiff::diff(const uint8_t *frame, Span *spans) {
+    const size_t rowBytes = kTileCols * kTileBytes;
+    uint8_t count = 0;
+
+    for (uint8_t ty = 0; ty < kTileRows; ty++) {
+        const uint8_t *row = frame + ty * rowBytes;
+        uint8_t *sentRow = sent_ + ty * rowBytes;
+
+        int first = -1;
+        int last = -1;
+        for (uint8_t tx = 0; tx < kTileCols; tx++) {
+            if (valid_ && memcmp(row + tx * kTileBytes,
+                                 sentRow + tx * kTileBytes, kTileBytes) == 0) {
+                continue;
+            }
+            if (first < 0) first = tx;
+            last = tx;
+        }
+        if (first < 0) continue;
+
+        memcpy(sentRow, row, rowBytes);
+        spans[count].tileX = first;
+        spans[count].tileY = ty;
+        spans[count].tileWidth = last - first + 1;
+        count++;
+    }
+
+    valid_ = true;
+    return count;
+}
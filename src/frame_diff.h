@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Remembers the frame last pushed to the SSD1306 and works out which tiles of
+// a newly drawn u8g2 buffer differ from it, so only those go over I2C
+// (u8g2.updateDisplayArea) instead of the whole 512-byte frame.
+//
+// u8g2 full-buffer layout: one tile row per 8 pixel rows, each tile row is
+// kTileCols tiles of 8 bytes.
+class FrameDiff {
+   public:
+    // 128 x 32 panel.
+    static const uint8_t kTileCols = 16;
+    static const uint8_t kTileRows = 4;
+    static const size_t kTileBytes = 8;
+    static const size_t kFrameBytes = kTileCols * kTileRows * kTileBytes;
+
+    // Changed tiles of one tile row, in updateDisplayArea() units.
+    struct Span {
+        uint8_t tileX;
+        uint8_t tileY;
+        uint8_t tileWidth;
+    };
+
+    FrameDiff() : valid_(false) {}
+
+    // Forget the remembered frame; the next diff() reports every row.
+    void invalidate() { valid_ = false; }
+
+    // Compare `frame` with the last one, record it as sent, and fill `spans`
+    // (room for kTileRows) with one span per row that changed. Returns the
+    // number of spans; 0 when nothing changed.
+    uint8_t diff(const uint8_t *frame, Span *spans);
+
+   private:
+    uint8_t sent_[kFrameBytes];
+    bool valid_;
+};
+
+// Renderer counters, reported by the READ_STATS serial command.
+struct RenderStats {
+    uint32_t rendered;   // frames drawn and diffed
+    uint32_t skipped;    // passes with nothing new to draw
+    uint32_t bytesSent;  // tile bytes pushed to the panel
+};
@@ -0,0 +1,143 @@
+#include "gesture.h"
+
+namespace {
+const uint32_t kNoDeadline = UINT32_MAX;
+}  // namespace
+
+GestureRecognizer::GestureRecognizer(Listener &listener, uint8_t inputCount)
+    : listener_(listener),
+      inputCount_(inputCount < kMaxInputs ? inputCount : kMaxInputs),
+      holdMs_(1000),
+      doubleTapMs_(300),
+      doubleTap_(0),
+      down_(0),
+      chordCount_(0),
+      activeChords_(0) {
+    for (uint8_t i = 0; i < kMaxChords; i++) {
+        chords_[i] = 0;
+    }
+    for (uint8_t i = 0; i < kMaxInputs; i++) {
+        buttons_[i].phase = kIdle;
+        buttons_[i].sinceMs = 0;
+    }
+}
+
+int8_t GestureRecognizer::addChord(Mask inputs) {
+    if (chordCount_ >= kMaxChords || !inputs) return -1;
+    chords_[chordCount_] = inputs;
+    return chordCount_++;
+}
+
+void GestureRecognizer::update(uint8_t input, bool pressed, uint32_t nowMs) {
+    if (input >= inputCount_) return;
+    Mask bit = (Mask)1 << input;
+    Button &button = buttons_[input];
+
+    if (pressed) {
+        if (down_ & bit) return;
+        down_ |= bit;
+        button.phase = button.phase == kTapPending ? kSecondDown : kDown;
+        button.sinceMs = nowMs;
+        checkChords(nowMs);
+        return;
+    }
+
+    if (!(down_ & bit)) return;
+    down_ &= ~bit;
+
+    for (uint8_t c = 0; c < chordCount_; c++) {
+        if ((activeChords_ & (1 << c)) && (chords_[c] & bit)) {
+            activeChords_ &= ~(1 << c);
+            listener_.gesture(kChordEnd, c, nowMs);
+        }
+    }
+
+    switch (button.phase) {
+        case kDown:
+            if (doubleTap_ & bit) {
+                button.phase = kTapPending;
+                button.sinceMs = nowMs;
+                return;
+            }
+            listener_.gesture(kTap, input, nowMs);
+            break;
+        case kSecondDown:
+            listener_.gesture(kDoubleTap, input, nowMs);
+            break;
+        case kHeld:
+            listener_.gesture(kHoldEnd, input, nowMs);
+            break;
+        default:
+            break;
+    }
+    button.phase = kIdle;
+}
+
+void GestureRecognizer::holdNow(uint32_t nowMs) {
+    for (uint8_t i = 0; i < inputCount_; i++) {
+        if (buttons_[i].phase != kDown) continue;
+        buttons_[i].phase = kHeld;
+        listener_.gesture(kHold, i, nowMs);
+    }
+}
+
+void GestureRecognizer::checkChords(uint32_t nowMs) {
+    for (uint8_t c = 0; c < chordCount_; c++) {
+        if ((activeChords_ & (1 << c)) || (down_ & chords_[c]) != chords_[c]) {
+            continue;
+        }
+        // A member already holding (or held) keeps that gesture; the chord
+        // needs every member still undecided.
+        bool free = true;
+        for (uint8_t i = 0; i < inputCount_; i++) {
+            if ((chords_[c] >> i) & 1) {
+                Phase phase = buttons_[i].phase;
+                if (phase == kHeld || phase == kConsumed) free = false;
+            }
+        }
+        if (!free) continue;
+        for (uint8_t i = 0; i < inputCount_; i++) {
+            if ((chords_[c] >> i) & 1) buttons_[i].phase = kConsumed;
+        }
+        activeChords_ |= 1 << c;
+        listener_.gesture(kChord, c, nowMs);
+    }
+}
+
+uint32_t GestureRecognizer::deadline(const Button &button) const {
+    switch (button.phase) {
+        case kDown:
+            return button.sinceMs + holdMs_;
+        case kTapPending:
+            return button.sinceMs + doubleTapMs_;
+        default:
+            return kNoDeadline;
+    }
+}
+
+void GestureRecognizer::tick(uint32_t nowMs) {
+    for (uint8_t i = 0; i < inputCount_; i++) {
+        Button &button = buttons_[i];
+        if (button.phase == kDown && nowMs - button.sinceMs >= holdMs_) {
+            button.phase = kHeld;
+            listener_.gesture(kHold, i, nowMs);
+        } else if (button.phase == kTapPending &&
+                   nowMs - button.sinceMs >= doubleTapMs_) {
+            button.phase = kIdle;
+            listener_.gesture(kTap, i, nowMs);
+        }
+    }
+}
+
+uint32_t GestureRecognizer::nextTickIn(uint32_t nowMs) const {
+    uint32_t next = kNoDeadline;
+    for (uint8_t i = 0; i < inputCount_; i++) {
+        uint32_t due = deadline(buttons_[i]);
+        if (due == kNoDeadline) continue;
+        // Wrap-safe "due - now", clamped at zero for overdue buttons
+        int32_t left = (int32_t)(due - nowMs);
+        uint32_t wait = left > 0 ? (uint32_t)left : 0;
+        if (wait < next) next = wait;
+    }
+    return next;
+}
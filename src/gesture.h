@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+// Timer-based tap / double-tap / hold / chord recognizer over up to 64
+// buttons. Pure logic: the caller feeds debounced edges and its own clock,
+// so it never delays and runs the same against a virtual clock on the host.
+//
+// Per button:
+//   kTap        released before holdMs (reported on release, or once the
+//               double-tap window ran out for buttons with double-tap)
+//   kDoubleTap  second press within doubleTapMs of a tap (on its release)
+//   kHold       still down after holdMs; kHoldEnd on the later release
+// Per registered chord (a mask of buttons):
+//   kChord      every member is down; the members report nothing else until
+//               they are released
+//   kChordEnd   the first member of an active chord was released
+//
+// That covers the configuration buttons as well as tap-hold / mod-tap style
+// keys (kTap sends the tap key, kHold / kHoldEnd press and release the
+// modifier).
+class GestureRecognizer {
+   public:
+    typedef uint64_t Mask;
+    static const uint8_t kMaxInputs = 64;
+    static const uint8_t kMaxChords = 4;
+
+    enum Gesture : uint8_t {
+        kTap,
+        kDoubleTap,
+        kHold,
+        kHoldEnd,
+        kChord,
+        kChordEnd,
+    };
+
+    class Listener {
+       public:
+        virtual ~Listener() {}
+        // `index` is the button, or the chord index for kChord / kChordEnd.
+        virtual void gesture(Gesture gesture, uint8_t index,
+                             uint32_t nowMs) = 0;
+    };
+
+    GestureRecognizer(Listener &listener, uint8_t inputCount);
+
+    void setTiming(uint16_t holdMs, uint16_t doubleTapMs) {
+        holdMs_ = holdMs;
+        doubleTapMs_ = doubleTapMs;
+    }
+    // Buttons that wait for a possible second tap. Others report kTap on
+    // release without delay.
+    void setDoubleTap(Mask inputs) { doubleTap_ = inputs; }
+    // Register a chord; returns its index, or -1 when the table is full.
+    int8_t addChord(Mask inputs);
+
+    void update(uint8_t input, bool pressed, uint32_t nowMs);
+    // Report kHold right away for every button pressed but not decided yet
+    // (another key went down while a tap-hold key was pending).
+    void holdNow(uint32_t nowMs);
+    // Fire holds and expired double-tap windows due at nowMs.
+    void tick(uint32_t nowMs);
+    // Milliseconds from nowMs until tick() has work, or UINT32_MAX if none.
+    uint32_t nextTickIn(uint32_t nowMs) const;
+
+   private:
+    enum Phase : uint8_t {
+        kIdle,
+        kDown,        // first press, hold not reached yet
+        kHeld,        // hold reported
+        kTapPending,  // released, waiting for a second tap
+        kSecondDown,  // second press of a double tap
+        kConsumed,    // part of a chord, silent until released
+    };
+
+    struct Button {
+        Phase phase;
+        uint32_t sinceMs;  // last press, or release for kTapPending
+    };
+
+    void checkChords(uint32_t nowMs);
+    uint32_t deadline(const Button &button) const;
+
+    Listener &listener_;
+    uint8_t inputCount_;
+    uint16_t holdMs_;
+    uint16_t doubleTapMs_;
+    Mask doubleTap_;
+    Mask down_;
+    Mask chords_[kMaxChords];
+    uint8_t chordCount_;
+    uint8_t activeChords_;  // bit per chord
+    Button buttons_[kMaxInputs];
+};
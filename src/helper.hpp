@@ -1,3 +1,4 @@
+#include "storage.h"
 
 // Make size of files human readable
 // source: https://github.com/CelliesProjects/minimalUploadAuthESP32
@@ -15,8 +16,8 @@ String humanReadableSize(const size_t bytes) {
 // list all of the files, if ishtml=true, return html rather than simple text
 String listFiles(bool ishtml = false) {
     String returnText = "";
-    Serial.println("Listing files stored on SPIFFS");
-    File root = SPIFFS.open("/");
+    Serial.println("Listing files in storage");
+    File root = Storage::fs().open("/");
     File foundfile = root.openNextFile();
     if (ishtml) {
         returnText +=
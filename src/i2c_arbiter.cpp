@@ -0,0 +1,64 @@
+#include "i2c_arbiter.h"
+
+#include <freertos/semphr.h>
+
+namespace {
+// Guards the schedule's queues; held only to push or pop.
+portMUX_TYPE gScheduleMux = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t clockUs() { return micros(); }
+}  // namespace
+
+I2cArbiter::I2cArbiter() : schedule_(clockUs), task_(nullptr) {}
+
+void I2cArbiter::begin() {
+    if (task_) return;
+    // Above every task that submits jobs, so a queued job starts as soon as
+    // the bus is free.
+    xTaskCreate(taskEntry, "I2C Arbiter", 4096, this, 3, &task_);
+}
+
+bool I2cArbiter::run(I2cDevice device, I2cPriority priority, I2cJob job,
+                     void *arg) {
+    // Not started yet, or a job issuing a nested transaction
+    if (!task_ || xTaskGetCurrentTaskHandle() == task_) {
+        return schedule_.executeNow(device, job, arg);
+    }
+
+    StaticSemaphore_t doneBuffer;
+    Waiter waiter;
+    waiter.result = false;
+    waiter.done = xSemaphoreCreateBinaryStatic(&doneBuffer);
+    // Every submitter waits for its job, so the queues only fill up with
+    // more submitting tasks than slots
+    while (true) {
+        portENTER_CRITICAL(&gScheduleMux);
+        bool queued = schedule_.push(priority, device, job, arg, &waiter);
+        portEXIT_CRITICAL(&gScheduleMux);
+        if (queued) break;
+        vTaskDelay(1);
+    }
+    xTaskNotifyGive(task_);
+    xSemaphoreTake(waiter.done, portMAX_DELAY);
+    vSemaphoreDelete(waiter.done);
+    return waiter.result;
+}
+
+void I2cArbiter::taskEntry(void *arbiter) {
+    static_cast<I2cArbiter *>(arbiter)->serve();
+}
+
+void I2cArbiter::serve() {
+    I2cSchedule::Entry entry;
+    while (true) {
+        // One notification per queued job
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+        portENTER_CRITICAL(&gScheduleMux);
+        bool taken = schedule_.pop(&entry);
+        portEXIT_CRITICAL(&gScheduleMux);
+        if (!taken) continue;
+        Waiter *waiter = static_cast<Waiter *>(entry.owner);
+        waiter->result = schedule_.execute(entry);
+        xSemaphoreGive(waiter->done);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "i2c_schedule.h"
+
+// Sole owner of Wire once begin() has run. Every bus access is a job handed
+// to run(), which queues it and blocks the caller until the arbiter task has
+// executed it. Jobs never interleave; which waiting job goes next is up to
+// I2cSchedule (kI2cHigh first, without starving kI2cLow), so keep
+// low-priority jobs small (one display page, not a whole frame).
+class I2cArbiter {
+   public:
+    typedef I2cSchedule::DeviceStats DeviceStats;
+
+    I2cArbiter();
+
+    // Create the arbiter task. Before this, run() executes jobs inline on
+    // the caller (setup() owns the bus alone then).
+    void begin();
+
+    bool run(I2cDevice device, I2cPriority priority, I2cJob job, void *arg);
+
+    const DeviceStats &stats(I2cDevice device) const {
+        return schedule_.stats(device);
+    }
+
+   private:
+    // A queued job's submitter, waiting on `done`
+    struct Waiter {
+        bool result;
+        SemaphoreHandle_t done;
+    };
+
+    static void taskEntry(void *arbiter);
+    void serve();
+
+    I2cSchedule schedule_;
+    TaskHandle_t task_;
+};
@@ -0,0 +1,62 @@
+#include "i2c_schedule.h"
+
+#include <string.h>
+
+I2cSchedule::I2cSchedule(Clock clockUs) : clock_(clockUs), highRun_(0) {
+    memset(queues_, 0, sizeof(queues_));
+    memset(stats_, 0, sizeof(stats_));
+}
+
+bool I2cSchedule::push(I2cPriority priority, I2cDevice device, I2cJob job,
+                       void *arg, void *owner) {
+    Queue &queue = queues_[priority];
+    if (queue.count == kQueueLength) return false;
+    Entry &entry = queue.entries[(queue.head + queue.count) % kQueueLength];
+    entry.job = job;
+    entry.arg = arg;
+    entry.device = device;
+    entry.queuedUs = clock_();
+    entry.owner = owner;
+    queue.count++;
+    return true;
+}
+
+bool I2cSchedule::take(Queue &queue, Entry *entry) {
+    if (!queue.count) return false;
+    *entry = queue.entries[queue.head];
+    queue.head = (queue.head + 1) % kQueueLength;
+    queue.count--;
+    return true;
+}
+
+bool I2cSchedule::pop(Entry *entry) {
+    Queue &high = queues_[kI2cHigh];
+    Queue &low = queues_[kI2cLow];
+    if (low.count && (highRun_ >= kMaxHighRun || !high.count)) {
+        highRun_ = 0;
+        return take(low, entry);
+    }
+    if (!take(high, entry)) return false;
+    if (low.count) highRun_++;
+    return true;
+}
+
+bool I2cSchedule::execute(const Entry &entry) {
+    uint32_t startUs = clock_();
+    bool result = entry.job(entry.arg);
+    uint32_t busUs = clock_() - startUs;
+    uint32_t waitUs = startUs - entry.queuedUs;
+
+    DeviceStats &s = stats_[entry.device];
+    s.transactions++;
+    s.totalWaitUs += waitUs;
+    s.totalBusUs += busUs;
+    if (waitUs > s.maxWaitUs) s.maxWaitUs = waitUs;
+    if (busUs > s.maxBusUs) s.maxBusUs = busUs;
+    return result;
+}
+
+bool I2cSchedule::executeNow(I2cDevice device, I2cJob job, void *arg) {
+    Entry entry = {job, arg, device, clock_(), nullptr};
+    return execute(entry);
+}
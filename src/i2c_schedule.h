@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Devices on the shared Wire bus, for per-device stats.
+enum I2cDevice : uint8_t {
+    kI2cOled = 0,
+    kI2cExtension,
+    kI2cDeviceCount,
+};
+
+// Input reads (encoder, buttons) go ahead of anything queued at kI2cLow
+// (display pages, presence probes).
+enum I2cPriority : uint8_t { kI2cHigh, kI2cLow };
+
+// One bus transaction. Returns success.
+typedef bool (*I2cJob)(void *arg);
+
+// The I2cArbiter's scheduling without the RTOS: jobs waiting per priority,
+// which one runs next, and per-device timing. Not thread safe; the arbiter
+// serialises access to it.
+//
+// A waiting kI2cHigh job goes first, except that after kMaxHighRun of them
+// in a row a waiting kI2cLow job gets its turn, so a busy input device (the
+// PCF8574 is polled every 3 ms) cannot keep the display off the bus.
+class I2cSchedule {
+   public:
+    struct DeviceStats {
+        uint32_t transactions;
+        uint32_t maxWaitUs;  // queued -> started
+        uint32_t maxBusUs;   // started -> finished
+        uint64_t totalWaitUs;
+        uint64_t totalBusUs;
+    };
+
+    struct Entry {
+        I2cJob job;
+        void *arg;
+        I2cDevice device;
+        uint32_t queuedUs;
+        // The submitter's own bookkeeping (result, completion signal)
+        void *owner;
+    };
+
+    static const size_t kQueueLength = 8;
+    static const uint8_t kMaxHighRun = 4;
+
+    typedef uint32_t (*Clock)();
+
+    explicit I2cSchedule(Clock clockUs);
+
+    // Queue a job, stamped with the current time. False when the queue for
+    // that priority is full.
+    bool push(I2cPriority priority, I2cDevice device, I2cJob job, void *arg,
+              void *owner);
+    // Take the job to run next. False when none is waiting.
+    bool pop(Entry *entry);
+    // Run a job now and record its wait and bus time. Returns its result.
+    bool execute(const Entry &entry);
+    // Run a job that was never queued.
+    bool executeNow(I2cDevice device, I2cJob job, void *arg);
+
+    size_t waiting(I2cPriority priority) const {
+        return queues_[priority].count;
+    }
+
+    const DeviceStats &stats(I2cDevice device) const {
+        return stats_[device];
+    }
+
+   private:
+    struct Queue {
+        Entry entries[kQueueLength];
+        uint8_t head;
+        uint8_t count;
+    };
+
+    static bool take(Queue &queue, Entry *entry);
+
+    Clock clock_;
+    Queue queues_[2];
+    // kI2cHigh jobs taken in a row while a kI2cLow one waited
+    uint8_t highRun_;
+    DeviceStats stats_[kI2cDeviceCount];
+};
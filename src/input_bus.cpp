@@ -0,0 +1,33 @@
+#include "input_bus.h"
+
+void InputBus::begin() {
+    if (!queue_) queue_ = xQueueCreate(kQueueLength, sizeof(InputEvent));
+}
+
+bool InputBus::publish(const InputEvent &event) {
+    if (!queue_ || xQueueSend(queue_, &event, 0) != pdTRUE) {
+        __atomic_fetch_add(&dropped_, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+bool IRAM_ATTR InputBus::publishFromISR(const InputEvent &event,
+                                        BaseType_t *woken) {
+    if (!queue_ || xQueueSendFromISR(queue_, &event, woken) != pdTRUE) {
+        __atomic_fetch_add(&dropped_, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+bool InputBus::publish(InputSource source, uint8_t index, int8_t value,
+                       uint8_t count) {
+    InputEvent event = {(uint32_t)millis(), source, index, value, count};
+    return publish(event);
+}
+
+bool InputBus::receive(InputEvent &event, TickType_t wait) {
+    if (!queue_) return false;
+    return xQueueReceive(queue_, &event, wait) == pdTRUE;
+}
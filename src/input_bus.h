@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "input_engine.h"
+
+// Multi-producer queue carrying InputEvents from every input source (loop's
+// matrix / panel scan, the extension board task, encoder interrupts, the
+// macro task) to the single input task that runs the InputEngine. Producers
+// never block: an event that does not fit is dropped and counted. Key
+// producers publish through a KeySync, so a dropped edge is sent again.
+class InputBus {
+   public:
+    static const size_t kQueueLength = 64;
+
+    InputBus() : queue_(nullptr), dropped_(0) {}
+
+    void begin();
+
+    bool publish(const InputEvent &event);
+    bool IRAM_ATTR publishFromISR(const InputEvent &event,
+                                  BaseType_t *woken);
+    // Shorthand for a timestamped event taken now.
+    bool publish(InputSource source, uint8_t index, int8_t value,
+                 uint8_t count = 0);
+
+    // Consumer side: wait up to `wait` ticks for the next event.
+    bool receive(InputEvent &event, TickType_t wait);
+
+    uint32_t dropped() const { return dropped_; }
+
+   private:
+    QueueHandle_t queue_;
+    uint32_t dropped_;
+};
+
+// One producer's debounced keys as the input task has been told about them
+// (bit i = key i). sync() publishes every key that differs from the
+// scanner's state; an edge the bus refuses leaves its bit pending for the
+// next call, so a release is never lost to a full queue and the input task
+// catches up with the scanner once there is room. A press and its release
+// that both miss the queue cancel out.
+class KeySync {
+   public:
+    typedef uint64_t State;
+
+    KeySync() : published_(0) {}
+
+    // Call send(key, pressed) for each key whose state differs, lowest key
+    // first; send returns whether the edge was queued.
+    template <typename Send>
+    void sync(State state, Send send) {
+        State pending = published_ ^ state;
+        while (pending) {
+            int key = __builtin_ctzll(pending);
+            pending &= pending - 1;
+            bool pressed = (state >> key) & 1;
+            if (send((uint8_t)key, pressed)) published_ ^= (State)1 << key;
+        }
+    }
+
+    // Keys whose last edge has not been queued yet.
+    State pending(State state) const { return published_ ^ state; }
+
+   private:
+    State published_;
+};
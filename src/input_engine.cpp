@@ -0,0 +1,154 @@
+#include "input_engine.h"
+
+namespace {
+// Per configuration button: command on release (tap) and once held kHoldMs.
+const InputEngine::Command kConfigTap[InputEngine::kConfigButtons] = {
+    InputEngine::kToggleOutput, InputEngine::kToggleLock,
+    InputEngine::kToggleScreen};
+const InputEngine::Command kConfigHold[InputEngine::kConfigButtons] = {
+    InputEngine::kSwitchBootMode, InputEngine::kSleep,
+    InputEngine::kToggleCaffeine};
+
+// Buttons 1 and 2 together reset the configuration.
+const GestureRecognizer::Mask kResetChord = (1 << 1) | (1 << 2);
+}  // namespace
+
+InputEngine::InputEngine(Actions &actions)
+    : actions_(actions),
+      configListener_(*this),
+      configGestures_(configListener_, kConfigButtons),
+      tapHoldListener_(*this),
+      tapHoldGestures_(tapHoldListener_, GestureRecognizer::kMaxInputs),
+      tapHoldDown_(0),
+      resetArmed_(false),
+      resetStartMs_(0),
+      resetShown_(0) {
+    configGestures_.setTiming(kHoldMs, 0);
+    configGestures_.addChord(kResetChord);
+    tapHoldGestures_.setTiming(kTapHoldMs, 0);
+}
+
+void InputEngine::dispatch(const InputEvent &event) {
+    bool pressed = event.value > 0;
+    switch (event.source) {
+        case kInputMatrix:
+            if (pressed) actions_.activity();
+            if (dispatchTapHold(event, pressed)) break;
+            actions_.key(kInputMatrix, event.index, pressed);
+            break;
+        case kInputExtButton:
+            if (pressed) actions_.activity();
+            actions_.key(kInputExtButton, event.index, pressed);
+            break;
+        case kInputOnboardEncoder:
+        case kInputExtEncoder:
+            if (event.count == 0) break;
+            actions_.activity();
+            actions_.turn((InputSource)event.source, event.value, event.count,
+                          event.timeMs);
+            break;
+        case kInputBdSwitch:
+            // Acts on the press edge only
+            if (!pressed) break;
+            actions_.activity();
+            if (event.index == 0) {
+                actions_.command(kNextLayout);
+            } else if (event.index == 1) {
+                actions_.command(kPreviousLayout);
+            } else {
+                actions_.command(kFirstLayout);
+            }
+            break;
+        case kInputConfigButton:
+            if (pressed) actions_.activity();
+            configGestures_.update(event.index, pressed, event.timeMs);
+            break;
+        case kInputLayer:
+            actions_.layout(event.index);
+            break;
+        case kInputWake:
+            break;
+    }
+}
+
+// Send a matrix key edge through the tap-hold recognizer if the key is a
+// tap-hold key; returns whether it was taken. Any key press first turns
+// pending tap-hold keys into holds, so a mod-tap works as the modifier of a
+// key pressed right after it.
+bool InputEngine::dispatchTapHold(const InputEvent &event, bool pressed) {
+    if (event.index >= GestureRecognizer::kMaxInputs) return false;
+    GestureRecognizer::Mask bit = (GestureRecognizer::Mask)1 << event.index;
+    if (!pressed) {
+        if (!(tapHoldDown_ & bit)) return false;
+        tapHoldDown_ &= ~bit;
+        tapHoldGestures_.update(event.index, false, event.timeMs);
+        return true;
+    }
+    tapHoldGestures_.holdNow(event.timeMs);
+    if (!actions_.beginTapHold(event.index)) return false;
+    tapHoldDown_ |= bit;
+    tapHoldGestures_.update(event.index, true, event.timeMs);
+    return true;
+}
+
+void InputEngine::TapHoldListener::gesture(GestureRecognizer::Gesture gesture,
+                                           uint8_t index, uint32_t nowMs) {
+    engine_.actions_.tapHold(index, gesture);
+}
+
+void InputEngine::ConfigListener::gesture(GestureRecognizer::Gesture gesture,
+                                          uint8_t index, uint32_t nowMs) {
+    switch (gesture) {
+        case GestureRecognizer::kTap:
+            engine_.actions_.command(kConfigTap[index]);
+            break;
+        case GestureRecognizer::kHold:
+            engine_.actions_.command(kConfigHold[index]);
+            break;
+        case GestureRecognizer::kChord:
+            engine_.resetArmed_ = true;
+            engine_.resetStartMs_ = nowMs;
+            engine_.resetShown_ = kResetSeconds;
+            engine_.actions_.resetCountdown(kResetSeconds);
+            break;
+        case GestureRecognizer::kChordEnd:
+            if (engine_.resetArmed_) {
+                engine_.resetArmed_ = false;
+                engine_.actions_.command(kResetCanceled);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void InputEngine::tick(uint32_t nowMs) {
+    configGestures_.tick(nowMs);
+    tapHoldGestures_.tick(nowMs);
+    if (!resetArmed_) return;
+
+    uint32_t elapsed = nowMs - resetStartMs_;
+    if (elapsed >= kResetSeconds * 1000UL) {
+        resetArmed_ = false;
+        actions_.command(kResetConfig);
+        return;
+    }
+    uint8_t left = kResetSeconds - elapsed / 1000;
+    if (left != resetShown_) {
+        resetShown_ = left;
+        actions_.resetCountdown(left);
+    }
+}
+
+uint32_t InputEngine::nextTickIn(uint32_t nowMs) const {
+    uint32_t next = configGestures_.nextTickIn(nowMs);
+    uint32_t tapHold = tapHoldGestures_.nextTickIn(nowMs);
+    if (tapHold < next) next = tapHold;
+    if (resetArmed_) {
+        // Wake on every whole second of the countdown
+        uint32_t elapsed = nowMs - resetStartMs_;
+        uint32_t toSecond = 1000 - elapsed % 1000;
+        if (toSecond < next) next = toSecond;
+    }
+    return next;
+}
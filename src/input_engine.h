@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "gesture.h"
+
+// Where an InputEvent came from.
+enum InputSource : uint8_t {
+    kInputMatrix = 0,     // index: row * COLS + col
+    kInputBdSwitch,       // index: 0 CW, 1 CCW, 2 push
+    kInputConfigButton,   // index: 0..2 (CFG_BTN_PIN_0..2)
+    kInputExtButton,      // index: 0 encoder switch, 1..3 buttons
+    kInputOnboardEncoder, // value: direction, count: detents
+    kInputExtEncoder,     // value: direction, count: detents
+    kInputLayer,          // index: layout to switch to (from a macro)
+    kInputWake,           // no input; wakes the input task for a reload
+};
+
+// One input change, timestamped by its producer. Small enough to be copied
+// through a FreeRTOS queue.
+struct InputEvent {
+    uint32_t timeMs;  // millis() when the change was seen
+    uint8_t source;   // InputSource
+    uint8_t index;
+    int8_t value;     // keys: 1 press, 0 release; encoders: direction
+    uint8_t count;    // encoders: detents folded into the event
+};
+
+// The keymap / action engine's input side: turns the merged event stream of
+// every input source into key edges, tap-hold gestures, encoder turns and
+// panel commands. It holds no keymap (Actions says which keys are tap-hold)
+// and touches no hardware, so it can be driven on the host by feeding it
+// events and a clock.
+//
+// Events must come from a single consumer (the input task), which is what
+// makes the key state it drives race free.
+class InputEngine {
+   public:
+    // Actions of the BD switch and the configuration buttons.
+    enum Command : uint8_t {
+        kNextLayout,
+        kPreviousLayout,
+        kFirstLayout,
+        kToggleLock,
+        kToggleCaffeine,
+        kToggleScreen,
+        kToggleOutput,
+        kSleep,
+        kSwitchBootMode,
+        kResetConfig,
+        kResetCanceled,
+    };
+
+    // Implemented by the firmware (or a test double).
+    class Actions {
+       public:
+        virtual ~Actions() {}
+        // Any press or turn: restart the idle timer.
+        virtual void activity() = 0;
+        // Matrix or extension board key edge.
+        virtual void key(InputSource source, uint8_t index, bool pressed) = 0;
+        // Matrix key press: true if it is bound to a tap-hold (mod-tap) key.
+        // Its edges then come as tapHold() gestures instead of key().
+        virtual bool beginTapHold(uint8_t index) = 0;
+        // Tap-hold matrix key: kTap (released within kTapHoldMs), kHold
+        // (held that long, or another key went down meanwhile) or kHoldEnd
+        // (released after kHold).
+        virtual void tapHold(uint8_t index,
+                             GestureRecognizer::Gesture gesture) = 0;
+        // Encoder turn of `count` detents; timeMs is the newest detent's.
+        virtual void turn(InputSource source, int8_t direction, uint8_t count,
+                          uint32_t timeMs) = 0;
+        virtual void layout(uint8_t index) = 0;
+        virtual void command(Command command) = 0;
+        // CFG1+CFG2 held: seconds left before kResetConfig.
+        virtual void resetCountdown(uint8_t secondsLeft) = 0;
+    };
+
+    // How long a configuration button is held before its hold action runs.
+    static const uint16_t kHoldMs = 1000;
+    static const uint8_t kConfigButtons = 3;
+    // How long a tap-hold key is held before it counts as held.
+    static const uint16_t kTapHoldMs = 200;
+    // How long the reset chord has to stay down.
+    static const uint8_t kResetSeconds = 5;
+
+    explicit InputEngine(Actions &actions);
+
+    void dispatch(const InputEvent &event);
+
+    // Run the holds and reset countdown steps due at nowMs.
+    void tick(uint32_t nowMs);
+    // Milliseconds from nowMs until tick() has work, or UINT32_MAX if none.
+    uint32_t nextTickIn(uint32_t nowMs) const;
+
+   private:
+    // Configuration button gestures -> commands
+    class ConfigListener : public GestureRecognizer::Listener {
+       public:
+        explicit ConfigListener(InputEngine &engine) : engine_(engine) {}
+        void gesture(GestureRecognizer::Gesture gesture, uint8_t index,
+                     uint32_t nowMs) override;
+
+       private:
+        InputEngine &engine_;
+    };
+
+    // Tap-hold key gestures -> Actions::tapHold()
+    class TapHoldListener : public GestureRecognizer::Listener {
+       public:
+        explicit TapHoldListener(InputEngine &engine) : engine_(engine) {}
+        void gesture(GestureRecognizer::Gesture gesture, uint8_t index,
+                     uint32_t nowMs) override;
+
+       private:
+        InputEngine &engine_;
+    };
+
+    bool dispatchTapHold(const InputEvent &event, bool pressed);
+
+    Actions &actions_;
+    ConfigListener configListener_;
+    GestureRecognizer configGestures_;
+    TapHoldListener tapHoldListener_;
+    GestureRecognizer tapHoldGestures_;
+    GestureRecognizer::Mask tapHoldDown_;  // matrix keys being tap-held
+    // Reset countdown, running while resetArmed_
+    bool resetArmed_;
+    uint32_t resetStartMs_;
+    uint8_t resetShown_;  // last secondsLeft reported
+};
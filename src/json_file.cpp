@@ -0,0 +1,15 @@
+#include "json_file.h"
+
+#include <Arduino.h>
+
+namespace JsonFile {
+
+size_t initialCapacity(size_t size) {
+    // Key codes and short labels take about two to three times their text
+    // size as variant slots; start at the low end and let parse() grow it.
+    return size * 2 + 1024;
+}
+
+size_t maxCapacity() { return ESP.getMaxAllocHeap(); }
+
+}  // namespace JsonFile
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <FS.h>
+
+// Parsing of JSON files into transient documents. The document is sized from
+// the file and grown while the parse runs out of memory, so there is no fixed
+// capacity ceiling and nothing stays allocated once the caller is done.
+namespace JsonFile {
+
+// Deepest nesting accepted: macro steps nest two levels per "repeat".
+const uint8_t kNestingLimit = 16;
+
+// First capacity tried for a file of `size` bytes.
+size_t initialCapacity(size_t size);
+// Largest capacity worth trying (the biggest free heap block).
+size_t maxCapacity();
+
+// Parse `file` from its start and call fn(doc) with the parsed document,
+// sized with room for `extraBytes` of strings fn adds. Returns the last parse
+// error; fn runs only on success.
+template <typename Fn>
+DeserializationError parse(File &file, Fn fn, size_t extraBytes = 0) {
+    size_t capacity = initialCapacity(file.size() + extraBytes);
+    for (;;) {
+        file.seek(0);
+        DynamicJsonDocument doc(capacity);
+        DeserializationError err = deserializeJson(
+            doc, file, DeserializationOption::NestingLimit(kNestingLimit));
+        if (!err) {
+            fn(doc);
+            return err;
+        }
+        if (err != DeserializationError::NoMemory ||
+            capacity * 2 > maxCapacity()) {
+            return err;
+        }
+        capacity *= 2;
+    }
+}
+
+}  // namespace JsonFile
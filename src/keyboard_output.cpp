@@ -1,67 +1,240 @@
 #include "keyboard_output.h"
 
-// USB HID needs modifier keys (codes 128-135, i.e. the BLE keyboard's
-// KEY_LEFT_CTRL .. KEY_RIGHT_GUI) sent as raw usages 0xe0-0xe7 rather than as
-// regular key presses. BLE handles those codes directly, so only the USB output
-// remaps them.
-void UsbKeyboardOutput::press(uint8_t keyStroke) {
-    switch (keyStroke) {
-        case 128:  // KEY_LEFT_CTRL
-            UsbHid::pressRaw(0xe0);
-            break;
-        case 129:  // KEY_LEFT_SHIFT
-            UsbHid::pressRaw(0xe1);
-            break;
-        case 130:  // KEY_LEFT_ALT
-            UsbHid::pressRaw(0xe2);
-            break;
-        case 131:  // KEY_LEFT_GUI
-            UsbHid::pressRaw(0xe3);
-            break;
-        case 132:  // KEY_RIGHT_CTRL
-            UsbHid::pressRaw(0xe4);
-            break;
-        case 133:  // KEY_RIGHT_SHIFT
-            UsbHid::pressRaw(0xe5);
-            break;
-        case 134:  // KEY_RIGHT_ALT
-            UsbHid::pressRaw(0xe6);
-            break;
-        case 135:  // KEY_RIGHT_GUI
-            UsbHid::pressRaw(0xe7);
-            break;
-        default:
-            UsbHid::press(keyStroke);
+#include <freertos/semphr.h>
+
+namespace {
+// Report layout: modifiers, reserved, then six key usages.
+const size_t kFirstKeySlot = 2;
+
+// Key codes follow the BleKeyboard / Arduino Keyboard convention:
+// 0-127 ASCII, 128-135 modifiers (KEY_LEFT_CTRL .. KEY_RIGHT_GUI), 136+ raw
+// HID usage + 136.
+const uint8_t kModifierBase = 128;
+const uint8_t kRawUsageBase = 136;
+const uint8_t kLeftShift = 0x02;
+
+// ASCII -> HID usage (US layout). kShift marks characters typed with shift.
+const uint8_t kShift = 0x80;
+const uint8_t kAsciiMap[128] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // NUL .. BEL
+    0x2a, 0x2b, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,  // BS TAB LF VT FF CR ..
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  //
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  //
+    0x2c,                                            // ' '
+    0x1e | kShift,                                   // !
+    0x34 | kShift,                                   // "
+    0x20 | kShift,                                   // #
+    0x21 | kShift,                                   // $
+    0x22 | kShift,                                   // %
+    0x24 | kShift,                                   // &
+    0x34,                                            // '
+    0x26 | kShift,                                   // (
+    0x27 | kShift,                                   // )
+    0x25 | kShift,                                   // *
+    0x2e | kShift,                                   // +
+    0x36,                                            // ,
+    0x2d,                                            // -
+    0x37,                                            // .
+    0x38,                                            // /
+    0x27, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24,  // 0 .. 7
+    0x25, 0x26,                                      // 8 9
+    0x33 | kShift,                                   // :
+    0x33,                                            // ;
+    0x36 | kShift,                                   // <
+    0x2e,                                            // =
+    0x37 | kShift,                                   // >
+    0x38 | kShift,                                   // ?
+    0x1f | kShift,                                   // @
+    0x04 | kShift, 0x05 | kShift, 0x06 | kShift, 0x07 | kShift,  // A .. D
+    0x08 | kShift, 0x09 | kShift, 0x0a | kShift, 0x0b | kShift,  // E .. H
+    0x0c | kShift, 0x0d | kShift, 0x0e | kShift, 0x0f | kShift,  // I .. L
+    0x10 | kShift, 0x11 | kShift, 0x12 | kShift, 0x13 | kShift,  // M .. P
+    0x14 | kShift, 0x15 | kShift, 0x16 | kShift, 0x17 | kShift,  // Q .. T
+    0x18 | kShift, 0x19 | kShift, 0x1a | kShift, 0x1b | kShift,  // U .. X
+    0x1c | kShift, 0x1d | kShift,                                // Y Z
+    0x2f,                                            // [
+    0x31,                                            // bslash
+    0x30,                                            // ]
+    0x23 | kShift,                                   // ^
+    0x2d | kShift,                                   // _
+    0x35,                                            // `
+    0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,  // a .. h
+    0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,  // i .. p
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b,  // q .. x
+    0x1c, 0x1d,                                      // y z
+    0x2f | kShift,                                   // {
+    0x31 | kShift,                                   // |
+    0x30 | kShift,                                   // }
+    0x35 | kShift,                                   // ~
+    0x00,                                            // DEL
+};
+
+// Put `usage` in the first free key slot unless it is there already. More
+// than six keys down: the extra one is dropped (no rollover).
+void addUsage(uint8_t *report, uint8_t usage) {
+    int freeSlot = -1;
+    for (size_t i = kFirstKeySlot; i < KeyboardOutput::kReportSize; i++) {
+        if (report[i] == usage) return;
+        if (report[i] == 0 && freeSlot < 0) freeSlot = i;
+    }
+    if (freeSlot >= 0) report[freeSlot] = usage;
+}
+
+// Recursive lock scope, so a frame owner can keep calling into the output.
+struct Guard {
+    explicit Guard(SemaphoreHandle_t lock) : lock_(lock) {
+        if (lock_) xSemaphoreTakeRecursive(lock_, portMAX_DELAY);
+    }
+    ~Guard() {
+        if (lock_) xSemaphoreGiveRecursive(lock_);
     }
+    SemaphoreHandle_t lock_;
+};
+}  // namespace
+
+KeyboardOutput::KeyboardOutput()
+    : lock_(xSemaphoreCreateRecursiveMutex()),
+      dirty_(false),
+      frameDepth_(0),
+      reportsSent_(0) {
+    memset(report_, 0, sizeof(report_));
+    memset(macroReport_, 0, sizeof(macroReport_));
 }
 
-void UsbKeyboardOutput::release(uint8_t keyStroke) {
-    switch (keyStroke) {
-        case 128:  // KEY_LEFT_CTRL
-            UsbHid::releaseRaw(0xe0);
-            break;
-        case 129:  // KEY_LEFT_SHIFT
-            UsbHid::releaseRaw(0xe1);
-            break;
-        case 130:  // KEY_LEFT_ALT
-            UsbHid::releaseRaw(0xe2);
-            break;
-        case 131:  // KEY_LEFT_GUI
-            UsbHid::releaseRaw(0xe3);
-            break;
-        case 132:  // KEY_RIGHT_CTRL
-            UsbHid::releaseRaw(0xe4);
-            break;
-        case 133:  // KEY_RIGHT_SHIFT
-            UsbHid::releaseRaw(0xe5);
-            break;
-        case 134:  // KEY_RIGHT_ALT
-            UsbHid::releaseRaw(0xe6);
-            break;
-        case 135:  // KEY_RIGHT_GUI
-            UsbHid::releaseRaw(0xe7);
-            break;
-        default:
-            UsbHid::release(keyStroke);
+bool KeyboardOutput::apply(uint8_t *report, uint8_t keyStroke,
+                           bool pressed) {
+    uint8_t usage = 0;
+    uint8_t modifiers = 0;
+    if (keyStroke >= kRawUsageBase) {
+        usage = keyStroke - kRawUsageBase;
+    } else if (keyStroke >= kModifierBase) {
+        modifiers = 1 << (keyStroke - kModifierBase);
+    } else {
+        usage = kAsciiMap[keyStroke];
+        if (usage & kShift) {
+            modifiers = kLeftShift;
+            usage &= ~kShift;
+        }
+        if (!usage) return false;
+    }
+
+    uint8_t before[kReportSize];
+    memcpy(before, report, kReportSize);
+
+    if (pressed) {
+        report[0] |= modifiers;
+        if (usage) addUsage(report, usage);
+    } else {
+        report[0] &= ~modifiers;
+        if (usage) {
+            for (size_t i = kFirstKeySlot; i < kReportSize; i++) {
+                if (report[i] == usage) report[i] = 0;
+            }
+        }
     }
+
+    return memcmp(before, report, kReportSize) != 0;
+}
+
+void KeyboardOutput::flush() {
+    if (!dirty_) return;
+    // The other keys first; macro keys fill the slots left
+    uint8_t merged[kReportSize];
+    memcpy(merged, report_, sizeof(merged));
+    merged[0] |= macroReport_[0];
+    for (size_t i = kFirstKeySlot; i < kReportSize; i++) {
+        if (macroReport_[i]) addUsage(merged, macroReport_[i]);
+    }
+    sendReport(merged);
+    reportsSent_++;
+    dirty_ = false;
+}
+
+void KeyboardOutput::beginFrame() {
+    if (lock_) xSemaphoreTakeRecursive(lock_, portMAX_DELAY);
+    frameDepth_++;
+}
+
+void KeyboardOutput::stagePress(uint8_t keyStroke) {
+    Guard g(lock_);
+    if (apply(report_, keyStroke, true)) dirty_ = true;
+    if (frameDepth_ == 0) flush();
+}
+
+void KeyboardOutput::stageRelease(uint8_t keyStroke) {
+    Guard g(lock_);
+    if (apply(report_, keyStroke, false)) dirty_ = true;
+    if (frameDepth_ == 0) flush();
+}
+
+void KeyboardOutput::commit() {
+    flush();
+    if (frameDepth_ == 0) return;
+    frameDepth_--;
+    if (lock_) xSemaphoreGiveRecursive(lock_);
+}
+
+void KeyboardOutput::press(uint8_t keyStroke) {
+    Guard g(lock_);
+    if (apply(report_, keyStroke, true)) dirty_ = true;
+    flush();
+}
+
+void KeyboardOutput::release(uint8_t keyStroke) {
+    Guard g(lock_);
+    if (apply(report_, keyStroke, false)) dirty_ = true;
+    flush();
+}
+
+void KeyboardOutput::write(uint8_t keyStroke) {
+    Guard g(lock_);
+    press(keyStroke);
+    release(keyStroke);
+}
+
+void KeyboardOutput::releaseAll() {
+    Guard g(lock_);
+    memset(report_, 0, sizeof(report_));
+    memset(macroReport_, 0, sizeof(macroReport_));
+    dirty_ = true;
+    flush();
+}
+
+void KeyboardOutput::macroPress(uint8_t keyStroke) {
+    Guard g(lock_);
+    if (apply(macroReport_, keyStroke, true)) dirty_ = true;
+    flush();
+}
+
+void KeyboardOutput::macroRelease(uint8_t keyStroke) {
+    Guard g(lock_);
+    if (apply(macroReport_, keyStroke, false)) dirty_ = true;
+    flush();
+}
+
+void KeyboardOutput::macroWrite(uint8_t keyStroke) {
+    Guard g(lock_);
+    macroPress(keyStroke);
+    macroRelease(keyStroke);
+}
+
+void KeyboardOutput::macroReleaseAll() {
+    Guard g(lock_);
+    memset(macroReport_, 0, sizeof(macroReport_));
+    dirty_ = true;
+    flush();
+}
+
+void KeyboardOutput::print(const String &text) {
+    Guard g(lock_);
+    for (size_t i = 0; i < text.length(); i++) {
+        uint8_t c = text[i];
+        if (c < sizeof(kAsciiMap)) write(c);
+    }
+}
+
+void KeyboardOutput::println(const String &text) {
+    Guard g(lock_);
+    print(text);
+    write('\n');
 }
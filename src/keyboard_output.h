@@ -6,37 +6,79 @@
 #include "usbhid.h"
 
 // Common interface over the two HID transports so the rest of the firmware can
-// emit key events without branching on USB vs BLE mode. The concrete classes
-// only delegate to the UsbHid / BleHid wrappers, so neither HID library header
-// leaks into callers.
+// emit key events without branching on USB vs BLE mode. The 8-byte boot
+// keyboard report is built here and handed to the UsbHid / BleHid wrappers as
+// a whole, so neither HID library header leaks into callers and both
+// transports translate key codes the same way.
+//
+// Key changes can be batched: between beginFrame() and commit(), stagePress()
+// and stageRelease() only edit the pending report and commit() sends it once,
+// so a chord changed in one scan pass goes out as a single report. Outside a
+// frame they send immediately. press(), release(), write(), print() and
+// releaseAll() always send right away (flushing anything staged first).
+//
+// Macro playback has a report of its own (macroPress() and friends), merged
+// with the other keys into every report sent, so a macro that ends or is
+// cancelled lets go of its own keys only, never of one the user holds.
 class KeyboardOutput {
    public:
+    static const size_t kReportSize = 8;
+
+    KeyboardOutput();
     virtual ~KeyboardOutput() {}
-    virtual void press(uint8_t keyStroke) = 0;
-    virtual void release(uint8_t keyStroke) = 0;
-    virtual void write(uint8_t keyStroke) = 0;
-    virtual void releaseAll() = 0;
-    virtual void print(const String &text) = 0;
-    virtual void println(const String &text) = 0;
+
+    // Open a frame. Frames hold a lock, so other tasks' key events wait until
+    // the matching commit(); the same task may keep using the output.
+    void beginFrame();
+    void stagePress(uint8_t keyStroke);
+    void stageRelease(uint8_t keyStroke);
+    // Send the pending report if it changed and close the frame.
+    void commit();
+
+    void press(uint8_t keyStroke);
+    void release(uint8_t keyStroke);
+    void write(uint8_t keyStroke);
+    // Every key, the macro's included (e.g. on a USB/BLE switch).
+    void releaseAll();
+    void print(const String &text);
+    void println(const String &text);
+
+    // The macro player's keys; sent right away like press() and release().
+    void macroPress(uint8_t keyStroke);
+    void macroRelease(uint8_t keyStroke);
+    void macroWrite(uint8_t keyStroke);
+    void macroReleaseAll();
+
+    // Reports handed to the transport since boot.
+    uint32_t reportsSent() const { return reportsSent_; }
+
+   protected:
+    virtual void sendReport(const uint8_t *report) = 0;
+
+   private:
+    // Apply a press/release to `report`. Returns false if nothing changed.
+    static bool apply(uint8_t *report, uint8_t keyStroke, bool pressed);
+    // Send report_ merged with macroReport_, if either changed.
+    void flush();
+
+    SemaphoreHandle_t lock_;
+    uint8_t report_[kReportSize];
+    uint8_t macroReport_[kReportSize];
+    bool dirty_;
+    uint8_t frameDepth_;
+    uint32_t reportsSent_;
 };
 
 class UsbKeyboardOutput : public KeyboardOutput {
-   public:
-    // press/release remap modifier key codes to raw HID usages (see .cpp).
-    void press(uint8_t keyStroke) override;
-    void release(uint8_t keyStroke) override;
-    void write(uint8_t keyStroke) override { UsbHid::write(keyStroke); }
-    void releaseAll() override { UsbHid::releaseAll(); }
-    void print(const String &text) override { UsbHid::print(text); }
-    void println(const String &text) override { UsbHid::println(text); }
+   protected:
+    void sendReport(const uint8_t *report) override {
+        UsbHid::sendReport(report);
+    }
 };
 
 class BleKeyboardOutput : public KeyboardOutput {
-   public:
-    void press(uint8_t keyStroke) override { BleHid::press(keyStroke); }
-    void release(uint8_t keyStroke) override { BleHid::release(keyStroke); }
-    void write(uint8_t keyStroke) override { BleHid::write(keyStroke); }
-    void releaseAll() override { BleHid::releaseAll(); }
-    void print(const String &text) override { BleHid::print(text); }
-    void println(const String &text) override { BleHid::println(text); }
+   protected:
+    void sendReport(const uint8_t *report) override {
+        BleHid::sendReport(report);
+    }
 };
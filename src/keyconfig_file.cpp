@@ -0,0 +1,143 @@
+#include "keyconfig_file.h"
+
+#include "atomic_file.h"
+#include "config_schema.h"
+
+const char *const KeyconfigFile::kLivePath = "/keyconfig.json";
+const char *const KeyconfigFile::kLogPath = "/keyconfig.log";
+
+namespace {
+// Longest log line: a ConfigPatch as JSON
+const size_t kLineSize = 160;
+}  // namespace
+
+void KeyconfigFile::begin() {
+    Guard guard(lock_);
+    AtomicFile::recover(fs_, kLivePath);
+    File log = fs_.open(kLogPath, "r");
+    logBytes_ = log ? log.size() : 0;
+    if (log) log.close();
+}
+
+KeyconfigFile::AppendResult KeyconfigFile::append(const ConfigPatch *patches,
+                                                  size_t count) {
+    Guard guard(lock_, 0);
+    if (!guard.ok()) return kBusy;
+    File log = fs_.open(kLogPath, FILE_APPEND);
+    if (!log) return kFailed;
+
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        StaticJsonDocument<256> line;
+        patches[i].toJson(line.to<JsonObject>());
+        size_t written = serializeJson(line, log);
+        ok = written > 0 && log.write('\n') == 1;
+        logBytes_ += written + 1;
+    }
+    log.close();
+    return ok ? kAppended : kFailed;
+}
+
+/**
+ * Apply each logged edit to the parsed file, in order. Lines that no longer
+ * fit the document (e.g. a layer that is gone) are skipped.
+ *
+ */
+void KeyconfigFile::replayLog(JsonDocument &doc) {
+    if (!logBytes_) return;
+    File log = fs_.open(kLogPath, "r");
+    if (!log) return;
+    // A torn last line must not wait for the stream timeout
+    log.setTimeout(0);
+
+    size_t layers = doc["keyConfig"].size();
+    size_t macros = doc["macros"].size();
+    size_t applied = 0;
+    char text[kLineSize];
+    char error[64];
+    while (log.available()) {
+        size_t length = log.readBytesUntil('\n', text, sizeof(text) - 1);
+        text[length] = '\0';
+        StaticJsonDocument<256> line;
+        ConfigPatch patch;
+        if (deserializeJson(line, text) ||
+            !patch.fromJson(line.as<JsonVariantConst>(), layers, macros,
+                            error, sizeof(error)) ||
+            !patch.applyTo(doc.as<JsonVariant>())) {
+            continue;
+        }
+        applied++;
+    }
+    log.close();
+
+    if (doc.overflowed()) {
+        Serial.println("KeyconfigFile: document full while applying log");
+    }
+    Serial.println((String) "KeyconfigFile: applied " + applied +
+                   " logged edits");
+}
+
+/**
+ * The document is written out while the file is still open for parsing, so
+ * it goes to AtomicFile's temporary file and is swapped in after the load.
+ * If the log did not fit in the document, the file and the log are left as
+ * they are: writing it out would lose edits the log still has.
+ *
+ */
+bool KeyconfigFile::compact() {
+    Guard guard(lock_);
+    if (!logBytes_) return true;
+
+    bool prepared = false;
+    bool loaded = load([&](JsonDocument &doc) {
+        if (doc.overflowed()) {
+            Serial.println("KeyconfigFile: log kept, compaction skipped");
+            return;
+        }
+        prepared = AtomicFile::prepare(fs_, kLivePath, [&](Print &out) {
+            return serializeJson(doc, out) > 0;
+        });
+    });
+    if (!loaded || !prepared || !AtomicFile::install(fs_, kLivePath)) {
+        return false;
+    }
+    discardLog();
+    return true;
+}
+
+bool KeyconfigFile::replace(const char *tempPath) {
+    Guard guard(lock_);
+    if (!AtomicFile::install(fs_, tempPath, kLivePath)) return false;
+    discardLog();
+    return true;
+}
+
+bool KeyconfigFile::restoreFrom(const char *path) {
+    Guard guard(lock_);
+    if (!AtomicFile::copy(fs_, path, kLivePath)) return false;
+    discardLog();
+    return true;
+}
+
+bool KeyconfigFile::check(char *error, size_t errorSize) {
+    Guard guard(lock_);
+    bool valid = false;
+    bool loaded = load([&](JsonDocument &doc) {
+        valid = ConfigSchema::validate(doc.as<JsonVariantConst>(), error,
+                                       errorSize);
+    });
+    if (!loaded) snprintf(error, errorSize, "cannot be read or parsed");
+    return loaded && valid;
+}
+
+bool KeyconfigFile::rollBack() {
+    Guard guard(lock_);
+    discardLog();
+    return AtomicFile::restore(fs_, kLivePath);
+}
+
+void KeyconfigFile::discardLog() {
+    Guard guard(lock_);
+    fs_.remove(kLogPath);
+    logBytes_ = 0;
+}
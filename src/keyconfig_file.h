@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+
+#include "config_patch.h"
+#include "json_file.h"
+
+// /keyconfig.json together with its change log. Single-key edits (PATCH
+// /api/config) are appended to the log as one short line each instead of
+// rewriting the whole file; every load applies the log on top of the file,
+// and once the log grows past kCompactBytes it is folded into the file in
+// one rewrite. Replacing the whole file (PUT, serial upload) drops the log.
+// Every rewrite goes through AtomicFile, so the previous version is kept
+// as the fallback rollBack() returns to.
+//
+// Used from the input task (load), the HTTP server and the loop, so every
+// operation holds a mutex.
+class KeyconfigFile {
+   public:
+    static const size_t kCompactBytes = 4096;
+
+    // The mutex exists from construction, so every operation is safe to
+    // call even if the filesystem never mounted and begin() was skipped;
+    // they then fail on the missing files.
+    explicit KeyconfigFile(FS &fs)
+        : fs_(fs), lock_(xSemaphoreCreateRecursiveMutex()), logBytes_(0) {}
+
+    // Finish an interrupted swap and pick up the log.
+    void begin();
+
+    // Parse the file with the log applied and call fn(doc). Returns false
+    // (and fn does not run) if the file cannot be opened or parsed.
+    template <typename Fn>
+    bool load(Fn fn) {
+        Guard guard(lock_);
+        File file = fs_.open(kLivePath, "r");
+        if (!file) {
+            Serial.println("KeyconfigFile: failed to open /keyconfig.json");
+            return false;
+        }
+        DeserializationError err = JsonFile::parse(
+            file,
+            [&](JsonDocument &doc) {
+                replayLog(doc);
+                fn(doc);
+            },
+            logBytes_);
+        file.close();
+        if (err) {
+            Serial.print(F("KeyconfigFile: deserializeJson() failed: "));
+            Serial.println(err.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    enum AppendResult : uint8_t { kAppended, kBusy, kFailed };
+
+    // Persist edits (validated by the caller) to the log. Never waits for a
+    // load or compaction holding the file: kBusy then, and nothing is
+    // written.
+    AppendResult append(const ConfigPatch *patches, size_t count);
+    // Fold the log into the file. No-op with an empty log.
+    bool compact();
+    // Install a validated file from `tempPath` in place of the current one
+    // and drop the log.
+    bool replace(const char *tempPath);
+    // Replace the file with a copy of `path` (the packaged defaults) and
+    // drop the log.
+    bool restoreFrom(const char *path);
+
+    // Parse and validate the file with the log applied. On false, `error`
+    // says why.
+    bool check(char *error, size_t errorSize);
+    // Go back to the version before the last rewrite, dropping the log.
+    bool rollBack();
+    // Forget logged edits (the file was rewritten outside this class).
+    void discardLog();
+
+    size_t logBytes() const { return logBytes_; }
+
+   private:
+    // Recursive, so compact() can load()
+    class Guard {
+       public:
+        explicit Guard(SemaphoreHandle_t lock, TickType_t wait = portMAX_DELAY)
+            : lock_(lock),
+              ok_(xSemaphoreTakeRecursive(lock_, wait) == pdTRUE) {}
+        ~Guard() {
+            if (ok_) xSemaphoreGiveRecursive(lock_);
+        }
+        bool ok() const { return ok_; }
+
+       private:
+        SemaphoreHandle_t lock_;
+        bool ok_;
+    };
+
+    static const char *const kLivePath;
+    static const char *const kLogPath;
+
+    void replayLog(JsonDocument &doc);
+
+    FS &fs_;
+    SemaphoreHandle_t lock_;
+    size_t logBytes_;
+};
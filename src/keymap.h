@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#define ROWS 5
+#define COLS 7
+
+// Keys on the rotary extension board (the encoder push button is separate).
+#define EXT_KEYS 3
+
+// Compiled, read-only form of one keyconfig.json layer. ConfigStore builds a
+// table of these once per config load, so switching layers only repoints the
+// active layer instead of re-walking the JSON document. Everything here is
+// plain data: labels are ids into the ConfigStore label pool, not Strings.
+namespace Keymap {
+
+// What a key does when pressed, decoded from its keyInfo once at load time so
+// the scan loop dispatches on an integer instead of matching label prefixes.
+enum KeyAction : uint8_t {
+    kActionKey = 0,      // plain key code
+    kActionMacro,        // "MACRO_<n>", arg = macro index
+    kActionTapToggle,    // "TT_<n>", arg = layer index
+    kActionFn,           // "FN"
+    kActionMomentary,    // "MO_<n>", arg = layer index
+    kActionToggleLayer,  // "TG_<n>", arg = layer index
+    kActionOneShot,      // "OSL_<n>", arg = layer index
+    kActionTransparent,  // "TRNS": use the entry of the layer below
+    kActionModTap,       // "MT_<code>": tap keyStroke, hold key code arg
+};
+
+struct KeyEntry {
+    uint8_t keyStroke;
+    KeyAction action;
+    uint8_t arg;
+    uint16_t label;
+};
+
+// Optional "acceleration" of an encoder config. A step that follows the last
+// one in the same direction within fastMs is fast: it emits the fastCcw /
+// fastCw binding when that is set ("fastMap" / "fastInfo", CCW then CW),
+// otherwise the normal binding `repeat` times. fastMs 0 disables it.
+struct EncoderAccel {
+    uint8_t fastMs;
+    uint8_t repeat;
+    KeyEntry fastCcw;
+    KeyEntry fastCw;
+};
+
+// rotaryMap / rotaryInfo order in keyconfig.json: button, CCW, CW.
+struct EncoderEntry {
+    KeyEntry button;
+    KeyEntry ccw;
+    KeyEntry cw;
+    EncoderAccel accel;
+};
+
+struct Layer {
+    uint16_t title;
+    KeyEntry keys[ROWS][COLS];
+    KeyEntry extKeys[EXT_KEYS];
+    EncoderEntry onboardEncoder;
+    EncoderEntry extEncoder;
+};
+
+}  // namespace Keymap
@@ -0,0 +1,34 @@
+#include "label_pool.h"
+
+#include <string.h>
+
+void LabelPool::clear() {
+    chars_.clear();
+    offsets_.clear();
+    chars_.push_back('\0');
+    offsets_.push_back(0);
+}
+
+uint16_t LabelPool::intern(const char *text) {
+    if (!text || !*text) return kEmpty;
+
+    // Config loads intern a few hundred short labels at most, so a linear
+    // scan is cheaper than keeping a hash index around.
+    for (size_t id = 1; id < offsets_.size(); id++) {
+        if (strcmp(&chars_[offsets_[id]], text) == 0) return id;
+    }
+
+    size_t length = strlen(text) + 1;
+    if (offsets_.size() >= UINT16_MAX ||
+        chars_.size() + length > UINT16_MAX) {
+        return kEmpty;
+    }
+    offsets_.push_back(chars_.size());
+    chars_.insert(chars_.end(), text, text + length);
+    return offsets_.size() - 1;
+}
+
+const char *LabelPool::get(uint16_t id) const {
+    if (id >= offsets_.size()) return &chars_[0];
+    return &chars_[offsets_[id]];
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Interned, read-only label strings (key infos, layer titles, ...). Every
+// distinct string is stored once in a single char arena and referred to by a
+// 16-bit id, so compiled keymaps hold no per-key String allocations. Id 0 is
+// always the empty string.
+class LabelPool {
+   public:
+    static const uint16_t kEmpty = 0;
+
+    LabelPool() { clear(); }
+
+    // Drop every label except the empty string.
+    void clear();
+
+    // Return the id of `text`, adding it if not present yet. nullptr is
+    // treated as "". Falls back to kEmpty once the pool is full.
+    uint16_t intern(const char *text);
+
+    // Label for `id`; "" for unknown ids. The pointer stays valid until the
+    // next clear() or intern() call.
+    const char *get(uint16_t id) const;
+
+    size_t size() const { return offsets_.size(); }
+
+   private:
+    std::vector<char> chars_;
+    std::vector<uint16_t> offsets_;
+};
@@ -0,0 +1,102 @@
+#include "layer_stack.h"
+
+bool LayerStack::press(const Keymap::KeyEntry &entry, uint32_t nowMs) {
+    uint8_t layer = entry.arg;
+    switch (entry.action) {
+        case Keymap::kActionMomentary:
+            return push(layer, kMomentary);
+        case Keymap::kActionToggleLayer:
+            if (remove(layer, kToggle)) return true;
+            return push(layer, kToggle);
+        case Keymap::kActionOneShot:
+            if (find(layer, kOneShot) >= 0) return false;
+            return push(layer, kOneShot);
+        case Keymap::kActionTapToggle:
+            // A press on a locked tap-toggle layer unlocks it
+            if (remove(layer, kToggle)) {
+                tapLayer_ = layer;
+                taps_ = 0;
+                tapUnlocked_ = true;
+                return true;
+            }
+            if (tapLayer_ != layer || nowMs - tapReleasedMs_ > kTapTermMs) {
+                taps_ = 0;
+            }
+            tapLayer_ = layer;
+            tapPressedMs_ = nowMs;
+            tapUnlocked_ = false;
+            return push(layer, kTapToggle);
+        default:
+            return false;
+    }
+}
+
+bool LayerStack::release(const Keymap::KeyEntry &entry, uint32_t nowMs) {
+    uint8_t layer = entry.arg;
+    switch (entry.action) {
+        case Keymap::kActionMomentary:
+            return remove(layer, kMomentary);
+        case Keymap::kActionTapToggle: {
+            if (tapLayer_ == layer && tapUnlocked_) {
+                tapUnlocked_ = false;
+                return false;
+            }
+            int8_t slot = find(layer, kTapToggle);
+            if (slot < 0) return false;
+            if (tapLayer_ == layer && nowMs - tapPressedMs_ <= kTapTermMs) {
+                taps_++;
+                tapReleasedMs_ = nowMs;
+            } else {
+                taps_ = 0;
+            }
+            if (taps_ >= kTapToggleTaps) {
+                // Quick taps: stay on the layer until the next press
+                taps_ = 0;
+                stack_[slot].kind = kToggle;
+                return false;
+            }
+            return remove(layer, kTapToggle);
+        }
+        default:
+            return false;
+    }
+}
+
+bool LayerStack::consumeOneShot() {
+    bool changed = false;
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < depth_; i++) {
+        if (stack_[i].kind == kOneShot) {
+            changed = true;
+        } else {
+            stack_[kept++] = stack_[i];
+        }
+    }
+    depth_ = kept;
+    return changed;
+}
+
+int8_t LayerStack::find(uint8_t layer, Kind kind) const {
+    for (int8_t i = depth_ - 1; i >= 0; i--) {
+        if (stack_[i].layer == layer && stack_[i].kind == kind) return i;
+    }
+    return -1;
+}
+
+bool LayerStack::push(uint8_t layer, Kind kind) {
+    if (depth_ >= kMaxDepth) return false;
+    stack_[depth_].layer = layer;
+    stack_[depth_].kind = kind;
+    depth_++;
+    return true;
+}
+
+bool LayerStack::remove(uint8_t layer, Kind kind) {
+    int8_t slot = find(layer, kind);
+    if (slot < 0) return false;
+    for (uint8_t i = slot; i + 1 < depth_; i++) {
+        stack_[i] = stack_[i + 1];
+    }
+    depth_--;
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "keymap.h"
+
+// Layers stacked on top of the base layout (the one the BD switch selects).
+// Key lookups walk the stack from the most recently activated layer down to
+// the base and take the first entry that is not transparent ("TRNS"), straight
+// from the compiled Keymap::Layer tables, so activating or dropping a layer is
+// a few byte moves with no reload.
+//
+//   kMomentary  "MO_<n>"   active while the key is held
+//   kToggle     "TG_<n>"   on / off per press
+//   kOneShot    "OSL_<n>"  active for the next non-layer key press only
+//   kTapToggle  "TT_<n>"   momentary; kTapToggleTaps quick taps lock it on,
+//                          and a further press unlocks it
+//
+// Pure logic on the caller's clock; only the input task uses it.
+class LayerStack {
+   public:
+    static const uint8_t kMaxDepth = 8;
+    static const uint8_t kTapToggleTaps = 2;
+    // Longest press, and longest gap between presses, that count as taps.
+    static const uint16_t kTapTermMs = 300;
+
+    enum Kind : uint8_t { kMomentary, kToggle, kOneShot, kTapToggle };
+
+    LayerStack()
+        : base_(0),
+          depth_(0),
+          tapLayer_(0xFF),
+          taps_(0),
+          tapPressedMs_(0),
+          tapReleasedMs_(0),
+          tapUnlocked_(false) {}
+
+    void setBase(uint8_t layer) { base_ = layer; }
+    uint8_t base() const { return base_; }
+    // Layer whose entries win where not transparent.
+    uint8_t top() const { return depth_ ? stack_[depth_ - 1].layer : base_; }
+    void clear() { depth_ = 0; }
+
+    // Press / release of a layer key (the KeyEntry resolved at press time).
+    // Return true if the stack changed.
+    bool press(const Keymap::KeyEntry &entry, uint32_t nowMs);
+    bool release(const Keymap::KeyEntry &entry, uint32_t nowMs);
+    // A non-layer key was pressed: drop one-shot layers. Call after the key
+    // has been resolved.
+    bool consumeOneShot();
+
+    // Entry chosen for a key: `layerAt(index)` returns a Keymap::Layer,
+    // `select(layer)` the key's KeyEntry in it. A transparent entry on the
+    // base layer is returned as is (and does nothing).
+    template <typename LayerAt, typename Select>
+    const Keymap::KeyEntry &resolve(LayerAt layerAt, Select select) const {
+        return select(layerAt(resolveLayer(layerAt, select)));
+    }
+
+    // Index of the layer resolve() takes the entry from.
+    template <typename LayerAt, typename Select>
+    uint8_t resolveLayer(LayerAt layerAt, Select select) const {
+        for (int8_t i = depth_ - 1; i >= 0; i--) {
+            const Keymap::KeyEntry &entry = select(layerAt(stack_[i].layer));
+            if (entry.action != Keymap::kActionTransparent) {
+                return stack_[i].layer;
+            }
+        }
+        return base_;
+    }
+
+    static bool isLayerKey(const Keymap::KeyEntry &entry) {
+        return entry.action == Keymap::kActionMomentary ||
+               entry.action == Keymap::kActionToggleLayer ||
+               entry.action == Keymap::kActionOneShot ||
+               entry.action == Keymap::kActionTapToggle;
+    }
+
+   private:
+    struct Slot {
+        uint8_t layer;
+        Kind kind;
+    };
+
+    int8_t find(uint8_t layer, Kind kind) const;
+    bool push(uint8_t layer, Kind kind);
+    bool remove(uint8_t layer, Kind kind);
+
+    uint8_t base_;
+    uint8_t depth_;
+    Slot stack_[kMaxDepth];
+
+    // Tap counting for the tap-toggle key in use
+    uint8_t tapLayer_;
+    uint8_t taps_;
+    uint32_t tapPressedMs_;
+    uint32_t tapReleasedMs_;
+    bool tapUnlocked_;  // this press unlocked the layer; release is a no-op
+};
@@ -0,0 +1,128 @@
+#include "macro_player.h"
+
+MacroPlayer::MacroPlayer()
+    : queue_(nullptr),
+      task_(nullptr),
+      interKeyMs_(0),
+      generation_(0),
+      playing_(false),
+      truncated_(false) {}
+
+void MacroPlayer::begin() {
+    if (!queue_) queue_ = xQueueCreate(kQueueLength, sizeof(MacroEvent));
+}
+
+bool MacroPlayer::enqueue(MacroEvent::Type type, uint8_t keyStroke,
+                          uint16_t delayMs) {
+    if (!queue_ || truncated_) return false;
+    if (uxQueueSpacesAvailable(queue_) <= kFinishEvents) {
+        // Nothing more of this macro, or it would play with a gap in it
+        truncated_ = true;
+        return false;
+    }
+    return send(type, keyStroke, delayMs);
+}
+
+bool MacroPlayer::send(MacroEvent::Type type, uint8_t keyStroke,
+                       uint16_t delayMs) {
+    MacroEvent event = {type, keyStroke, generation_, delayMs};
+    return xQueueSend(queue_, &event, 0) == pdTRUE;
+}
+
+void MacroPlayer::press(uint8_t keyStroke) {
+    enqueue(MacroEvent::kPress, keyStroke, 0);
+}
+
+void MacroPlayer::release(uint8_t keyStroke) {
+    enqueue(MacroEvent::kRelease, keyStroke, 0);
+}
+
+void MacroPlayer::tap(uint8_t keyStroke) {
+    enqueue(MacroEvent::kWrite, keyStroke, 0);
+}
+
+void MacroPlayer::releaseAll() { enqueue(MacroEvent::kReleaseAll, 0, 0); }
+
+void MacroPlayer::pause(uint16_t ms) { enqueue(MacroEvent::kPause, 0, ms); }
+
+void MacroPlayer::type(const char *text) {
+    for (const char *c = text; *c; c++) {
+        if (!enqueue(MacroEvent::kWrite, (uint8_t)*c, interKeyMs_)) return;
+    }
+}
+
+void MacroPlayer::layer(uint8_t index) {
+    enqueue(MacroEvent::kLayer, index, 0);
+}
+
+bool MacroPlayer::finish(uint16_t gapMs) {
+    bool complete = !truncated_;
+    truncated_ = false;
+    if (queue_) {
+        send(MacroEvent::kReleaseAll, 0, 0);
+        send(MacroEvent::kPause, 0, gapMs);
+    }
+    return complete;
+}
+
+bool MacroPlayer::busy() const {
+    return playing_ || (queue_ && uxQueueMessagesWaiting(queue_) > 0);
+}
+
+void MacroPlayer::cancel() {
+    if (!busy()) return;
+    generation_++;
+    xQueueReset(queue_);
+    // Queued rather than flagged, so it also reaches a task that is between
+    // events and about to block on the empty queue
+    send(MacroEvent::kReleaseAll, 0, 0);
+    if (task_) xTaskNotifyGive(task_);
+}
+
+void MacroPlayer::run(OutputResolver output, LayerHandler onLayer) {
+    task_ = xTaskGetCurrentTaskHandle();
+    for (;;) {
+        playNext(output, onLayer, portMAX_DELAY);
+    }
+}
+
+bool MacroPlayer::playNext(OutputResolver output, LayerHandler onLayer,
+                           TickType_t wait) {
+    MacroEvent event;
+    if (xQueueReceive(queue_, &event, wait) != pdTRUE) return false;
+    if (event.generation != generation_) return true;
+
+    KeyboardOutput &out = output();
+    playing_ = true;
+    switch (event.type) {
+        case MacroEvent::kPress:
+            out.macroPress(event.keyStroke);
+            break;
+        case MacroEvent::kRelease:
+            out.macroRelease(event.keyStroke);
+            break;
+        case MacroEvent::kWrite:
+            out.macroWrite(event.keyStroke);
+            break;
+        case MacroEvent::kReleaseAll:
+            out.macroReleaseAll();
+            break;
+        case MacroEvent::kPause:
+            break;
+        case MacroEvent::kLayer:
+            if (onLayer) onLayer(event.keyStroke);
+            break;
+    }
+
+    if (event.delayMs) {
+        // Forget notifications from earlier cancels, then pause; a
+        // cancel() during the pause wakes the task early.
+        ulTaskNotifyTake(pdTRUE, 0);
+        if (event.generation == generation_) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(event.delayMs));
+        }
+    }
+
+    playing_ = uxQueueMessagesWaiting(queue_) > 0;
+    return true;
+}
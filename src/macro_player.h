@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "keyboard_output.h"
+#include "macro_program.h"
+
+// Gap between typed characters, per transport ("macroDelay" in
+// keyconfig.json). BLE hosts drop characters when reports arrive too fast.
+struct MacroDelayConfig {
+    uint8_t usbMs;
+    uint8_t bleMs;
+};
+
+// Default used when keyconfig.json has no "macroDelay" section.
+const MacroDelayConfig kDefaultMacroDelay = {2, 8};
+
+// One step of a queued macro: an action followed by a pause before the next
+// step.
+struct MacroEvent {
+    enum Type : uint8_t {
+        kPress,
+        kRelease,
+        kWrite,
+        kReleaseAll,
+        kPause,
+        kLayer,
+    };
+
+    Type type;
+    uint8_t keyStroke;
+    uint8_t generation;
+    uint16_t delayMs;
+};
+
+// Non-blocking macro playback. Running a MacroProgram into the player only
+// queues timed events and returns at once; the macro task drains the queue in
+// run(), pausing between events, so the matrix scan and encoder tasks keep
+// running while a long string types out.
+class MacroPlayer : public MacroProgram::Sink {
+   public:
+    typedef KeyboardOutput &(*OutputResolver)();
+    typedef void (*LayerHandler)(uint8_t index);
+
+    // Events buffered at once (one per typed character). A macro that does
+    // not fit is cut short: its remaining events are dropped, but its
+    // finish() still goes through.
+    static const size_t kQueueLength = 512;
+    // Slots only finish() may use, so a cut macro still releases its keys
+    static const size_t kFinishEvents = 2;
+
+    MacroPlayer();
+
+    // Create the event queue. Call once in setup() before the macro task
+    // starts.
+    void begin();
+
+    // Gap type() leaves between characters, for the transport the next
+    // macro plays on.
+    void setInterKeyMs(uint16_t ms) { interKeyMs_ = ms; }
+
+    // Producer side (any task). Once the queue is full, the events of the
+    // macro in progress are dropped until its finish().
+    void press(uint8_t keyStroke) override;
+    void release(uint8_t keyStroke) override;
+    void tap(uint8_t keyStroke) override;
+    void releaseAll() override;
+    void pause(uint16_t ms) override;
+    void type(const char *text) override;
+    void layer(uint8_t index) override;
+
+    // End of one macro: release its keys and leave `gapMs` before the next.
+    // Always queued. Returns false if the macro was cut short.
+    bool finish(uint16_t gapMs);
+
+    // Drop everything queued, cut the current pause short and queue a
+    // release of the macro's keys if it was mid-playback (keys the user
+    // holds stay down). No-op when idle.
+    void cancel();
+
+    bool busy() const;
+
+    // Macro task body; never returns. Events are sent to output() as they
+    // come due, so a USB/BLE switch takes effect on the next event. Layer
+    // events call onLayer.
+    void run(OutputResolver output, LayerHandler onLayer);
+    // One pass of run(): wait up to `wait` ticks for an event and play it,
+    // pause included. Returns false if none came.
+    bool playNext(OutputResolver output, LayerHandler onLayer,
+                  TickType_t wait);
+
+   private:
+    bool enqueue(MacroEvent::Type type, uint8_t keyStroke, uint16_t delayMs);
+    bool send(MacroEvent::Type type, uint8_t keyStroke, uint16_t delayMs);
+
+    QueueHandle_t queue_;
+    TaskHandle_t task_;
+    uint16_t interKeyMs_;
+    // Bumped by cancel(); events stamped with an older generation are stale.
+    volatile uint8_t generation_;
+    volatile bool playing_;
+    // The macro being queued lost events; cleared by finish()
+    bool truncated_;
+};
@@ -0,0 +1,115 @@
+#include "macro_program.h"
+
+#include <Arduino.h>
+
+namespace {
+const size_t kMaxArena = 0xFFFF;
+
+uint16_t read16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+bool runBlock(const uint8_t *code, size_t size, const LabelPool &labels,
+              MacroProgram::Sink &sink, uint8_t depth) {
+    using namespace MacroProgram;
+
+    size_t pc = 0;
+    while (pc < size) {
+        uint8_t op = code[pc++];
+        size_t left = size - pc;
+        switch (op) {
+            case kOpPress:
+            case kOpRelease:
+            case kOpTap:
+            case kOpLayer: {
+                if (left < 1) return false;
+                uint8_t arg = code[pc++];
+                if (op == kOpPress) {
+                    sink.press(arg);
+                } else if (op == kOpRelease) {
+                    sink.release(arg);
+                } else if (op == kOpTap) {
+                    sink.tap(arg);
+                } else {
+                    sink.layer(arg);
+                }
+                break;
+            }
+            case kOpReleaseAll:
+                sink.releaseAll();
+                break;
+            case kOpDelay:
+                if (left < 2) return false;
+                sink.pause(read16(code + pc));
+                pc += 2;
+                break;
+            case kOpType:
+                if (left < 2) return false;
+                sink.type(labels.get(read16(code + pc)));
+                pc += 2;
+                break;
+            case kOpRepeat: {
+                if (left < 3 || depth >= kMaxDepth) return false;
+                uint8_t times = code[pc];
+                uint16_t length = read16(code + pc + 1);
+                pc += 3;
+                if (length > size - pc) return false;
+                for (uint8_t i = 0; i < times; i++) {
+                    if (!runBlock(code + pc, length, labels, sink, depth + 1)) {
+                        return false;
+                    }
+                }
+                pc += length;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+namespace MacroProgram {
+
+bool run(const uint8_t *code, size_t size, const LabelPool &labels,
+         Sink &sink) {
+    return runBlock(code, size, labels, sink, 0);
+}
+
+}  // namespace MacroProgram
+
+void MacroTable::clear() {
+    code_.clear();
+    entries_.clear();
+}
+
+const MacroTable::Entry *MacroTable::get(size_t index) const {
+    if (index >= entries_.size()) return nullptr;
+    return &entries_[index];
+}
+
+void MacroTable::emit16(uint16_t value) {
+    code_.push_back(value & 0xFF);
+    code_.push_back(value >> 8);
+}
+
+void MacroTable::patch16(size_t at, uint16_t value) {
+    code_[at] = value & 0xFF;
+    code_[at + 1] = value >> 8;
+}
+
+void MacroTable::beginProgram(uint16_t name) {
+    programStart_ = code_.size();
+    programName_ = name;
+}
+
+void MacroTable::endProgram() {
+    Entry entry = {0, 0, programName_};
+    if (code_.size() > kMaxArena) {
+        Serial.println("MacroTable: arena full, macro dropped");
+        code_.resize(programStart_);
+    } else {
+        entry.offset = programStart_;
+        entry.size = code_.size() - programStart_;
+    }
+    entries_.push_back(entry);
+}
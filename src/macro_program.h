@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "label_pool.h"
+
+// Macro bytecode. A program is a flat byte string of ops, each an opcode
+// followed by fixed-size operands (16-bit operands little endian):
+//
+//   kOpPress      key          press and hold key code `key`
+//   kOpRelease    key          release key code `key`
+//   kOpTap        key          press + release
+//   kOpReleaseAll              release every key
+//   kOpDelay      ms16         pause
+//   kOpType       label16      type the text of a LabelPool id
+//   kOpLayer      index        switch to layout `index`
+//   kOpRepeat     n len16      run the next `len` bytes `n` times
+//
+// Key codes use the KeyboardOutput convention (ASCII, 128+ modifiers, 136+
+// raw usages). Programs end at the end of their byte range.
+namespace MacroProgram {
+
+enum Op : uint8_t {
+    kOpPress = 1,
+    kOpRelease,
+    kOpTap,
+    kOpReleaseAll,
+    kOpDelay,
+    kOpType,
+    kOpLayer,
+    kOpRepeat,
+};
+
+// Deepest kOpRepeat nesting run() accepts.
+const uint8_t kMaxDepth = 4;
+
+// Receives the actions of a running program.
+class Sink {
+   public:
+    virtual ~Sink() {}
+    virtual void press(uint8_t keyStroke) = 0;
+    virtual void release(uint8_t keyStroke) = 0;
+    virtual void tap(uint8_t keyStroke) = 0;
+    virtual void releaseAll() = 0;
+    virtual void pause(uint16_t ms) = 0;
+    virtual void type(const char *text) = 0;
+    virtual void layer(uint8_t index) = 0;
+};
+
+// Interpret `size` bytes of `code`, resolving kOpType through `labels`.
+// Returns false (after emitting the ops before it) on a truncated operand, an
+// unknown opcode or too deep nesting.
+bool run(const uint8_t *code, size_t size, const LabelPool &labels,
+         Sink &sink);
+
+}  // namespace MacroProgram
+
+// Every compiled macro program in one contiguous byte arena, indexed by the
+// n of "MACRO_<n>". Rebuilt on each config load; holds no per-macro heap
+// objects.
+class MacroTable {
+   public:
+    struct Entry {
+        uint16_t offset;
+        uint16_t size;
+        uint16_t name;  // LabelPool id
+    };
+
+    void clear();
+
+    size_t count() const { return entries_.size(); }
+    // nullptr for out-of-range indexes.
+    const Entry *get(size_t index) const;
+    const uint8_t *code(const Entry &entry) const {
+        return code_.data() + entry.offset;
+    }
+    size_t arenaSize() const { return code_.size(); }
+
+    // Builder: beginProgram(), emit ops, endProgram(). A program that would
+    // push the arena past 64 KB is dropped and recorded as empty.
+    void beginProgram(uint16_t name);
+    void emit(uint8_t byte) { code_.push_back(byte); }
+    void emit16(uint16_t value);
+    // Position of the next emitted byte, and back-patching of a 16-bit
+    // operand written earlier (used for kOpRepeat body lengths).
+    size_t mark() const { return code_.size(); }
+    void patch16(size_t at, uint16_t value);
+    void endProgram();
+
+   private:
+    std::vector<uint8_t> code_;
+    std::vector<Entry> entries_;
+    size_t programStart_ = 0;
+    uint16_t programName_ = 0;
+};
@@ -4,49 +4,81 @@ RTC_DATA_ATTR unsigned int timeSinceBoot = 0;
 RTC_DATA_ATTR bool bootWiFiMode = false;
 
 U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C u8g2(U8G2_R0);
+// Last frame on the panel; renderScreen() only sends tiles that changed
+FrameDiff oledFrame;
+RenderStats renderStats;
+uint32_t renderedGeneration = 0;
+int8_t renderedMode = -1;
 
 UsbKeyboardOutput usbOutput;
 BleKeyboardOutput bleOutput;
 
 PCF8574 pcf8574RotaryExtension(ENCODER_EXTENSION_ADDR);
+// Owns Wire once the tasks start: OLED and PCF8574 traffic is queued through it
+I2cArbiter i2cBus;
 volatile bool isRotaryExtensionConnected = false;
 
 TaskHandle_t TaskGeneralStatusCheck;
 TaskHandle_t TaskLED;
 TaskHandle_t TaskScreen;
 TaskHandle_t TaskEncoderExtension;
-TaskHandle_t TaskEncoder;
+TaskHandle_t TaskInput;
 TaskHandle_t TaskI2C;
+TaskHandle_t TaskMacro;
 
-// Stucture for key stroke
-Key key1, key2, key3, key4, key5, key6, key7, key8, key9, key10, key11, key12,
-    key13, key14, key15, key16, key17, key18, key19, key20, key21, key22, key23,
-    key24, key25, key26, key27, key28, key29, key30, key31, dummy;
+// Plays queued macros on the macro task so typing never blocks the scan
+MacroPlayer macroPlayer;
 
-Macro macro1, macro2, macro3, macro4, macro5, macro6, macro7, macro8, macro9,
-    macro10, macro11, macro12, macro13, macro14, macro15, macro16, macro17,
-    macro18, macro19, macro20;
+// Every input source publishes its changes here; the input task is the only
+// consumer and the only code that touches key state or emits key events
+InputBus inputBus;
+InputActions inputActions;
+InputEngine inputEngine(inputActions);
 
-Macro macroMap[20] = {macro1,  macro2,  macro3,  macro4,  macro5,
-                      macro6,  macro7,  macro8,  macro9,  macro10,
-                      macro11, macro12, macro13, macro14, macro15,
-                      macro16, macro17, macro18, macro19, macro20};
+// keyconfig.json plus its log of single-key edits (PATCH /api/config)
+KeyconfigFile keyconfigFile(Storage::fs());
+// Logged key edits on their way to the input task, which owns the compiled
+// layers
+const size_t kMaxKeyPatches = 16;
+QueueHandle_t keyPatchQueue;
 
-Key keyMap[ROWS][COLS] = {{key1, key2, key3, key4, key5, key6, dummy},
-                          {key7, key8, key9, key10, key11, key12, key13},
-                          {key14, key15, key16, key17, key18, key19, dummy},
-                          {key20, key21, key22, key23, key24, key25, key26},
-                          {key27, key28, key29, dummy, key30, key31, dummy}};
+// Rounds of each operation FS_BENCH times per file
+const uint8_t kBenchRounds = 20;
 
-// Rotray Extnesion ( 3 keys + 1 rotary encoder)
-Key rotaryExtKeyMap[3] = {Key(), Key(), Key()};
-RotaryEncoderConfig rotaryExtRotaryEncoders[1] = {RotaryEncoderConfig()};
+// Serial configuration: commands, and keyconfig uploads written to their own
+// temporary file and validated before they replace the live config
+ConfigUpload serialUpload(Storage::fs(), "/keyconfig.serial.tmp",
+                          keyconfigFile);
+SerialConfigSink serialConfigSink;
+SerialIntake serialIntake(serialConfigSink);
+
+// Press state per physical key. Bindings come from the active layer table.
+Key keyMap[ROWS][COLS];
 
-// Onboard Rotary Encoder
-ESP32Encoder onboardEncoders[1] = {ESP32Encoder()};
-RotaryEncoderConfig onboardRotaryEncoders[1] = {RotaryEncoderConfig()};
+// Rotray Extnesion ( 3 keys + 1 rotary encoder)
+Key rotaryExtKeyMap[EXT_KEYS];
+Key rotaryExtButton;
+
+// Rotary encoders: the onboard one is decoded in its GPIO interrupt, the
+// extension board one from PCF8574 samples. Both hand detents to the input
+// task through a ring so decoding never waits on HID output.
+QuadratureDecoder onboardDecoder(4);
+QuadratureDecoder extDecoder(2);
+EncoderRing onboardRing;
+EncoderRing extRing;
+StepAccelerator onboardAccel;
+StepAccelerator extAccel;
+// An encoder event can expand to 255 detents times the accel repeat. The
+// turns go out at most kMaxTurnsPerFrame per input frame; the rest carries
+// over to the next frames.
+const uint16_t kMaxTurnsPerFrame = 16;
+PendingTurns onboardTurns = {};
+PendingTurns extTurns = {};
 
 ConfigStore configStore;
+// Base layout (currentLayoutIndex) plus the MO/TG/OSL/TT layers on top of
+// it. Keys resolve through it straight from ConfigStore's compiled tables.
+LayerStack layerStack;
 volatile bool isFnKeyPressed = false;
 bool isDetectingLastConnectedDevice = true;
 RTC_DATA_ATTR byte currentLayoutIndex = 0;
@@ -62,16 +94,29 @@ static KeyboardOutput &kbd() {
 }
 
 byte layoutLength = 0;
-String currentLayout = "";
-// For maximum 10 layers
-const short jsonDocSize = 16384;
-size_t tapToggleOrginalLayerIndex = 0;
-bool isTemporaryToggled = false;
 
-byte inputs[] = {9, 3, 8, 5, 4, 18, 17};  // Column
-const int inputCount = sizeof(inputs) / sizeof(inputs[0]);
-byte outputs[] = {14, 13, 12, 11, 10};  // Row
-const int outputCount = sizeof(outputs) / sizeof(outputs[0]);
+byte inputs[COLS] = {9, 3, 8, 5, 4, 18, 17};  // Column
+byte outputs[ROWS] = {14, 13, 12, 11, 10};    // Row
+MatrixScanner matrixScanner(MatrixGpio::readRow);
+
+// Debounce between the raw scans and keyPress/keyRelease, configured from the
+// "debounce" section of keyconfig.json
+Debouncer matrixDebouncer(ROWS * COLS);
+Debouncer extBoardDebouncer(4);
+// Bi-directional switch (bits 0-2: CW, CCW, push) and configuration buttons
+// (bits 3-5: CFG_BTN_PIN_0..2)
+const uint8_t kPanelInputs = 6;
+Debouncer panelDebouncer(kPanelInputs);
+// Debounced key state the input task has been sent, per producer in loop()
+KeySync matrixSync;
+KeySync panelSync;
+// Set by config reloads (input task); loop() and encoderExtBoardTask apply it
+// to their own debouncers before their next scan
+DebounceSettings debounceSettings;
+
+// Full-rate scanning while keys are active; after 1 s without activity the
+// loop blocks on key interrupts, waking at least every 50 ms for serial input
+ScanScheduler scanScheduler(1000, 50);
 
 // Auto sleep timer
 unsigned long sleepPreviousMillis = 0;
@@ -90,10 +135,6 @@ const long LED_INTERVAL = 5 * 1000;
 unsigned long networkInfoPreviousMillis = 0;
 const long NETWORK_INFO_INTERVAL = 5 * 1000;
 
-// Tap-Toggle timer
-unsigned long tapTogglePreviousMillis = 0;
-uint8_t tapToggleCount = 0;
-
 // Updated in ledTask, read by every task's timing checks across both cores.
 volatile unsigned long currentMillis = 0;
 
@@ -104,6 +145,16 @@ int batteryPercentage = 101;
 // each task reads the current value rather than a cached copy. (Aligned bool
 // access is already atomic on the ESP32, so no torn reads.)
 volatile bool keymapsNeedsUpdate = false;
+// Reloads started by the input task; lets the loop tell a request made during
+// a reload from the one it already woke the task for
+volatile uint32_t keymapsReloads = 0;
+// Set by the HTTP server, serviced by the loop: fold the key edit log into
+// keyconfig.json (a full rewrite, too slow for the server's task)
+volatile bool keyconfigNeedsCompact = false;
+// Compactions run by the loop, and whether the last one failed (the log is
+// then still there); GET /api/config waits on them
+volatile uint32_t keyconfigCompactions = 0;
+volatile bool keyconfigCompactFailed = false;
 volatile bool configUpdated = false;
 volatile bool isSoftAPEnabled = false;
 volatile bool isGoingToSleep = false;
@@ -128,8 +179,9 @@ void setup() {
 
     delay(10);
 
-    // Guard the shared screen state before any task can touch it.
-    Display::begin();
+    macroPlayer.begin();
+    inputBus.begin();
+    keyPatchQueue = xQueueCreate(kMaxKeyPatches, sizeof(ConfigPatch));
 
     printSpacer();
 
@@ -192,47 +244,34 @@ void setup() {
         isRotaryExtensionConnected = false;
     }
 
-    xTaskCreate(
-        encoderExtBoardTask,      /* Task function. */
-        "Encoder Ext Board Task", /* name of task. */
-        5000,                     /* Stack size of task */
-        NULL,                     /* parameter of the task */
-        2,                        /* priority of the task */
-        &TaskEncoderExtension /* Task handle to keep track of created task */
-    );
-
-    ESP32Encoder::useInternalWeakPullResistors = UP;
-
-    onboardEncoders[0].attachHalfQuad(EC_PIN_A, EC_PIN_B);
-
-    xTaskCreate(encoderTask,    /* Task function. */
-                "Encoder Task", /* name of task. */
-                5000,           /* Stack size of task */
-                NULL,           /* parameter of the task */
-                2,              /* priority of the task */
-                &TaskEncoder    /* Task handle to keep track of created task */
-    );
+    // From here on every bus access goes through the arbiter
+    i2cBus.begin();
 
     printSpacer();
 
-    Serial.println("Loading SPIFFS...");
-    if (!SPIFFS.begin(true)) {
-        Serial.println("An Error has occurred while mounting SPIFFS");
+    Serial.println("Mounting storage...");
+    if (!Storage::begin()) {
+        Serial.println("An Error has occurred while mounting storage");
         return;
     }
 
-    Serial.print("SPIFFS Free: ");
+    Storage::Backend &storage = Storage::active();
+    Serial.print(String(storage.name()) + " Free: ");
     Serial.println(
-        humanReadableSize((SPIFFS.totalBytes() - SPIFFS.usedBytes())));
-    Serial.print("SPIFFS Used: ");
-    Serial.println(humanReadableSize(SPIFFS.usedBytes()));
-    Serial.print("SPIFFS Total: ");
-    Serial.println(humanReadableSize(SPIFFS.totalBytes()));
+        humanReadableSize((storage.totalBytes() - storage.usedBytes())));
+    Serial.print(String(storage.name()) + " Used: ");
+    Serial.println(humanReadableSize(storage.usedBytes()));
+    Serial.print(String(storage.name()) + " Total: ");
+    Serial.println(humanReadableSize(storage.totalBytes()));
 
     Serial.println(listFiles());
 
-    Serial.println("Loading config files from SPIFFS...");
-    configStore.reload();
+    Serial.println("Loading config files from storage...");
+    AtomicFile::recover(Storage::fs(), "/config.json");
+    keyconfigFile.begin();
+    checkKeyconfig();
+    configStore.reload(keyconfigFile);
+    applySettings();
 
     StaticJsonDocument<256> doc;
     String configJSON = loadJSONFileAsString("system");
@@ -299,8 +338,46 @@ void setup() {
     printSpacer();
 
     Serial.println("Configuring input pin and keys...");
-    initKeys();
-    initMacros();
+    initKeyPins();
+    activateLayer();
+
+    // Input producers and consumers start only now that the keymap and
+    // settings are loaded: until then nothing may touch configStore
+    xTaskCreate(
+        encoderExtBoardTask,      /* Task function. */
+        "Encoder Ext Board Task", /* name of task. */
+        5000,                     /* Stack size of task */
+        NULL,                     /* parameter of the task */
+        2,                        /* priority of the task */
+        &TaskEncoderExtension /* Task handle to keep track of created task */
+    );
+
+    if (ENCODER_EXTENSION_INT_PIN >= 0) {
+        pinMode(ENCODER_EXTENSION_INT_PIN, INPUT_PULLUP);
+        attachInterrupt(ENCODER_EXTENSION_INT_PIN, onExtensionInterrupt,
+                        FALLING);
+    }
+
+    pinMode(EC_PIN_A, INPUT_PULLUP);
+    pinMode(EC_PIN_B, INPUT_PULLUP);
+    attachInterrupt(EC_PIN_A, onOnboardEncoderEdge, CHANGE);
+    attachInterrupt(EC_PIN_B, onOnboardEncoderEdge, CHANGE);
+
+    xTaskCreate(inputTask,    /* Task function. */
+                "Input Task", /* name of task. */
+                5000,         /* Stack size of task */
+                NULL,         /* parameter of the task */
+                2,            /* priority of the task */
+                &TaskInput    /* Task handle to keep track of created task */
+    );
+
+    xTaskCreate(macroTask,    /* Task function. */
+                "Macro Task", /* name of task. */
+                5000,         /* Stack size of task */
+                NULL,         /* parameter of the task */
+                2,            /* priority of the task */
+                &TaskMacro    /* Task handle to keep track of created task */
+    );
 
     printSpacer();
 
@@ -462,14 +539,14 @@ void generalTask(void *pvParameters) {
         checkIdle();
 
         // Show current pressed key info
-        String keyInfo;
+        char keyInfo[Display::kLineSize];
         if (Display::takeKeyInfo(keyInfo)) {
             Display::setBottom(keyInfo);
         }
 
         // Idle message
         if (currentMillis - sleepPreviousMillis > 5000) {
-            Display::setBottom("@" + currentLayout);
+            showLayoutName();
         }
 
         // Record boot time every 5 seconds
@@ -541,174 +618,307 @@ void ledTask(void *pvParameters) {
 }
 
 /**
- * Onboard rotary encoder scanning
+ * Onboard encoder A/B edge: decode and queue whole steps for the input task
  *
  */
-void encoderTask(void *pvParameters) {
-    long int value = onboardEncoders[0].getCount();
-    long int lastValue = value;
-    bool trigger = false;
-    String direction = "";
+void IRAM_ATTR onOnboardEncoderEdge() {
+    int8_t step =
+        onboardDecoder.update(digitalRead(EC_PIN_A), digitalRead(EC_PIN_B));
+    if (step == 0) {
+        return;
+    }
+    // A detent merged into a queued event needs no new wake-up
+    uint16_t nowMs = millis();
+    if (onboardRing.push(step, nowMs) != EncoderRing::kAppended) {
+        return;
+    }
+    InputEvent wake = {(uint32_t)millis(), kInputOnboardEncoder, 0, step, 0};
+    BaseType_t woken = pdFALSE;
+    inputBus.publishFromISR(wake, &woken);
+    portYIELD_FROM_ISR(woken);
+}
 
+/**
+ * Input engine: the single consumer of every input source. Runs each batch of
+ * queued events through the InputEngine inside one HID frame, so changes
+ * published together (e.g. a chord seen in one scan pass) go out as one
+ * report.
+ *
+ */
+void inputTask(void *pvParameters) {
+    InputEvent event;
+    bool turnsLeft = false;
     while (true) {
-        value = onboardEncoders[0].getCount();
+        // Sleep until an event arrives or a held button's hold time is up;
+        // only for a tick while encoder turns are still to be sent
+        uint32_t waitMs = turnsLeft ? 0 : inputEngine.nextTickIn(millis());
+        TickType_t wait = waitMs == UINT32_MAX ? portMAX_DELAY
+                                               : pdMS_TO_TICKS(waitMs) + 1;
+        bool received = inputBus.receive(event, wait);
+
+        // Hold on to the output the frame was opened on; an FN combo in this
+        // batch may flip isUsbMode.
+        KeyboardOutput &output = kbd();
+        output.beginFrame();
+        while (received) {
+            inputEngine.dispatch(event);
+            received = inputBus.receive(event, 0);
+        }
+        drainEncoderRings();
+        turnsLeft = sendPendingTurns();
+        output.commit();
 
-        if (value != lastValue) {
-            if (value > lastValue) {  // CCW
-                direction = "CCW";
-            } else if (value < lastValue) {  // CW
-                direction = "CW";
-            }
+        inputEngine.tick(millis());
 
-            lastValue = value;
+        applyKeyPatches();
+        if (keymapsNeedsUpdate) {
+            updateKeymaps();
+        }
+    }
+}
 
-            if (trigger) {
-                trigger = false;
-            } else {
-                trigger = true;
-                vTaskDelay(10 / portTICK_PERIOD_MS);
-                continue;
-            }
+/**
+ * Rebind the keys edited through PATCH /api/config in the compiled layers
+ *
+ */
+void applyKeyPatches() {
+    ConfigPatch patch;
+    while (xQueueReceive(keyPatchQueue, &patch, 0) == pdTRUE) {
+        // Checked against the tables it is applied to: a reload may have
+        // changed them since the HTTP server accepted the edit
+        if (!configStore.applyPatch(patch)) {
+            Serial.println("Key edit no longer fits the config, dropped");
+        }
+    }
+}
+
+/**
+ * Accept single-key edits (PATCH /api/config): validate them against the
+ * loaded config, append them to the change log and queue them for the input
+ * task, which checks them again against the tables it applies them to. No
+ * reparse or file rewrite here; a log due for compaction is left to the
+ * loop. Called from the HTTP server, so it never waits on the input task
+ * or on keyconfig.json.
+ *
+ * @param {JsonVariantConst} changes one edit object or an array of them
+ * @param {char*} error set to the reason when rejected
+ * @param {size_t} errorSize size of error
+ * @return {int} HTTP status: 200 accepted, 400 rejected, 503 config busy
+ */
+int patchKeyconfig(JsonVariantConst changes, char *error, size_t errorSize) {
+    ConfigPatch patches[kMaxKeyPatches];
+    size_t count = 0;
+    size_t layers, macros;
+    {
+        ConfigStore::Reader reader(configStore);
+        if (!reader.ok()) {
+            snprintf(error, errorSize, "config is reloading, retry");
+            return 503;
+        }
+        layers = configStore.layerCount();
+        macros = configStore.macros().count();
+    }
 
-            if (direction.equals("CCW")) {
-                emitEncoderTurn(onboardRotaryEncoders[0].rotaryCCW,
-                                onboardRotaryEncoders[0].rotaryCCWInfo);
-            } else if (direction.equals("CW")) {
-                emitEncoderTurn(onboardRotaryEncoders[0].rotaryCW,
-                                onboardRotaryEncoders[0].rotaryCWInfo);
+    if (changes.is<JsonObjectConst>()) {
+        if (!patches[0].fromJson(changes, layers, macros, error, errorSize)) {
+            return 400;
+        }
+        count = 1;
+    } else {
+        JsonArrayConst list = changes.as<JsonArrayConst>();
+        if (list.size() == 0 || list.size() > kMaxKeyPatches) {
+            snprintf(error, errorSize, "expected 1 to %u edits",
+                     (unsigned)kMaxKeyPatches);
+            return 400;
+        }
+        for (JsonVariantConst change : list) {
+            if (!patches[count].fromJson(change, layers, macros, error,
+                                         errorSize)) {
+                return 400;
             }
+            count++;
         }
+    }
+
+    // The file is held for a whole load or compaction; don't wait it out
+    switch (keyconfigFile.append(patches, count)) {
+        case KeyconfigFile::kAppended:
+            break;
+        case KeyconfigFile::kBusy:
+            snprintf(error, errorSize, "config is being saved, retry");
+            return 503;
+        default:
+            snprintf(error, errorSize, "failed to write change log");
+            return 400;
+    }
+
+    bool queued = true;
+    for (size_t i = 0; i < count && queued; i++) {
+        queued = xQueueSend(keyPatchQueue, &patches[i], 0) == pdTRUE;
+    }
+    if (queued) {
+        inputBus.publish(kInputWake, 0, 0);
+    } else {
+        // Logged already, so a full reload picks them up
+        keymapsNeedsUpdate = true;
+    }
+
+    if (keyconfigFile.logBytes() > KeyconfigFile::kCompactBytes) {
+        keyconfigNeedsCompact = true;
+    }
+    return 200;
+}
 
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+/**
+ * Feed the detents queued by both encoders to the input engine. Encoder
+ * events on the bus only wake the input task; the counts live in the rings.
+ *
+ */
+void drainEncoderRings() {
+    EncoderRing *rings[] = {&onboardRing, &extRing};
+    const InputSource sources[] = {kInputOnboardEncoder, kInputExtEncoder};
+    EncoderRing::Event detents;
+    for (int i = 0; i < 2; i++) {
+        while (rings[i]->pop(detents)) {
+            // Widen the ring's 16-bit timestamp back to millis()
+            uint32_t now = millis();
+            InputEvent event = {
+                now - (uint16_t)((uint16_t)now - detents.timeMs), sources[i],
+                0, detents.direction, detents.count};
+            inputEngine.dispatch(event);
+        }
     }
 }
 
+/**
+ * Macro playback: sends queued macro events on the active output
+ *
+ */
+void macroTask(void *pvParameters) {
+    // Layer ops go through the input task, which owns the keymap
+    macroPlayer.run(kbd, [](uint8_t index) {
+        inputBus.publish(kInputLayer, index, 0);
+    });
+}
+
 /**
  * Rotary encoder related tasks
  *
  */
 void encoderExtBoardTask(void *pvParameters) {
-    int value = 0;
-    bool btnState = false;
-    bool pinAState = false;
-    bool pinBState = false;
-    bool lastPinAState = false;
-    bool lastPinBState = false;
-    bool trigger = false;
-    unsigned long rotaryEncoderLastButtonPress = 0;
-    String direction = "";
-    byte btnArray[] = {encoderSW, extensionBtn1, extensionBtn2, extensionBtn3};
+    ExtensionInputs inputs;
+    uint8_t lastLevels = 0xFF;
+    unsigned long lastChangeMillis = 0;
+    uint32_t debounceSeen = 0;
+    DebounceConfig debounce;
+    KeySync extSync;
 
     while (true) {
-        if (isRotaryExtensionConnected) {
-            // Scan for rotary encoder
-            pinAState = pcf8574RotaryExtension.digitalRead(encoderPinA);
-            pinBState = pcf8574RotaryExtension.digitalRead(encoderPinB);
-            if (pinAState != lastPinAState || pinBState != lastPinBState) {
-                if (pinAState == true && pinBState == true) {
-                    if (lastPinAState == false && lastPinBState == true) {
-                        direction = "CCW";
-                    } else if (lastPinAState == true &&
-                               lastPinBState == false) {
-                        direction = "CW";
-                    }
-                    trigger = true;
-                } else if (pinAState == false && pinBState == false) {
-                    if (lastPinAState == false && lastPinBState == true) {
-                        direction = "CW";
-                    } else if (lastPinAState == true &&
-                               lastPinBState == false) {
-                        direction = "CCW";
-                    }
-                    trigger = true;
-                }
-                lastPinAState = pinAState;
-                lastPinBState = pinBState;
-
-                if (trigger) {
-                    resetIdle();
-                    if (direction.equals("CW")) {
-                        if (!isOutputLocked) {
-                            kbd().write(rotaryExtRotaryEncoders[0].rotaryCW);
-                        }
-                        Display::setKeyInfo(
-                            rotaryExtRotaryEncoders[0].rotaryCWInfo);
-                    } else if (direction.equals("CCW")) {
-                        if (!isOutputLocked) {
-                            kbd().write(rotaryExtRotaryEncoders[0].rotaryCCW);
-                        }
-                        Display::setKeyInfo(
-                            rotaryExtRotaryEncoders[0].rotaryCCWInfo);
-                    }
-                    trigger = false;
-                }
+        if (debounceSettings.poll(debounceSeen, &debounce)) {
+            extBoardDebouncer.configure(debounce);
+        }
+
+        if (isRotaryExtensionConnected &&
+            i2cBus.run(kI2cExtension, kI2cHigh, readExtensionInputs,
+                       &inputs)) {
+            if (inputs.levels != lastLevels) {
+                lastLevels = inputs.levels;
+                lastChangeMillis = millis();
             }
 
-            // Scan for button press
-            for (int i = 0; i < 4; i++) {
-                btnState = pcf8574RotaryExtension.digitalRead(btnArray[i]);
-                if (btnState == LOW) {
-                    resetIdle();
-                    switch (btnArray[i]) {
-                        case encoderSW:
-                            keyPress(rotaryExtRotaryEncoders[0].button);
-                            break;
-                        case extensionBtn1:
-                            keyPress(rotaryExtKeyMap[0]);
-                            break;
-                        case extensionBtn2:
-                            keyPress(rotaryExtKeyMap[1]);
-                            break;
-                        case extensionBtn3:
-                            keyPress(rotaryExtKeyMap[2]);
-                            break;
-                    }
-                    rotaryEncoderLastButtonPress = millis();
-                } else if (btnState == HIGH) {
-                    switch (btnArray[i]) {
-                        case encoderSW:
-                            if (rotaryExtRotaryEncoders[0].button.state) {
-                                keyRelease(rotaryExtRotaryEncoders[0].button);
-                            }
-                            break;
-                        case extensionBtn1:
-                            if (rotaryExtKeyMap[0].state) {
-                                keyRelease(rotaryExtKeyMap[0]);
-                            }
-                            break;
-                        case extensionBtn2:
-                            if (rotaryExtKeyMap[1].state) {
-                                keyRelease(rotaryExtKeyMap[1]);
-                            }
-                            break;
-                        case extensionBtn3:
-                            if (rotaryExtKeyMap[2].state) {
-                                keyRelease(rotaryExtKeyMap[2]);
-                            }
-                            break;
-                    }
-                }
+            // Scan for rotary encoder
+            int8_t step = extDecoder.update(inputs.pinA, inputs.pinB);
+            if (step != 0 && extRing.push(step, (uint16_t)millis()) ==
+                                 EncoderRing::kAppended) {
+                inputBus.publish(kInputExtEncoder, 0, step);
             }
+
+            // Scan for button press. Bit i follows the button order of
+            // ExtensionInputs.
+            extBoardDebouncer.update(inputs.buttons, millis());
+        }
+        // Button edges, including any the bus refused last time
+        Debouncer::State buttons = extBoardDebouncer.state();
+        extSync.sync(buttons, [](uint8_t i, bool down) {
+            return inputBus.publish(kInputExtButton, i, down ? 1 : 0);
+        });
+
+        // With the INT line wired, sleep until the board reports a change
+        // once inputs have been quiet for a while (the debouncer still needs
+        // samples right after an edge, and a refused edge a retry). The
+        // timeout covers a hot-plugged board and any missed edge.
+        if (ENCODER_EXTENSION_INT_PIN >= 0 &&
+            millis() - lastChangeMillis > 50 && !buttons &&
+            !extSync.pending(buttons)) {
+            ulTaskNotifyTake(pdTRUE, 500 / portTICK_PERIOD_MS);
+        } else {
+            vTaskDelay(3 / portTICK_PERIOD_MS);
         }
+    }
+}
 
-        vTaskDelay(3 / portTICK_PERIOD_MS);
+/**
+ * PCF8574 INT falling edge: wake the extension board task
+ *
+ */
+void IRAM_ATTR onExtensionInterrupt() {
+    BaseType_t woken = pdFALSE;
+    if (TaskEncoderExtension) {
+        vTaskNotifyGiveFromISR(TaskEncoderExtension, &woken);
     }
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * Read the extension board's encoder pins and buttons (arbiter job)
+ *
+ * @param {ExtensionInputs} inputs filled with the sampled levels
+ */
+bool readExtensionInputs(void *inputs) {
+    ExtensionInputs &in = *static_cast<ExtensionInputs *>(inputs);
+    const byte buttons[] = {encoderSW, extensionBtn1, extensionBtn2,
+                            extensionBtn3};
+
+    // One transaction for all 8 pins (also clears the INT line)
+    PCF8574::DigitalInput all = pcf8574RotaryExtension.digitalReadAll();
+    if (!pcf8574RotaryExtension.isLastTransmissionSuccess()) {
+        return false;
+    }
+    const uint8_t pins[8] = {all.p0, all.p1, all.p2, all.p3,
+                             all.p4, all.p5, all.p6, all.p7};
+    in.levels = 0;
+    for (int i = 0; i < 8; i++) {
+        if (pins[i]) {
+            in.levels |= 1 << i;
+        }
+    }
+
+    in.pinA = in.levels & (1 << encoderPinA);
+    in.pinB = in.levels & (1 << encoderPinB);
+    in.buttons = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!(in.levels & (1 << buttons[i]))) {
+            in.buttons |= 1 << i;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check whether the extension board answers on the bus (arbiter job)
+ *
+ */
+bool probeExtension(void *) {
+    Wire.beginTransmission(ENCODER_EXTENSION_ADDR);
+    return Wire.endTransmission() == 0;
 }
 
 void i2cTask(void *pvParameters) {
-    byte error;
-    byte devices[1] = {ENCODER_EXTENSION_ADDR};
     while (true) {
         renderScreen();
 
-        for (byte addr : devices) {
-            Wire.beginTransmission(addr);
-            error = Wire.endTransmission();
-
-            if (addr == ENCODER_EXTENSION_ADDR) {
-                isRotaryExtensionConnected = (error == 0);
-            }
-        }
+        isRotaryExtensionConnected =
+            i2cBus.run(kI2cExtension, kI2cLow, probeExtension, NULL);
 
         vTaskDelay(50 / portTICK_PERIOD_MS);
     }
@@ -719,361 +929,481 @@ void i2cTask(void *pvParameters) {
  *
  */
 void loop() {
-    // Check every keystroke is pressed or not when connected
-    if (keymapsNeedsUpdate) {
-        updateKeymaps();
+    // Config reloads run on the input task, which owns the keymap; wake it
+    // once per request, and again for a request made while it reloads
+    static uint32_t reloadPostedAt = UINT32_MAX;
+    if (keymapsNeedsUpdate && reloadPostedAt != keymapsReloads) {
+        uint32_t reloads = keymapsReloads;
+        if (inputBus.publish(kInputWake, 0, 0)) reloadPostedAt = reloads;
     }
 
     if (isGoingToSleep) {
         return;
     }
 
-    // Accept Serial input for keyconfig.json
-    if (Serial.available() > 0) {
-        String jsonString = Serial.readString();
-        jsonString.trim();
+    if (keyconfigNeedsCompact) {
+        keyconfigNeedsCompact = false;
+        keyconfigCompactFailed = !keyconfigFile.compact();
+        __atomic_add_fetch(&keyconfigCompactions, 1, __ATOMIC_RELEASE);
+    }
+    finishConfigUpload();
+
+    // Commands and keyconfig uploads from the configuration tool, taken in
+    // whatever pieces have arrived so the scan never waits on the port
+    uint8_t serialChunk[64];
+    while (Serial.available() > 0) {
+        size_t size = Serial.readBytes(
+            serialChunk, std::min((size_t)Serial.available(),
+                                  sizeof(serialChunk)));
+        serialIntake.feed(serialChunk, size, millis());
+    }
+    serialIntake.poll(millis());
 
-        // Config read request: dump the current keyconfig.json (wrapped in
-        // markers) so the configuration tool can import what's on the device.
-        // Emit as a single write to minimize interleaving with Serial output
-        // from tasks running on the other core.
-        if (jsonString == "READ_CONFIG") {
-            Serial.print("\n<<<CONFIG_BEGIN>>>\n" +
-                         loadJSONFileAsString("keyconfig") +
-                         "\n<<<CONFIG_END>>>\n");
-            return;
-        }
+    static uint32_t debounceSeen = 0;
+    DebounceConfig debounce;
+    if (debounceSettings.poll(debounceSeen, &debounce)) {
+        matrixDebouncer.configure(debounce);
+        panelDebouncer.configure(debounce);
+    }
 
-        // WiFi read request: dump the currently stored SSID (password is never
-        // sent back) so the configuration tool can pre-fill its WiFi form.
-        if (jsonString == "READ_WIFI") {
-            DynamicJsonDocument stored(256);
-            deserializeJson(stored, loadJSONFileAsString("config"));
-            DynamicJsonDocument out(128);
-            out["ssid"] = stored["ssid"] | "";
-            String buffer;
-            serializeJson(out, buffer);
-            Serial.print("\n<<<WIFI_BEGIN>>>\n" + buffer + "\n<<<WIFI_END>>>\n");
-            return;
-        }
+    // Keypad scan: only keys whose debounced state changed since the last
+    // pass are published (plus any edge the bus refused on an earlier pass),
+    // and the input task sends them as one HID report
+    MatrixScanner::State raw = matrixScanner.read();
+    MatrixScanner::State changed = matrixDebouncer.update(raw, millis());
+    matrixSync.sync(matrixDebouncer.state(), [](uint8_t key, bool pressed) {
+        return inputBus.publish(kInputMatrix, key, pressed ? 1 : 0);
+    });
+
+    // Bi-directional switch and configuration buttons: edges only, the input
+    // task decides what they do (including long presses)
+    Debouncer::State panelRaw = readPanelInputs();
+    Debouncer::State panelChanged =
+        panelDebouncer.update(panelRaw, millis());
+    panelSync.sync(panelDebouncer.state(), [](uint8_t i, bool down) {
+        return inputBus.publish(i < 3 ? kInputBdSwitch : kInputConfigButton,
+                                i % 3, down ? 1 : 0);
+    });
+
+    // Nothing held, changing or waiting for room on the bus: park the matrix
+    // and block until a key interrupt instead of spinning on the scan. The
+    // interrupts stay attached from entering idle until the pass that wakes
+    // it.
+    bool keyActivity = raw || changed || matrixDebouncer.state() ||
+                       panelRaw || panelChanged || panelDebouncer.state() ||
+                       matrixSync.pending(matrixDebouncer.state()) ||
+                       panelSync.pending(panelDebouncer.state());
+    ScanScheduler::Step step = scanScheduler.onScan(keyActivity, millis());
+    if (step == ScanScheduler::kEnterIdle) ScanWake::arm();
+    if (step == ScanScheduler::kWake) ScanWake::disarm();
+    if (scanScheduler.mode() == ScanScheduler::kIdle) {
+        MatrixGpio::setAllRows(LOW);
+        ScanWake::wait(scanScheduler.waitMs());
+        MatrixGpio::setAllRows(HIGH);
+    }
+}
 
-        // WiFi scan request: scan for nearby networks and return their SSID /
-        // RSSI so the configuration tool can offer them as suggestions. When
-        // not already in WiFi mode the radio is briefly switched on for the
-        // scan and turned back off afterwards.
-        if (jsonString == "SCAN_WIFI") {
-            // Show a hint on the OLED while the (blocking) scan runs. The render
-            // task on core 0 watches this flag and holds the message, then
-            // resumes normal status updates once it clears.
-            isScanningWifi = true;
-
-            bool wifiWasOff = (WiFi.getMode() == WIFI_MODE_NULL);
-            if (wifiWasOff) {
-                WiFi.mode(WIFI_STA);
-            }
+/**
+ * Run one command from the configuration tool
+ *
+ * @param {String} command the command line, trimmed
+ */
+void handleSerialCommand(const String &command) {
+    // Config read request: stream the current keyconfig.json (wrapped in
+    // markers) so the configuration tool can import what's on the device.
+    // Sent in FileStream chunks straight from the file, never held in RAM
+    // as a whole. Logged key edits are folded into the file first.
+    if (command == "READ_CONFIG") {
+        keyconfigFile.compact();
+        Serial.print("\n<<<CONFIG_BEGIN>>>\n");
+        FileStream::copy(Storage::fs(), "/keyconfig.json", Serial);
+        Serial.print("\n<<<CONFIG_END>>>\n");
+        return;
+    }
 
-            int n = WiFi.scanNetworks();
-            // Sized for a crowded RF environment (~80 networks); entries are
-            // silently dropped once capacity is exceeded.
-            DynamicJsonDocument out(8192);
-            JsonArray networks = out.createNestedArray("networks");
-            for (int i = 0; i < n; i++) {
-                String foundSsid = WiFi.SSID(i);
-                if (foundSsid.isEmpty()) {
-                    continue;  // skip hidden networks
-                }
-                JsonObject net = networks.createNestedObject();
-                net["ssid"] = foundSsid;
-                net["rssi"] = WiFi.RSSI(i);
-            }
-            WiFi.scanDelete();
+    // Stats request: renderer and HID report counters, as JSON
+    if (command == "READ_STATS") {
+        DynamicJsonDocument out(1024);
+        out["render"]["rendered"] = renderStats.rendered;
+        out["render"]["skipped"] = renderStats.skipped;
+        out["render"]["bytesSent"] = renderStats.bytesSent;
+        out["hid"]["usbReports"] = usbOutput.reportsSent();
+        out["hid"]["bleReports"] = bleOutput.reportsSent();
+        out["encoder"]["onboardDropped"] = onboardRing.dropped();
+        out["encoder"]["extDropped"] = extRing.dropped();
+        out["input"]["dropped"] = inputBus.dropped();
+        // Heap low-water mark since boot: the peak heap use of any
+        // request so far
+        out["heap"]["free"] = ESP.getFreeHeap();
+        out["heap"]["minFree"] = ESP.getMinFreeHeap();
+        out["heap"]["maxAlloc"] = ESP.getMaxAllocHeap();
+        const FileStream::Stats &streamed = FileStream::stats();
+        out["stream"]["transfers"] = streamed.transfers;
+        out["stream"]["bytes"] = streamed.bytes;
+        out["stream"]["failures"] = streamed.failures;
+        // Config file replacements, and per file since the NVS counters
+        // were created: a flash wear indicator
+        const AtomicFile::Stats &stored = AtomicFile::stats();
+        out["storage"]["writes"] = stored.writes;
+        out["storage"]["failures"] = stored.failures;
+        out["storage"]["rollbacks"] = stored.rollbacks;
+        out["storage"]["wear"]["keyconfig"] =
+            AtomicFile::writeCount("/keyconfig.json");
+        out["storage"]["wear"]["config"] =
+            AtomicFile::writeCount("/config.json");
+        const char *devices[kI2cDeviceCount] = {"oled", "extension"};
+        for (uint8_t d = 0; d < kI2cDeviceCount; d++) {
+            const I2cArbiter::DeviceStats &bus =
+                i2cBus.stats((I2cDevice)d);
+            JsonObject device = out["i2c"].createNestedObject(devices[d]);
+            device["transactions"] = bus.transactions;
+            device["maxWaitUs"] = bus.maxWaitUs;
+            device["maxBusUs"] = bus.maxBusUs;
+            device["avgBusUs"] =
+                bus.transactions
+                    ? (uint32_t)(bus.totalBusUs / bus.transactions)
+                    : 0;
+        }
+        String buffer;
+        serializeJson(out, buffer);
+        Serial.print("\n<<<STATS_BEGIN>>>\n" + buffer +
+                     "\n<<<STATS_END>>>\n");
+        return;
+    }
 
-            if (wifiWasOff) {
-                WiFi.mode(WIFI_MODE_NULL);
-            }
+    // Filesystem benchmark: average exists / open / read / write latency of
+    // the config files on the mounted backend, as JSON. Build with
+    // -D STORAGE_SPIFFS for the SPIFFS numbers.
+    if (command == "FS_BENCH") {
+        const char *files[] = {"/keyconfig.json", "/config.json",
+                               "/system.json"};
+        DynamicJsonDocument out(1024);
+        out["backend"] = Storage::active().name();
+        out["rounds"] = kBenchRounds;
+        for (const char *path : files) {
+            Storage::Timing timing;
+            if (!Storage::bench(path, kBenchRounds, timing)) continue;
+            JsonObject file = out["files"].createNestedObject(path + 1);
+            file["bytes"] = timing.bytes;
+            file["existsUs"] = timing.existsUs;
+            file["openUs"] = timing.openUs;
+            file["readUs"] = timing.readUs;
+            file["writeUs"] = timing.writeUs;
+        }
+        String buffer;
+        serializeJson(out, buffer);
+        Serial.print("\n<<<BENCH_BEGIN>>>\n" + buffer +
+                     "\n<<<BENCH_END>>>\n");
+        return;
+    }
 
-            isScanningWifi = false;
+    // WiFi read request: dump the currently stored SSID (password is never
+    // sent back) so the configuration tool can pre-fill its WiFi form.
+    if (command == "READ_WIFI") {
+        DynamicJsonDocument stored(256);
+        deserializeJson(stored, loadJSONFileAsString("config"));
+        DynamicJsonDocument out(128);
+        out["ssid"] = stored["ssid"] | "";
+        String buffer;
+        serializeJson(out, buffer);
+        Serial.print("\n<<<WIFI_BEGIN>>>\n" + buffer + "\n<<<WIFI_END>>>\n");
+        return;
+    }
 
-            String buffer;
-            serializeJson(out, buffer);
-            Serial.print("\n<<<WIFISCAN_BEGIN>>>\n" + buffer +
-                         "\n<<<WIFISCAN_END>>>\n");
-            return;
+    // WiFi scan request: scan for nearby networks and return their SSID /
+    // RSSI so the configuration tool can offer them as suggestions. When
+    // not already in WiFi mode the radio is briefly switched on for the
+    // scan and turned back off afterwards.
+    if (command == "SCAN_WIFI") {
+        // Show a hint on the OLED while the (blocking) scan runs. The render
+        // task on core 0 watches this flag and holds the message, then
+        // resumes normal status updates once it clears.
+        isScanningWifi = true;
+
+        bool wifiWasOff = (WiFi.getMode() == WIFI_MODE_NULL);
+        if (wifiWasOff) {
+            WiFi.mode(WIFI_STA);
         }
 
-        // WiFi write request: "WRITE_WIFI" followed by a JSON object holding
-        // ssid/password. Persisted to /config.json (the same file the web
-        // server reads on boot into WiFi mode).
-        if (jsonString.startsWith("WRITE_WIFI")) {
-            String wifiJson = jsonString.substring(strlen("WRITE_WIFI"));
-            wifiJson.trim();
-
-            DynamicJsonDocument doc(256);
-            DeserializationError err = deserializeJson(doc, wifiJson);
-            if (err || doc.isNull() || !doc.containsKey("ssid")) {
-                Serial.println("WiFi config invalid");
-                return;
+        int n = WiFi.scanNetworks();
+        // Sized for a crowded RF environment (~80 networks); entries are
+        // silently dropped once capacity is exceeded.
+        DynamicJsonDocument out(8192);
+        JsonArray networks = out.createNestedArray("networks");
+        for (int i = 0; i < n; i++) {
+            String foundSsid = WiFi.SSID(i);
+            if (foundSsid.isEmpty()) {
+                continue;  // skip hidden networks
             }
-
-            File configFile = SPIFFS.open("/config.json", "w");
-            if (!configFile) {
-                Serial.println("Failed to open config file for writing");
-                return;
-            }
-            if (serializeJson(doc, configFile) == 0) {
-                Serial.println("Failed to write to config file");
-            } else {
-                Serial.println("WiFi config updated!");
-            }
-            configFile.close();
-            return;
+            JsonObject net = networks.createNestedObject();
+            net["ssid"] = foundSsid;
+            net["rssi"] = WiFi.RSSI(i);
         }
+        WiFi.scanDelete();
 
-        Serial.println("Received JSON:");
-        Serial.println(jsonString);
-
-        // Parse JSON
-        DynamicJsonDocument doc(jsonDocSize);
-        deserializeJson(doc, jsonString);
-
-        // Check if JSON overflowed
-        if (doc.overflowed() || doc.isNull()) {
-            Serial.println("JSON overflowed or empty");
-        } else {
-            // Save JSON to SPIFFS as keyconfig.json
-            File configFile = SPIFFS.open("/keyconfig.json", "w");
-            if (!configFile) {
-                Serial.println("Failed to open config file for writing");
-            }
-            if (!serializeJson(doc, configFile)) {
-                Serial.println("Failed to write to config file");
-            }
-            configFile.close();
+        if (wifiWasOff) {
+            WiFi.mode(WIFI_MODE_NULL);
+        }
 
-            // Reload keymaps
-            keymapsNeedsUpdate = true;
+        isScanningWifi = false;
 
-            // Show config updated message
-            configUpdated = true;
-            Serial.println("Config updated!");
-        }
+        String buffer;
+        serializeJson(out, buffer);
+        Serial.print("\n<<<WIFISCAN_BEGIN>>>\n" + buffer +
+                     "\n<<<WIFISCAN_END>>>\n");
+        return;
     }
 
-    // Keypad scan
-    for (int r = 0; r < ROWS; r++) {
-        digitalWrite(outputs[r], LOW);  // Setting one row low
-        for (int c = 0; c < COLS; c++) {
-            if (digitalRead(inputs[c]) == ACTIVE) {
-                resetIdle();
-                if (isFnKeyPressed) {
-                    if (r == 0 && c == 0) {
-                        goSleeping();
-                    } else if (r == 1 && c == 0) {
-                        switchBootMode();
-                    } else if (r == 3 && c == 0) {
-                        isUsbMode = !isUsbMode;
-                        UsbHid::releaseAll();
-                        BleHid::releaseAll();
-                        delay(300);
-                    } else if (r == 4 && c == 4) {
-                        switchLayout();
-                    } else if (r == 3 && c == 3) {
-                        isCaffeinated = !isCaffeinated;
-                        delay(300);
-                    } else if (r == 3 && c == 4) {
-                        isOutputLocked = !isOutputLocked;
-                        delay(300);
-                    } else if (r == 1 && c == 6) {
-                        isScreenDisabled = !isScreenDisabled;
-                        delay(300);
-                    } else if (r == 3 && c == 6) {
-                        isScreenInverted = !isScreenInverted;
-                        delay(300);
-                    }
-                } else if (keyMap[r][c].keyInfo.startsWith("MACRO_")) {
-                    // Macro press
-                    macroPressByInfo(keyMap[r][c].keyInfo);
-                } else if (keyMap[r][c].keyInfo.startsWith("TT_")) {
-                    // Tap-Toggle press
-                    if (!isTemporaryToggled) {
-                        size_t index =
-                            keyMap[r][c]
-                                .keyInfo.substring(3)
-                                .toInt();
-                        tapToggleActive(index);
-                    }
-                } else {
-                    // Standard key press
-                    keyPress(keyMap[r][c]);
-                }
-            } else {
-                if (keyMap[r][c].keyInfo.startsWith("TT_") &&
-                    isTemporaryToggled) {
-                    tapToggleRelease(tapToggleOrginalLayerIndex);
-                }
-                keyRelease(keyMap[r][c]);
-            }
-            delayMicroseconds(10);
+    // WiFi write request: "WRITE_WIFI" followed by a JSON object holding
+    // ssid/password. Persisted to /config.json (the same file the web
+    // server reads on boot into WiFi mode).
+    if (command.startsWith("WRITE_WIFI")) {
+        String wifiJson = command.substring(strlen("WRITE_WIFI"));
+        wifiJson.trim();
+
+        DynamicJsonDocument doc(256);
+        DeserializationError err = deserializeJson(doc, wifiJson);
+        if (err || doc.isNull() || !doc.containsKey("ssid")) {
+            Serial.println("WiFi config invalid");
+            return;
         }
-        digitalWrite(outputs[r], HIGH);  // Setting the row back to high
-        delayMicroseconds(10);
-    }
 
-    // Read Bi-Directional Switch input
-    if (digitalRead(BD_SW_CW) == ACTIVE) {
-        resetIdle();
-        switchLayout(currentLayoutIndex + 1);
-        while (digitalRead(BD_SW_CW) == ACTIVE) {
-            delay(10);
-        }
-    } else if (digitalRead(BD_SW_CCW) == ACTIVE) {
-        resetIdle();
-        switchLayout(currentLayoutIndex - 1);
-        while (digitalRead(BD_SW_CCW) == ACTIVE) {
-            delay(10);
-        }
-    } else if (digitalRead(BD_SW_PUSH) == ACTIVE) {
-        resetIdle();
-        switchLayout(0);
-        while (digitalRead(BD_SW_PUSH) == ACTIVE) {
-            delay(10);
+        bool written =
+            AtomicFile::write(Storage::fs(), "/config.json", [&](Print &out) {
+                return serializeJson(doc, out) > 0;
+            });
+        if (!written) {
+            Serial.println("Failed to write to config file");
+        } else {
+            Serial.println("WiFi config updated!");
         }
+        return;
     }
+    Serial.println("Unknown command: " + command);
+}
 
-    readConfigButtons();
+/**
+ * Serial command from the intake
+ *
+ * @param {const char*} line the command, trimmed
+ */
+void SerialConfigSink::command(const char *line) {
+    handleSerialCommand(line);
+}
+
+void SerialConfigSink::jsonBegin() { serialUpload.begin(); }
+
+void SerialConfigSink::jsonData(const uint8_t *data, size_t size) {
+    serialUpload.write(data, size);
 }
 
 /**
- * Initialize every Key instance that used in this program
+ * End of a keyconfig upload over serial: validate it and swap it in
  *
+ * @param {bool} complete false if the upload stalled part way
  */
-void initKeys() {
-    Serial.println("Reading JSON keymap configuration...");
+void SerialConfigSink::jsonEnd(bool complete) {
+    if (!complete) {
+        serialUpload.abort();
+        Serial.println("Config upload timed out");
+        return;
+    }
+    if (!serialUpload.finish()) {
+        Serial.println((String) "Config rejected: " + serialUpload.error());
+        return;
+    }
 
-    JsonDocument &doc = configStore.doc();
+    // Reload keymaps
+    keymapsNeedsUpdate = true;
 
-    uint8_t keyLayout[ROWS][COLS];
-    String keyInfo[ROWS][COLS];
+    // Show config updated message
+    configUpdated = true;
+    Serial.println("Config updated!");
+}
+
+/**
+ * Handle a press or release edge of the matrix key at (row, col)
+ *
+ * @param {uint8_t} row matrix row
+ * @param {uint8_t} col matrix column
+ * @param {bool} pressed true on press, false on release
+ */
+void handleMatrixKey(uint8_t row, uint8_t col, bool pressed) {
+    Key &key = keyMap[row][col];
 
-    copyArray(doc["keyConfig"][currentLayoutIndex]["keymap"], keyLayout);
-    copyArray(doc["keyConfig"][currentLayoutIndex]["keyInfo"], keyInfo);
+    // Releases go by what the key did when pressed, whatever the layers
+    // look like now
+    if (!pressed) {
+        keyRelease(key);
+        return;
+    }
 
-    layoutLength = doc["keyConfig"].size();
+    // A new key press stops a macro that is still playing
+    macroPlayer.cancel();
+
+    const Keymap::KeyEntry &entry = layerStack.resolve(
+        layerAt,
+        [row, col](const Keymap::Layer &layer) -> const Keymap::KeyEntry & {
+            return layer.keys[row][col];
+        });
+
+    if (isFnKeyPressed) {
+        if (row == 0 && col == 0) {
+            goSleeping();
+        } else if (row == 1 && col == 0) {
+            switchBootMode();
+        } else if (row == 3 && col == 0) {
+            isUsbMode = !isUsbMode;
+            usbOutput.releaseAll();
+            bleOutput.releaseAll();
+        } else if (row == 4 && col == 4) {
+            switchLayout();
+        } else if (row == 3 && col == 3) {
+            isCaffeinated = !isCaffeinated;
+        } else if (row == 3 && col == 4) {
+            isOutputLocked = !isOutputLocked;
+        } else if (row == 1 && col == 6) {
+            isScreenDisabled = !isScreenDisabled;
+        } else if (row == 3 && col == 6) {
+            isScreenInverted = !isScreenInverted;
+        }
+    } else {
+        pressEntry(key, entry);
+    }
+}
 
-    // GPIO configuration
-    for (int i = 0; i < outputCount; i++) {
-        pinMode(outputs[i], OUTPUT);
-        digitalWrite(outputs[i], HIGH);
+/**
+ * Press a key with its resolved binding: layer keys change the layer stack,
+ * macros play, everything else is a key press
+ *
+ * @param {Key} key the physical key
+ * @param {KeyEntry} entry the binding resolved through the layer stack
+ */
+void pressEntry(Key &key, const Keymap::KeyEntry &entry) {
+    if (LayerStack::isLayerKey(entry)) {
+        layerKeyPress(key, entry);
+        return;
     }
+    // The key has been resolved through any one-shot layer; drop it
+    if (entry.action != Keymap::kActionFn && layerStack.consumeOneShot()) {
+        showTopLayer();
+    }
+    if (entry.action == Keymap::kActionMacro) {
+        macroPressByIndex(entry.arg);
+    } else {
+        keyPress(key, entry);
+    }
+}
 
-    for (int i = 0; i < inputCount; i++) {
-        pinMode(inputs[i], INPUT_PULLUP);
+/**
+ * Press a MO_/TG_/OSL_/TT_ key
+ *
+ * @param {Key} key the physical key
+ * @param {KeyEntry} entry its layer key binding
+ */
+void layerKeyPress(Key &key, const Keymap::KeyEntry &entry) {
+    if (entry.arg >= configStore.layerCount()) {
+        // No such layer: the release must not act on whatever this key did
+        // last time
+        key.pressed = Keymap::KeyEntry();
+        key.state = false;
+        return;
+    }
+    key.pressed = entry;
+    key.state = true;
+    if (layerStack.press(entry, millis())) {
+        showTopLayer();
     }
+}
+
+/**
+ * Compiled layer table by index, for LayerStack::resolve()
+ *
+ * @param {uint8_t} index layer index
+ */
+const Keymap::Layer &layerAt(uint8_t index) { return configStore.layer(index); }
+
+/**
+ * Show the title of the layer now on top of the stack as the key info
+ *
+ */
+void showTopLayer() {
+    Display::setKeyInfo(
+        configStore.label(configStore.layer(layerStack.top()).title));
+}
+
+/**
+ * Configure the matrix and bi-directional switch GPIOs
+ *
+ */
+void initKeyPins() {
+    MatrixGpio::begin(outputs, inputs);
 
     // Bi-Direction (/w Push) Switch
     pinMode(BD_SW_CW, INPUT_PULLUP);
     pinMode(BD_SW_CCW, INPUT_PULLUP);
     pinMode(BD_SW_PUSH, INPUT_PULLUP);
 
-    // Assign keymap data
-    for (int r = 0; r < ROWS; r++) {
-        for (int c = 0; c < COLS; c++) {
-            keyMap[r][c].keyStroke = keyLayout[r][c];
-            keyMap[r][c].keyInfo = keyInfo[r][c];
-            keyMap[r][c].state = false;
-        }
-    }
-
-    // Load Onboard Rotary Encoder config from doc["onBoardRotaryEncoder"]
-    uint8_t onboardRotaryEncoderRotaryMap[3];
-    String onboardRotaryEncoderInfo[3];
-    if (doc["onBoardRotaryEncoder"].isNull()) {
-        Serial.println("No onboard rotary encoder config found");
-    } else {
-        copyArray(doc["onBoardRotaryEncoder"][currentLayoutIndex]["rotaryMap"],
-                  onboardRotaryEncoderRotaryMap);
-        copyArray(doc["onBoardRotaryEncoder"][currentLayoutIndex]["rotaryInfo"],
-                  onboardRotaryEncoderInfo);
-
-        // Assign rotary encoder data
-        for (int i = 0; i < sizeof(onboardRotaryEncoders) /
-                                sizeof(onboardRotaryEncoders[0]);
-             i++) {
-            onboardRotaryEncoders[0].button.keyStroke =
-                onboardRotaryEncoderRotaryMap[0];
-            onboardRotaryEncoders[0].button.keyInfo =
-                onboardRotaryEncoderInfo[0];
-            onboardRotaryEncoders[0].button.state = false;
-            onboardRotaryEncoders[0].rotaryCCW =
-                onboardRotaryEncoderRotaryMap[1];
-            onboardRotaryEncoders[0].rotaryCW =
-                onboardRotaryEncoderRotaryMap[2];
-            onboardRotaryEncoders[0].rotaryCCWInfo =
-                onboardRotaryEncoderInfo[1];
-            onboardRotaryEncoders[0].rotaryCWInfo = onboardRotaryEncoderInfo[2];
-        }
+    // Inputs that wake the low-power scan
+    for (int c = 0; c < COLS; c++) {
+        ScanWake::addPin(inputs[c]);
     }
+    ScanWake::addPin(BD_SW_CW);
+    ScanWake::addPin(BD_SW_CCW);
+    ScanWake::addPin(BD_SW_PUSH);
+    ScanWake::addPin(CFG_BTN_PIN_0);
+    ScanWake::addPin(CFG_BTN_PIN_1);
+    ScanWake::addPin(CFG_BTN_PIN_2);
+}
 
-    // Load Rotary Extension config from doc["rotaryExtension"]
-    uint8_t rotaryExtKeyLayout[3];
-    String rotaryExtKeyInfo[3];
-    uint8_t rotaryExtRotaryMap[3];
-    String rotaryExtRotaryInfo[3];
-    if (doc["rotaryExtension"].isNull()) {
-        Serial.println("No rotary extension config found");
-    } else {
-        copyArray(doc["rotaryExtension"][currentLayoutIndex]["keymap"],
-                  rotaryExtKeyLayout);
-        copyArray(doc["rotaryExtension"][currentLayoutIndex]["keyInfo"],
-                  rotaryExtKeyInfo);
-        copyArray(doc["rotaryExtension"][currentLayoutIndex]["rotaryMap"],
-                  rotaryExtRotaryMap);
-        copyArray(doc["rotaryExtension"][currentLayoutIndex]["rotaryInfo"],
-                  rotaryExtRotaryInfo);
-
-        // Assign keymap data
-        for (int i = 0; i < 3; i++) {
-            rotaryExtKeyMap[i].keyStroke = rotaryExtKeyLayout[i];
-            rotaryExtKeyMap[i].keyInfo = rotaryExtKeyInfo[i];
-            rotaryExtKeyMap[i].state = false;
-        }
-        // Assign rotary encoder data
-        rotaryExtRotaryEncoders[0].button.keyStroke = rotaryExtRotaryMap[0];
-        rotaryExtRotaryEncoders[0].button.keyInfo = rotaryExtRotaryInfo[0];
-        rotaryExtRotaryEncoders[0].button.state = false;
-        rotaryExtRotaryEncoders[0].rotaryCCW = rotaryExtRotaryMap[1];
-        rotaryExtRotaryEncoders[0].rotaryCW = rotaryExtRotaryMap[2];
-        rotaryExtRotaryEncoders[0].rotaryCCWInfo = rotaryExtRotaryInfo[1];
-        rotaryExtRotaryEncoders[0].rotaryCWInfo = rotaryExtRotaryInfo[2];
-    }
+/**
+ * Point the keymap at the compiled table of currentLayoutIndex. No JSON walk
+ * and no allocation: the tables are built once by ConfigStore::reload().
+ *
+ */
+void activateLayer() {
+    const Keymap::Layer &layer = configStore.layer(currentLayoutIndex);
+    layerStack.setBase(currentLayoutIndex);
+    layoutLength = configStore.layerCount();
 
-    // Show layout title on screen
-    String str = doc["keyConfig"][currentLayoutIndex]["title"];
-    currentLayout = str;
-    Display::setBottom("@" + currentLayout);
+    // Show layout title on screen. Copied out: the label pool is rebuilt by
+    // the next reload.
+    const char *title = configStore.label(layer.title);
+    Display::setLayout(title);
+    showLayoutName();
 
     EEPROM.write(EEPROM_ADDR_LAYOUT, currentLayoutIndex);
-    Serial.println("Key layout loaded: " + currentLayout);
+    Serial.print("Key layout loaded: ");
+    Serial.println(title);
 }
 
 /**
- * Initialize every Macro instance that used in this program
+ * Make sure keyconfig.json is usable before the first load: a file that
+ * fails to parse or validate (a bad upload that got through, flash
+ * corruption) is rolled back to the version before its last rewrite, and
+ * past that to the packaged defaults.
  *
  */
-void initMacros() {
-    JsonDocument &doc = configStore.doc();
-    size_t macrosLength = doc["macros"].size();
-    for (size_t i = 0; i < macrosLength; i++) {
-        uint8_t macroLayout[] = {0, 0, 0, 0, 0, 0};
-        String macroNameStr = doc["macros"][i]["name"];
-        String macroStringContent = doc["macros"][i]["stringContent"];
-        macroMap[i].type = doc["macros"][i]["type"];
-        macroMap[i].macroInfo = macroNameStr;
-        macroMap[i].stringContent = macroStringContent;
-        copyArray(doc["macros"][i]["keyStrokes"], macroLayout);
-        std::copy(std::begin(macroLayout), std::end(macroLayout),
-                  std::begin(macroMap[i].keyStrokes));
+void checkKeyconfig() {
+    char error[96];
+    if (keyconfigFile.check(error, sizeof(error))) return;
+    Serial.print("keyconfig.json invalid: ");
+    Serial.println(error);
+
+    if (keyconfigFile.rollBack() && keyconfigFile.check(error, sizeof(error))) {
+        Serial.println("Rolled back to the previous keyconfig.json");
+        return;
     }
+    Serial.println("Restoring the default keyconfig.json");
+    keyconfigFile.restoreFrom("/keyconfig.default.json");
+}
+
+/**
+ * Apply the non-keymap settings of the loaded keyconfig.json
+ *
+ */
+void applySettings() {
+    debounceSettings.publish(configStore.debounce());
 }
 
 /**
@@ -1083,121 +1413,251 @@ void initMacros() {
 void updateKeymaps() {
     resetIdle();
 
-    Serial.println("Loading config files from SPIFFS...");
-    configStore.reload();
+    // Cleared first: a request made during the reload sets it again and gets
+    // a reload of its own
+    keymapsReloads++;
+    keymapsNeedsUpdate = false;
 
-    initKeys();
-    initMacros();
+    Serial.println("Loading config files from storage...");
+    configStore.reload(keyconfigFile);
+    // Layer indexes may refer to a different config now
+    layerStack.clear();
+    // and so may the label ids of turns not sent yet
+    onboardTurns.left = 0;
+    extTurns.left = 0;
+
+    applySettings();
+    activateLayer();
 
-    keymapsNeedsUpdate = false;
     configUpdated = true;
 }
 
-void readConfigButtons() {
-    int longPressCounter = 0;
-    if (digitalRead(CFG_BTN_PIN_1) == ACTIVE) {
-        resetIdle();
-        while (digitalRead(CFG_BTN_PIN_1) == ACTIVE) {
-            if (digitalRead(CFG_BTN_PIN_2) == ACTIVE) {
-                resetConfigFiles();
-                return;
-            }
-            delay(10);
-            if (longPressCounter > 100) {
-                goSleeping();
-            }
-            longPressCounter++;
-        }
-        isOutputLocked = !isOutputLocked;
-    } else if (digitalRead(CFG_BTN_PIN_2) == ACTIVE) {
-        resetIdle();
-        while (digitalRead(CFG_BTN_PIN_2) == ACTIVE) {
-            if (digitalRead(CFG_BTN_PIN_1) == ACTIVE) {
-                resetConfigFiles();
-                return;
-            }
-            delay(10);
-            if (longPressCounter > 100) {
-                isCaffeinated = !isCaffeinated;
-                while (digitalRead(CFG_BTN_PIN_2) == ACTIVE) {
-                    delay(10);
-                }
-                return;
-            }
-            longPressCounter++;
-        }
-        if (!isScreenSleeping) {
-            isScreenDisabled = !isScreenDisabled;
-        }
-    } else if (digitalRead(CFG_BTN_PIN_0) == ACTIVE) {
-        resetIdle();
-        while (digitalRead(CFG_BTN_PIN_0) == ACTIVE) {
-            delay(10);
-            if (longPressCounter > 100) {
-                switchBootMode();
-            }
-            longPressCounter++;
+/**
+ * Sample the bi-directional switch and configuration buttons
+ *
+ * @return {uint8_t} bit set per active input, in panelDebouncer order
+ */
+uint8_t readPanelInputs() {
+    const byte pins[kPanelInputs] = {BD_SW_CW,      BD_SW_CCW,
+                                     BD_SW_PUSH,    CFG_BTN_PIN_0,
+                                     CFG_BTN_PIN_1, CFG_BTN_PIN_2};
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < kPanelInputs; i++) {
+        if (digitalRead(pins[i]) == ACTIVE) {
+            active |= 1 << i;
         }
-        isUsbMode = !isUsbMode;
-        UsbHid::releaseAll();
-        BleHid::releaseAll();
     }
+    return active;
 }
 
+/**
+ * Restore config.json and keyconfig.json from their defaults. Runs once the
+ * reset chord has been held through the InputEngine's countdown.
+ *
+ */
 void resetConfigFiles() {
     resetIdle();
-    for (byte countDown = 5; 0 < countDown; countDown--) {
-        Display::setKeyInfo("Reset config in " + (String)countDown);
+    Display::setBottom("Resetting config...");
+    AtomicFile::copy(Storage::fs(), "/config.default.json", "/config.json");
+    keyconfigFile.restoreFrom("/keyconfig.default.json");
+    currentLayoutIndex = 0;
+    keymapsNeedsUpdate = true;
+    return;
+}
 
-        if (digitalRead(CFG_BTN_PIN_1) != ACTIVE ||
-            digitalRead(CFG_BTN_PIN_2) != ACTIVE) {
-            Display::setKeyInfo("Reset canceled");
-            delay(1000);
-            return;
+void InputActions::activity() { resetIdle(); }
+
+/**
+ * Key edge from the matrix or the extension board buttons
+ *
+ * @param {InputSource} source kInputMatrix or kInputExtButton
+ * @param {uint8_t} index key index within the source
+ * @param {bool} pressed true on press, false on release
+ */
+void InputActions::key(InputSource source, uint8_t index, bool pressed) {
+    if (source == kInputMatrix) {
+        if (index < ROWS * COLS) {
+            handleMatrixKey(index / COLS, index % COLS, pressed);
         }
-        delay(1000);
+        return;
     }
-    Display::setKeyInfo("Resetting config...");
-    delay(500);
-    if (SPIFFS.begin()) {
-        File configFile = SPIFFS.open("/config.default.json", "r");
-        File keyConfigFile = SPIFFS.open("/keyconfig.default.json", "r");
-        File configFileWrite = SPIFFS.open("/config.json", "w");
-        File keyConfigFileWrite = SPIFFS.open("/keyconfig.json", "w");
-        if (configFile && configFileWrite) {
-            while (configFile.available()) {
-                configFileWrite.write(configFile.read());
-            }
-            configFile.close();
-            configFileWrite.close();
+    if (index > EXT_KEYS) {
+        return;
+    }
+    Key &key = index == 0 ? rotaryExtButton : rotaryExtKeyMap[index - 1];
+    if (!pressed) {
+        keyRelease(key);
+        return;
+    }
+    const Keymap::KeyEntry &entry = layerStack.resolve(
+        layerAt,
+        [index](const Keymap::Layer &layer) -> const Keymap::KeyEntry & {
+            return index == 0 ? layer.extEncoder.button
+                              : layer.extKeys[index - 1];
+        });
+    pressEntry(key, entry);
+}
+
+/**
+ * Matrix key press: check whether the binding is a mod-tap ("MT_<code>") and,
+ * if so, keep it on the key for the gestures that follow. FN combos and
+ * other bindings go through key() as usual.
+ *
+ * @param {uint8_t} index matrix key, row * COLS + col
+ * @return {bool} whether the key is tap-hold
+ */
+bool InputActions::beginTapHold(uint8_t index) {
+    if (index >= ROWS * COLS || isFnKeyPressed) return false;
+    uint8_t row = index / COLS, col = index % COLS;
+    const Keymap::KeyEntry &entry = layerStack.resolve(
+        layerAt,
+        [row, col](const Keymap::Layer &layer) -> const Keymap::KeyEntry & {
+            return layer.keys[row][col];
+        });
+    if (entry.action != Keymap::kActionModTap) return false;
+
+    macroPlayer.cancel();
+    if (layerStack.consumeOneShot()) {
+        showTopLayer();
+    }
+    Key &key = keyMap[row][col];
+    key.pressed = entry;
+    key.state = false;
+    return true;
+}
+
+/**
+ * Mod-tap gesture: a tap types the key code, a hold keeps the modifier (the
+ * MT_ code) down until the key is released
+ *
+ * @param {uint8_t} index matrix key, row * COLS + col
+ * @param {Gesture} gesture kTap, kHold or kHoldEnd
+ */
+void InputActions::tapHold(uint8_t index, GestureRecognizer::Gesture gesture) {
+    Key &key = keyMap[index / COLS][index % COLS];
+    Keymap::KeyEntry entry = key.pressed;
+    if (gesture == GestureRecognizer::kTap) {
+        if (!isOutputLocked) {
+            kbd().write(entry.keyStroke);
         }
-        if (keyConfigFile && keyConfigFileWrite) {
-            while (keyConfigFile.available()) {
-                keyConfigFileWrite.write(keyConfigFile.read());
+        Display::setKeyInfo(configStore.label(entry.label));
+    } else if (gesture == GestureRecognizer::kHold) {
+        entry.keyStroke = entry.arg;
+        keyPress(key, entry);
+    } else if (gesture == GestureRecognizer::kHoldEnd) {
+        keyRelease(key);
+    }
+}
+
+/**
+ * Encoder turn of one or more detents
+ *
+ * @param {InputSource} source kInputOnboardEncoder or kInputExtEncoder
+ * @param {int8_t} direction 1 for CW, -1 for CCW
+ * @param {uint8_t} count detents
+ * @param {uint32_t} timeMs millis() of the newest detent
+ */
+void InputActions::turn(InputSource source, int8_t direction, uint8_t count,
+                        uint32_t timeMs) {
+    EncoderRing::Event detents = {direction, count, (uint16_t)timeMs};
+    bool onboard = source == kInputOnboardEncoder;
+    // The topmost layer that binds this direction supplies the whole encoder
+    // config (bindings and acceleration)
+    uint8_t layer = layerStack.resolveLayer(
+        layerAt,
+        [onboard, direction](const Keymap::Layer &layer)
+            -> const Keymap::KeyEntry & {
+            const Keymap::EncoderEntry &encoder =
+                onboard ? layer.onboardEncoder : layer.extEncoder;
+            return direction > 0 ? encoder.cw : encoder.ccw;
+        });
+    if (onboard) {
+        emitEncoderEvent(configStore.layer(layer).onboardEncoder, detents,
+                         onboardAccel, onboardTurns);
+    } else {
+        emitEncoderEvent(configStore.layer(layer).extEncoder, detents,
+                         extAccel, extTurns);
+    }
+}
+
+void InputActions::layout(uint8_t index) { switchLayout(index); }
+
+/**
+ * Bi-directional switch and configuration button actions
+ *
+ * @param {InputEngine::Command} command the action to run
+ */
+void InputActions::command(InputEngine::Command command) {
+    switch (command) {
+        case InputEngine::kNextLayout:
+            switchLayout(currentLayoutIndex + 1);
+            break;
+        case InputEngine::kPreviousLayout:
+            switchLayout(currentLayoutIndex - 1);
+            break;
+        case InputEngine::kFirstLayout:
+            switchLayout(0);
+            break;
+        case InputEngine::kToggleLock:
+            isOutputLocked = !isOutputLocked;
+            break;
+        case InputEngine::kToggleCaffeine:
+            isCaffeinated = !isCaffeinated;
+            break;
+        case InputEngine::kToggleScreen:
+            if (!isScreenSleeping) {
+                isScreenDisabled = !isScreenDisabled;
             }
-            keyConfigFile.close();
-            keyConfigFileWrite.close();
-        }
-        currentLayoutIndex = 0;
-        keymapsNeedsUpdate = true;
+            break;
+        case InputEngine::kToggleOutput:
+            isUsbMode = !isUsbMode;
+            usbOutput.releaseAll();
+            bleOutput.releaseAll();
+            break;
+        case InputEngine::kSleep:
+            goSleeping();
+            break;
+        case InputEngine::kSwitchBootMode:
+            switchBootMode();
+            break;
+        case InputEngine::kResetConfig:
+            resetConfigFiles();
+            break;
+        case InputEngine::kResetCanceled:
+            Display::setBottom("Reset canceled");
+            break;
     }
-    return;
+}
+
+/**
+ * Show the config reset countdown while CFG1+CFG2 are held
+ *
+ * @param {uint8_t} secondsLeft seconds until the reset
+ */
+void InputActions::resetCountdown(uint8_t secondsLeft) {
+    char text[Display::kLineSize];
+    snprintf(text, sizeof(text), "Reset config in %u", secondsLeft);
+    Display::setBottom(text);
 }
 
 /**
  * Press key
  *
  * @param {Key} key the key to be pressed
+ * @param {KeyEntry} entry the key's binding in the active layer
  */
-void keyPress(Key &key) {
-    if (key.keyInfo == "FN") {
+void keyPress(Key &key, const Keymap::KeyEntry &entry) {
+    if (entry.action == Keymap::kActionFn) {
         isFnKeyPressed = true;
     }
-    if (key.state == false && !isOutputLocked) {
-        kbd().press(key.keyStroke);
+    if (key.state == false) {
+        if (!isOutputLocked) {
+            kbd().stagePress(entry.keyStroke);
+        }
+        key.pressed = entry;
     }
     key.state = true;
-    Display::setKeyInfo(key.keyInfo);
+    Display::setKeyInfo(configStore.label(entry.label));
 }
 
 /**
@@ -1206,109 +1666,132 @@ void keyPress(Key &key) {
  * @param {Key} key the key to be released
  */
 void keyRelease(Key &key) {
-    if (key.keyInfo == "FN") {
+    if (key.state && LayerStack::isLayerKey(key.pressed)) {
+        key.state = false;
+        if (layerStack.release(key.pressed, millis())) {
+            showTopLayer();
+        }
+        return;
+    }
+    if (key.pressed.action == Keymap::kActionFn) {
         isFnKeyPressed = false;
     }
     if (key.state == true && !isOutputLocked) {
-        kbd().release(key.keyStroke);
+        kbd().stageRelease(key.pressed.keyStroke);
     }
     key.state = false;
     return;
 }
 
 /**
- * Press macro keys
+ * Play the macro at the given index of the compiled macro table (decoded from
+ * a "MACRO_<n>" key info at load time). The program is queued on the macro
+ * task, so this returns without waiting for playback. Out-of-range indexes
+ * are ignored.
  *
- * @param {Macro} macro to be pressed
- * type 0: for key strokes
- * type 1: for string content
- * type 2: for string content w/ enter key
+ * @param {uint8_t} index macro index
  */
-void macroPress(Macro &macro) {
-    Display::setKeyInfo(macro.macroInfo);
+void macroPressByIndex(uint8_t index) {
+    const MacroTable &macros = configStore.macros();
+    const MacroTable::Entry *macro = macros.get(index);
+    if (!macro) {
+        return;
+    }
+    Display::setKeyInfo(configStore.label(macro->name));
     // Respect output lock (matches keyPress: still show the info, emit nothing)
     if (isOutputLocked) {
         return;
     }
-    if (macro.type == 0) {
-        size_t length = sizeof(macro.keyStrokes);
-        for (size_t i = 0; i < length; i++) {
-            kbd().press(macro.keyStrokes[i]);
-            delayMicroseconds(10);
-        }
-        delay(50);
-        kbd().releaseAll();
-    } else if (macro.type == 1) {
-        kbd().print(macro.stringContent);
-    } else if (macro.type == 2) {
-        kbd().println(macro.stringContent);
-    }
-    delay(100);
-}
-
-/**
- * Press the macro referenced by a "MACRO_<index>" key info string
- *
- * @param {String} info key info of the form "MACRO_<index>"
- */
-void macroPressByInfo(const String &info) {
-    macroPress(macroMap[info.substring(6).toInt()]);
+    const MacroDelayConfig &delays = configStore.macroDelay();
+    macroPlayer.setInterKeyMs(isUsbMode ? delays.usbMs : delays.bleMs);
+    if (!MacroProgram::run(macros.code(*macro), macro->size,
+                           configStore.labels(), macroPlayer)) {
+        Serial.println("Malformed macro program");
+    }
+    // Never leave keys held, even when the queue cut the macro short, and
+    // keep a gap before a following macro
+    if (!macroPlayer.finish(100)) {
+        Serial.println("Macro too long for the queue, truncated");
+        Display::setKeyInfo("Macro truncated");
+    }
 }
 
 /**
- * Emit a single rotary-encoder turn for the given key info. Triggers a macro
- * for "MACRO_<index>" info, otherwise taps the key code on the active output.
+ * Queue the turns of one encoder event (one or more detents in the same
+ * direction), applying the encoder's acceleration: fast detents send the
+ * fast binding if one is configured, else repeat the normal one. The turns
+ * are sent by sendPendingTurns().
  *
- * @param {uint8_t} keyStroke the key code to tap
- * @param {String} info key info describing the turn
+ * @param {EncoderEntry} encoder the encoder's bindings in the active layer
+ * @param {EncoderRing::Event} event the detents to emit
+ * @param {StepAccelerator} accel the encoder's velocity tracker
+ * @param {PendingTurns} pending the encoder's turns not sent yet
  */
-void emitEncoderTurn(uint8_t keyStroke, const String &info) {
-    resetIdle();
-    bool isMacro = info.startsWith("MACRO_");
-    if (!isOutputLocked) {
-        if (isMacro) {
-            macroPressByInfo(info);
+void emitEncoderEvent(const Keymap::EncoderEntry &encoder,
+                      const EncoderRing::Event &event, StepAccelerator &accel,
+                      PendingTurns &pending) {
+    int8_t direction = event.direction;
+    const Keymap::KeyEntry *entry = direction > 0 ? &encoder.cw : &encoder.ccw;
+    uint32_t turns = event.count;
+    if (accel.isFast(direction, event.count, event.timeMs,
+                     encoder.accel.fastMs)) {
+        const Keymap::KeyEntry &fast =
+            direction > 0 ? encoder.accel.fastCw : encoder.accel.fastCcw;
+        if (fast.keyStroke || fast.action != Keymap::kActionKey) {
+            entry = &fast;
         } else {
-            kbd().release(keyStroke);
-            kbd().write(keyStroke);
+            turns *= encoder.accel.repeat;
         }
     }
-    if (!isMacro) {
-        Display::setKeyInfo(info);
+    // Turning the other way (or onto another binding) drops what is left
+    if (pending.entry.keyStroke != entry->keyStroke ||
+        pending.entry.action != entry->action ||
+        pending.entry.arg != entry->arg) {
+        pending.left = 0;
     }
+    pending.entry = *entry;
+    pending.left = std::min<uint32_t>(pending.left + turns, UINT16_MAX);
 }
 
 /**
- * Tap toggle layer
+ * Send up to kMaxTurnsPerFrame of each encoder's pending turns
  *
- * @param {size_t} index of the layer to be toggled
+ * @return {bool} whether turns are left for the next frame
  */
-void tapToggleActive(size_t index) {
-    isTemporaryToggled = true;
-    tapToggleOrginalLayerIndex = currentLayoutIndex;
-    currentLayoutIndex = index;
-    initKeys();
+bool sendPendingTurns() {
+    PendingTurns *encoders[] = {&onboardTurns, &extTurns};
+    bool turnsLeft = false;
+    for (PendingTurns *pending : encoders) {
+        uint16_t turns = std::min(pending->left, kMaxTurnsPerFrame);
+        pending->left -= turns;
+        for (uint16_t i = 0; i < turns; i++) {
+            emitEncoderTurn(pending->entry);
+        }
+        turnsLeft = turnsLeft || pending->left;
+    }
+    return turnsLeft;
 }
 
 /**
- * Tap toggle layer release
+ * Emit a single rotary-encoder turn for the given binding. Triggers a macro
+ * for "MACRO_<index>" info, otherwise taps the key code on the active output.
  *
- * @param {size_t} original layer index of the layer to be restored
+ * @param {KeyEntry} entry the encoder direction's binding
  */
-void tapToggleRelease(size_t orginalLayerIndex) {
-    isTemporaryToggled = false;
-    tapToggleCount++;
-    if (currentMillis - tapTogglePreviousMillis < 300) {
-        if (tapToggleCount > 1) {
-            tapToggleCount = 0;
-            currentLayoutIndex = orginalLayerIndex;
+void emitEncoderTurn(const Keymap::KeyEntry &entry) {
+    resetIdle();
+    bool isMacro = entry.action == Keymap::kActionMacro;
+    if (!isOutputLocked) {
+        if (isMacro) {
+            macroPressByIndex(entry.arg);
+        } else {
+            kbd().release(entry.keyStroke);
+            kbd().write(entry.keyStroke);
         }
-    } else {
-        tapToggleCount = 0;
-        currentLayoutIndex = orginalLayerIndex;
     }
-    tapTogglePreviousMillis = currentMillis;
-    initKeys();
+    if (!isMacro) {
+        Display::setKeyInfo(configStore.label(entry.label));
+    }
 }
 
 /**
@@ -1318,8 +1801,7 @@ void tapToggleRelease(size_t orginalLayerIndex) {
 void switchLayout() {
     currentLayoutIndex =
         currentLayoutIndex < layoutLength - 1 ? currentLayoutIndex + 1 : 0;
-    initKeys();
-    delay(300);
+    activateLayer();
 }
 
 // overload switchLayout() to accept layout index as parameter
@@ -1330,16 +1812,15 @@ void switchLayout(int layoutIndex) {
         layoutIndex = layoutLength - 1;
     }
     currentLayoutIndex = layoutIndex;
-    initKeys();
+    activateLayer();
 }
 
-// input layout name as string and find the index of that layout
+// input layout name as string and find the index of that layout (other
+// tasks than the input task call it inside a ConfigStore::Reader)
 int findLayoutIndex(String layoutName) {
-    JsonDocument &doc = configStore.doc();
-    JsonArrayConst layouts = doc["keyConfig"].as<JsonArrayConst>();
-    for (size_t i = 0; i < layouts.size(); i++) {
-        String str = layouts[i]["title"];
-        if (str.equalsIgnoreCase(layoutName)) {
+    for (size_t i = 0; i < configStore.layerCount(); i++) {
+        const char *title = configStore.label(configStore.layer(i).title);
+        if (layoutName.equalsIgnoreCase(title)) {
             return i;
         }
     }
@@ -1347,13 +1828,13 @@ int findLayoutIndex(String layoutName) {
 }
 
 /**
- * Load JSON file as string from SPIFFS
+ * Load JSON file as string from storage
  *
  * @param {filename} JSON file name (w/o extension)
  * @return {filestring} file content as string
  */
 String loadJSONFileAsString(String filename) {
-    File file = SPIFFS.open("/" + filename + ".json");
+    File file = Storage::fs().open("/" + filename + ".json");
     String buffer;
     if (!file) {
         Serial.println("Failed to open file for reading");
@@ -1375,27 +1856,48 @@ void setCPUFrequency(int freq) {
     Serial.println("CPU clock speed set to " + String(freq) + "Mhz");
 }
 
+/**
+ * Show the current layout name ("@<title>") on the bottom line
+ *
+ */
+void showLayoutName() { Display::showLayout(); }
+
 /**
  * Print message on oled screen.
  *
  * @param {char} array to print on oled screen
  */
 void renderScreen() {
-    String contentTop, contentBottom;
-    int contentIcon;
-    Display::snapshot(contentTop, contentBottom, contentIcon);
+    Display::State content;
+    Display::snapshot(content);
+
+    // Skip the frame when neither the Display state nor the screen mode
+    // changed since the last one
+    bool isBlank = clearDisplay || isScreenDisabled || isScreenSleeping;
+    int8_t mode = (isBlank ? 1 : 0) | (isScreenInverted ? 2 : 0);
+    if (content.generation == renderedGeneration && mode == renderedMode) {
+        renderStats.skipped++;
+        return;
+    }
+    renderedGeneration = content.generation;
+    renderedMode = mode;
 
     u8g2.clearBuffer();
+    if (isBlank) {
+        sendChangedTiles();
+        return;
+    }
+
     u8g2.setFont(u8g2_font_ncenB08_tr);
     u8g2.setFontPosCenter();
-    u8g2.drawStr(16 + 4, 24, contentBottom.c_str());
+    u8g2.drawStr(16 + 4, 24, content.bottom);
 
     u8g2.setFont(u8g2_font_ncenB08_tr);
     u8g2.setFontPosCenter();
-    u8g2.drawStr(16 + 4, 10, contentTop.c_str());
+    u8g2.drawStr(16 + 4, 10, content.top);
 
     u8g2.setFont(u8g2_font_open_iconic_all_2x_t);
-    switch (contentIcon) {
+    switch (content.icon) {
         case 0:
             u8g2.drawGlyph(0, 16, 0xCD);
             break;
@@ -1436,18 +1938,39 @@ void renderScreen() {
             u8g2.drawGlyph(0, 16, 0x00);
     }
 
-    while (clearDisplay || isScreenDisabled || isScreenSleeping) {
-        u8g2.clearBuffer();
-        u8g2.sendBuffer();
-        delay(100);
-    }
-
     if (isScreenInverted) {
         u8g2.drawBox(0, 0, 192, 64);
         u8g2.setDrawColor(2);
     }
 
-    u8g2.sendBuffer();
+    sendChangedTiles();
+}
+
+/**
+ * Send one tile span of the u8g2 buffer to the panel (arbiter job)
+ *
+ * @param {FrameDiff::Span} span tiles to send
+ */
+bool sendOledSpan(void *span) {
+    const FrameDiff::Span &s = *static_cast<const FrameDiff::Span *>(span);
+    u8g2.updateDisplayArea(s.tileX, s.tileY, s.tileWidth, 1);
+    return true;
+}
+
+/**
+ * Push the tiles of the u8g2 buffer that differ from the frame on the panel
+ *
+ */
+void sendChangedTiles() {
+    FrameDiff::Span spans[FrameDiff::kTileRows];
+    uint8_t count = oledFrame.diff(u8g2.getBufferPtr(), spans);
+    // One arbiter job per page, so extension board reads can slip in
+    // between pages
+    for (uint8_t i = 0; i < count; i++) {
+        i2cBus.run(kI2cOled, kI2cLow, sendOledSpan, &spans[i]);
+        renderStats.bytesSent += spans[i].tileWidth * FrameDiff::kTileBytes;
+    }
+    renderStats.rendered++;
 }
 
 /**
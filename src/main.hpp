@@ -1,14 +1,11 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <EEPROM.h>
-#include <ESP32Encoder.h>
 #include <ESPmDNS.h>
 #include <FastLED.h>
 #include <ImprovWiFiLibrary.h>
 #include <PCF8574.h>
-#include <SPIFFS.h>
 #include <U8g2lib.h>
-#include <WebServer.h>
 #include <WiFi.h>
 #include <Wire.h>
 #include <driver/rtc_io.h>
@@ -21,11 +18,31 @@
 #include <iterator>
 #include <string>
 
+#include "atomic_file.h"
+#include "config_patch.h"
 #include "config_store.h"
+#include "config_upload.h"
+#include "debounce.h"
+#include "encoder_ring.h"
+#include "file_stream.h"
 #include "display_state.h"
 #include "driver/adc.h"
 #include "esp_adc_cal.h"
+#include "frame_diff.h"
+#include "i2c_arbiter.h"
+#include "input_bus.h"
+#include "input_engine.h"
+#include "keyconfig_file.h"
 #include "keyboard_output.h"
+#include "keymap.h"
+#include "layer_stack.h"
+#include "macro_player.h"
+#include "matrix_scanner.h"
+#include "quadrature.h"
+#include "scan_scheduler.h"
+#include "scan_wake.h"
+#include "serial_intake.h"
+#include "storage.h"
 #include "web_server.h"
 
 using namespace std;
@@ -46,9 +63,6 @@ using namespace std;
 #define AP_SSID "Schnell Keypad WLAN"
 #define MDNS_NAME "Schnell"
 
-#define ROWS 5
-#define COLS 7
-
 #define SCL 15
 #define SDA 16
 
@@ -80,57 +94,110 @@ using namespace std;
 #define extensionBtn2 P1
 #define extensionBtn3 P2
 #define ENCODER_EXTENSION_ADDR 0x38
+// GPIO wired to the PCF8574 INT output (open drain, low on any input change).
+// -1 when not connected: the board is then polled every 3 ms.
+#define ENCODER_EXTENSION_INT_PIN -1
 
 // ====== End Extension Board Pin Definition ======
 
+// Runtime state of one physical key. The binding itself lives in the compiled
+// layer table; `pressed` keeps the binding that was actually sent so a release
+// after a layer switch lets go of the same key code.
 struct Key {
-    uint8_t keyStroke;
     bool state;
-    String keyInfo;
+    Keymap::KeyEntry pressed;
+};
+
+// Extension board inputs, decoded from one digitalReadAll() transaction.
+// Button bit i (set while pressed): encoder switch, button 1, button 2,
+// button 3.
+struct ExtensionInputs {
+    uint8_t levels;  // raw pin levels, bit n = Pn
+    bool pinA;
+    bool pinB;
+    uint8_t buttons;
 };
 
-struct RotaryEncoderConfig {
-    Key button;
-    uint8_t rotaryCW;
-    uint8_t rotaryCCW;
-    String rotaryCWInfo;
-    String rotaryCCWInfo;
+// Carries out the InputEngine's decisions on the keymap and outputs. Only the
+// input task calls into it, so key state has a single writer.
+class InputActions : public InputEngine::Actions {
+   public:
+    void activity() override;
+    void key(InputSource source, uint8_t index, bool pressed) override;
+    bool beginTapHold(uint8_t index) override;
+    void tapHold(uint8_t index, GestureRecognizer::Gesture gesture) override;
+    void turn(InputSource source, int8_t direction, uint8_t count,
+              uint32_t timeMs) override;
+    void layout(uint8_t index) override;
+    void command(InputEngine::Command command) override;
+    void resetCountdown(uint8_t secondsLeft) override;
 };
 
-struct Macro {
-    unsigned short type;
-    // 6 key roll over using BLE keyboard
-    uint8_t keyStrokes[6];
-    String macroInfo;
-    String stringContent;
+// Serial side of the configuration tool: commands run on the loop, uploads
+// go through a ConfigUpload like the web ones.
+class SerialConfigSink : public SerialIntake::Sink {
+   public:
+    void command(const char *line) override;
+    void jsonBegin() override;
+    void jsonData(const uint8_t *data, size_t size) override;
+    void jsonEnd(bool complete) override;
 };
 
 // Tasks
 void ledTask(void *);
 void generalTask(void *);
-void ICACHE_RAM_ATTR encoderTask(void *);
+void inputTask(void *);
+void IRAM_ATTR onOnboardEncoderEdge();
 void ICACHE_RAM_ATTR encoderExtBoardTask(void *);
+void IRAM_ATTR onExtensionInterrupt();
+void macroTask(void *);
 void i2cTask(void *);
 
+// I2C arbiter jobs
+bool readExtensionInputs(void *inputs);
+bool probeExtension(void *);
+bool sendOledSpan(void *span);
+
 // Keyboard
-void initKeys();
-void initMacros();
+
+// Encoder turns accepted but not sent yet (see sendPendingTurns)
+struct PendingTurns {
+    Keymap::KeyEntry entry;
+    uint16_t left;
+};
+
+void initKeyPins();
+void handleMatrixKey(uint8_t row, uint8_t col, bool pressed);
+void activateLayer();
+void checkKeyconfig();
+void applySettings();
 void updateKeymaps();
-void keyPress(Key &key);
+void keyPress(Key &key, const Keymap::KeyEntry &entry);
 void keyRelease(Key &key);
-void macroPress(Macro &macro);
-void macroPressByInfo(const String &info);
-void emitEncoderTurn(uint8_t keyStroke, const String &info);
-void tapToggleActive(size_t index);
-void tapToggleRelease(size_t orginalLayerIndex);
+void macroPressByIndex(uint8_t index);
+void emitEncoderEvent(const Keymap::EncoderEntry &encoder,
+                      const EncoderRing::Event &event, StepAccelerator &accel,
+                      PendingTurns &pending);
+bool sendPendingTurns();
+void emitEncoderTurn(const Keymap::KeyEntry &entry);
+void pressEntry(Key &key, const Keymap::KeyEntry &entry);
+void layerKeyPress(Key &key, const Keymap::KeyEntry &entry);
+const Keymap::Layer &layerAt(uint8_t index);
+void showTopLayer();
 void switchLayout();
 void switchLayout(int layoutIndex);
 int findLayoutIndex(String layoutName);
 void switchDevice();
-void readConfigButtons();
+uint8_t readPanelInputs();
+void drainEncoderRings();
+void applyKeyPatches();
+int patchKeyconfig(JsonVariantConst changes, char *error, size_t errorSize);
+void handleSerialCommand(const String &command);
 
 // OLED Control
 void renderScreen();
+void sendChangedTiles();
+void showLayoutName();
 
 // Power Management
 void switchBootMode();
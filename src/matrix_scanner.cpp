@@ -0,0 +1,70 @@
+#include "matrix_scanner.h"
+
+#include <Arduino.h>
+#include <soc/gpio_struct.h>
+
+namespace {
+const uint8_t *gRowPins = nullptr;
+const uint8_t *gColPins = nullptr;
+
+// Time for a driven row to settle before its columns are sampled.
+const uint32_t kSettleMicros = 10;
+
+inline void setPin(uint8_t pin, bool high) {
+    if (pin < 32) {
+        if (high) {
+            GPIO.out_w1ts = 1UL << pin;
+        } else {
+            GPIO.out_w1tc = 1UL << pin;
+        }
+    } else {
+        if (high) {
+            GPIO.out1_w1ts.val = 1UL << (pin - 32);
+        } else {
+            GPIO.out1_w1tc.val = 1UL << (pin - 32);
+        }
+    }
+}
+}  // namespace
+
+namespace MatrixGpio {
+
+void begin(const uint8_t *rowPins, const uint8_t *colPins) {
+    gRowPins = rowPins;
+    gColPins = colPins;
+
+    for (int r = 0; r < ROWS; r++) {
+        pinMode(gRowPins[r], OUTPUT);
+        digitalWrite(gRowPins[r], HIGH);
+    }
+
+    for (int c = 0; c < COLS; c++) {
+        pinMode(gColPins[c], INPUT_PULLUP);
+    }
+}
+
+uint8_t IRAM_ATTR readRow(uint8_t row) {
+    setPin(gRowPins[row], false);
+    delayMicroseconds(kSettleMicros);
+    uint32_t in0 = GPIO.in;
+    uint32_t in1 = GPIO.in1.val;
+    setPin(gRowPins[row], true);
+
+    uint8_t active = 0;
+    for (int c = 0; c < COLS; c++) {
+        uint8_t pin = gColPins[c];
+        uint32_t level = pin < 32 ? (in0 >> pin) : (in1 >> (pin - 32));
+        if ((level & 1) == 0) {
+            active |= 1 << c;
+        }
+    }
+    return active;
+}
+
+void setAllRows(uint8_t level) {
+    for (int r = 0; r < ROWS; r++) {
+        setPin(gRowPins[r], level == HIGH);
+    }
+}
+
+}  // namespace MatrixGpio
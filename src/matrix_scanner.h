@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "keymap.h"
+
+// Column bits read while one row is driven: bit c set = column c active.
+typedef uint8_t (*MatrixRowReader)(uint8_t row);
+
+// Scans the key matrix into a ROWS x COLS bitmask (bit r * COLS + c). Pure
+// logic: the GPIO access is injected as a row reader, the hardware one lives in
+// MatrixGpio. The raw snapshot goes through a Debouncer, whose change mask is
+// then dispatched with forEachKeyChange(), so only keys whose state actually
+// changed are handled.
+class MatrixScanner {
+   public:
+    typedef uint64_t State;
+
+    explicit MatrixScanner(MatrixRowReader readRow) : readRow_(readRow) {}
+
+    // Read every row and return the raw snapshot (bit set = key down).
+    State read() const {
+        State snapshot = 0;
+        for (uint8_t r = 0; r < ROWS; r++) {
+            snapshot |= (State)readRow_(r) << (r * COLS);
+        }
+        return snapshot;
+    }
+
+   private:
+    MatrixRowReader readRow_;
+};
+
+// Call fn(row, col, pressed) for every key set in `changed`, in row-major
+// order, with `pressed` taken from `state`.
+template <typename Fn>
+void forEachKeyChange(MatrixScanner::State changed, MatrixScanner::State state,
+                      Fn fn) {
+    while (changed) {
+        int bit = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        fn(bit / COLS, bit % COLS, ((state >> bit) & 1) != 0);
+    }
+}
+
+// ESP32-S3 matrix GPIO: rows are driven through the set/clear registers and
+// all columns of a row are sampled with one GPIO.in / GPIO.in1 read.
+namespace MatrixGpio {
+
+// Configure row pins as outputs (idle HIGH) and column pins as pull-ups. The
+// arrays must outlive the scanner.
+void begin(const uint8_t *rowPins, const uint8_t *colPins);
+
+// MatrixRowReader for the real hardware (columns are active LOW).
+uint8_t readRow(uint8_t row);
+
+// Drive every row at once: LOW parks the matrix so any key press pulls its
+// column down (see ScanWake), HIGH restores the idle level between scans.
+void setAllRows(uint8_t level);
+
+}  // namespace MatrixGpio
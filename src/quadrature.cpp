@@ -0,0 +1,10 @@
+#include "quadrature.h"
+
+// In DRAM so the ISR can read it while the flash cache is off.
+DRAM_ATTR const int8_t QuadratureDecoder::kTransitions[16] = {
+    // to: 00  01  10  11
+    0,  -1, 1,  0,   // from 00
+    1,  0,  0,  -1,  // from 01
+    -1, 0,  0,  1,   // from 10
+    0,  1,  -1, 0,   // from 11
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Table-driven quadrature decoder shared by the onboard encoder (fed from GPIO
+// interrupts) and the extension board encoder (fed from PCF8574 reads). Each
+// A/B sample is looked up by (previous state, new state); invalid transitions
+// (both pins changed, i.e. a missed sample) count as no movement.
+class QuadratureDecoder {
+   public:
+    // transitionsPerStep: valid A/B transitions per emitted step (4 = one
+    // step per full quadrature cycle, 2 = one per half cycle).
+    explicit QuadratureDecoder(uint8_t transitionsPerStep)
+        : transitionsPerStep_(transitionsPerStep),
+          state_(kUnknown),
+          accumulated_(0) {}
+
+    // Feed the current pin levels. Returns +1 (CW), -1 (CCW) or 0. Safe to
+    // call from an ISR.
+    inline int8_t IRAM_ATTR update(bool a, bool b) {
+        uint8_t state = (a ? 2 : 0) | (b ? 1 : 0);
+        if (state_ == kUnknown) {
+            state_ = state;
+            return 0;
+        }
+        accumulated_ += kTransitions[(state_ << 2) | state];
+        state_ = state;
+        if (accumulated_ >= transitionsPerStep_) {
+            accumulated_ = 0;
+            return 1;
+        }
+        if (accumulated_ <= -transitionsPerStep_) {
+            accumulated_ = 0;
+            return -1;
+        }
+        return 0;
+    }
+
+   private:
+    static const uint8_t kUnknown = 0xFF;
+    // (previous << 2 | current) -> +1 CW, -1 CCW, 0 none/invalid. CW runs
+    // AB 10 -> 11 -> 01 -> 00 -> 10.
+    static const int8_t kTransitions[16];
+
+    int8_t transitionsPerStep_;
+    uint8_t state_;
+    int8_t accumulated_;
+};
+
+// Velocity detection for encoder acceleration: detents count as fast when
+// they follow the previous ones in the same direction at less than fastMs
+// apart on average.
+class StepAccelerator {
+   public:
+    StepAccelerator() : lastMs_(0), lastDirection_(0) {}
+
+    // `count` detents in `direction`, the newest at timeMs (low 16 bits of
+    // millis()).
+    bool isFast(int8_t direction, uint8_t count, uint16_t timeMs,
+                uint8_t fastMs) {
+        uint16_t elapsed = timeMs - lastMs_;
+        bool fast = fastMs && direction == lastDirection_ &&
+                    elapsed < (uint32_t)fastMs * count;
+        lastMs_ = timeMs;
+        lastDirection_ = direction;
+        return fast;
+    }
+
+   private:
+    uint16_t lastMs_;
+    int8_t lastDirection_;
+};
@@ -0,0 +1,24 @@
+#include "scan_scheduler.h"
+
+ScanScheduler::ScanScheduler(uint32_t idleAfterMs, uint32_t idlePollMs)
+    : idleAfterMs_(idleAfterMs),
+      idlePollMs_(idlePollMs),
+      lastActivityMs_(0),
+      mode_(kActive) {}
+
+ScanScheduler::Step ScanScheduler::onScan(bool activity, uint32_t nowMs) {
+    if (activity) {
+        lastActivityMs_ = nowMs;
+        if (mode_ == kActive) return kStayActive;
+        mode_ = kActive;
+        return kWake;
+    }
+    if (mode_ == kIdle) return kStayIdle;
+    if (nowMs - lastActivityMs_ < idleAfterMs_) return kStayActive;
+    mode_ = kIdle;
+    return kEnterIdle;
+}
+
+uint32_t ScanScheduler::waitMs() const {
+    return mode_ == kIdle ? idlePollMs_ : 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decides how loop() paces the matrix scan. While keys are active it scans
+// back to back; once nothing has been held or changed for idleAfterMs it
+// drops to low-power mode, where the caller parks the matrix and blocks in
+// ScanWake::wait() until a key interrupt (or idlePollMs) wakes it. Pure logic
+// driven by the caller's clock.
+class ScanScheduler {
+   public:
+    enum Mode : uint8_t { kActive, kIdle };
+
+    // What one scan pass changed: the caller arms the wake interrupts on
+    // kEnterIdle and releases them on kWake, so they stay attached for the
+    // whole idle stretch instead of once per wait.
+    enum Step : uint8_t { kStayActive, kEnterIdle, kStayIdle, kWake };
+
+    ScanScheduler(uint32_t idleAfterMs, uint32_t idlePollMs);
+
+    // Report one scan pass (`activity`: any key down or changed in it) and
+    // return the transition it caused.
+    Step onScan(bool activity, uint32_t nowMs);
+
+    Mode mode() const { return mode_; }
+
+    // How long the caller may block before the next pass: 0 while active
+    // (scan back to back); idlePollMs while idle, so serial input and config
+    // reloads polled by loop() are still picked up.
+    uint32_t waitMs() const;
+
+   private:
+    uint32_t idleAfterMs_;
+    uint32_t idlePollMs_;
+    uint32_t lastActivityMs_;
+    Mode mode_;
+};
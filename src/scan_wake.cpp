@@ -0,0 +1,61 @@
+#include "scan_wake.h"
+
+#include <Arduino.h>
+
+namespace {
+const uint8_t kMaxWakePins = 16;
+
+uint8_t gPins[kMaxWakePins];
+uint8_t gPinCount = 0;
+TaskHandle_t gWaiter = nullptr;
+bool gArmed = false;
+
+void IRAM_ATTR onWakeEdge() {
+    BaseType_t woken = pdFALSE;
+    if (gWaiter) vTaskNotifyGiveFromISR(gWaiter, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+bool anyPinActive() {
+    for (uint8_t i = 0; i < gPinCount; i++) {
+        if (digitalRead(gPins[i]) == LOW) return true;
+    }
+    return false;
+}
+}  // namespace
+
+namespace ScanWake {
+
+void addPin(uint8_t pin) {
+    if (gPinCount < kMaxWakePins) gPins[gPinCount++] = pin;
+}
+
+void arm() {
+    if (gArmed) return;
+    gWaiter = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < gPinCount; i++) {
+        attachInterrupt(gPins[i], onWakeEdge, FALLING);
+    }
+    gArmed = true;
+}
+
+void disarm() {
+    if (!gArmed) return;
+    for (uint8_t i = 0; i < gPinCount; i++) {
+        detachInterrupt(gPins[i]);
+    }
+    gArmed = false;
+}
+
+bool wait(uint32_t timeoutMs) {
+    // Drop notifications left by edges since the last wait: the idle scan
+    // pass itself drives rows and can raise them.
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // An input that went LOW before the rows were parked produced no edge;
+    // don't sleep through it.
+    return anyPinActive() ||
+           ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+}
+
+}  // namespace ScanWake
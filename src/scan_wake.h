@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+// GPIO wake-up for the low-power scan mode. Every registered pin is an active
+// LOW input; with the matrix rows parked LOW, any key press pulls its column
+// down and the falling edge notifies the waiting task.
+namespace ScanWake {
+
+// Register a wake pin. Call from setup(), before the first arm().
+void addPin(uint8_t pin);
+
+// Attach the wake interrupts for the calling task, on entering idle. They
+// stay attached across wait() calls until disarm().
+void arm();
+
+// Detach the wake interrupts, on leaving idle.
+void disarm();
+
+// Block the armed task until a wake pin falls or timeoutMs passes. Returns
+// immediately (true) if a wake pin is already LOW. Returns true when woken by
+// an input, false on timeout.
+bool wait(uint32_t timeoutMs);
+
+}  // namespace ScanWake
@@ -0,0 +1,90 @@
+#include "serial_intake.h"
+
+#include <ctype.h>
+
+void SerialIntake::feed(const uint8_t *data, size_t size, uint32_t nowMs) {
+    if (size) lastByteMs_ = nowMs;
+
+    size_t i = 0;
+    while (i < size) {
+        if (mode_ == kJson) {
+            i += feedJson(data + i, size - i);
+            continue;
+        }
+
+        char c = data[i];
+        if (mode_ == kIdle) {
+            if (isspace((unsigned char)c)) {
+                i++;
+                continue;
+            }
+            if (c == '{') {
+                mode_ = kJson;
+                depth_ = 0;
+                inString_ = false;
+                escaped_ = false;
+                sink_.jsonBegin();
+                continue;
+            }
+            mode_ = kLine;
+            lineLength_ = 0;
+            lineOverflow_ = false;
+        }
+
+        i++;
+        if (c == '\n' || c == '\r') {
+            endLine();
+        } else if (lineLength_ + 1 < kLineSize) {
+            line_[lineLength_++] = c;
+        } else {
+            lineOverflow_ = true;
+        }
+    }
+}
+
+size_t SerialIntake::feedJson(const uint8_t *data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        char c = data[i++];
+        if (inString_) {
+            if (escaped_) {
+                escaped_ = false;
+            } else if (c == '\\') {
+                escaped_ = true;
+            } else if (c == '"') {
+                inString_ = false;
+            }
+        } else if (c == '"') {
+            inString_ = true;
+        } else if (c == '{' || c == '[') {
+            depth_++;
+        } else if ((c == '}' || c == ']') && depth_ > 0 && --depth_ == 0) {
+            sink_.jsonData(data, i);
+            sink_.jsonEnd(true);
+            mode_ = kIdle;
+            return i;
+        }
+    }
+    sink_.jsonData(data, size);
+    return size;
+}
+
+void SerialIntake::endLine() {
+    mode_ = kIdle;
+    if (lineOverflow_) return;
+    while (lineLength_ && isspace((unsigned char)line_[lineLength_ - 1])) {
+        lineLength_--;
+    }
+    line_[lineLength_] = '\0';
+    if (lineLength_) sink_.command(line_);
+}
+
+void SerialIntake::poll(uint32_t nowMs) {
+    uint32_t quiet = nowMs - lastByteMs_;
+    if (mode_ == kLine && quiet >= kIdleMs) {
+        endLine();
+    } else if (mode_ == kJson && quiet >= kStallMs) {
+        mode_ = kIdle;
+        sink_.jsonEnd(false);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Splits the bytes arriving on the configuration serial port into commands
+// ("READ_CONFIG", "WRITE_WIFI{...}") and keyconfig uploads, without ever
+// blocking or holding an upload in RAM.
+//
+// A message whose first non-blank byte is '{' is an upload: it is passed on
+// in whatever pieces it arrived in until its braces balance (string and
+// escape aware), so a pretty-printed file with newlines is fine. Anything
+// else is a command, ended by a newline or by kIdleMs without data, which
+// keeps host tools that send a bare "READ_CONFIG" working. An upload that
+// stalls for kStallMs is abandoned.
+//
+// Pure logic on the caller's clock; feed() and poll() come from the loop.
+class SerialIntake {
+   public:
+    class Sink {
+       public:
+        virtual ~Sink() {}
+        // One command, trimmed, without its line ending.
+        virtual void command(const char *line) = 0;
+        virtual void jsonBegin() = 0;
+        virtual void jsonData(const uint8_t *data, size_t size) = 0;
+        // complete: the braces balanced; false when the upload stalled.
+        virtual void jsonEnd(bool complete) = 0;
+    };
+
+    static const uint16_t kIdleMs = 100;
+    static const uint16_t kStallMs = 2000;
+    // Longest command; longer lines are dropped whole.
+    static const size_t kLineSize = 512;
+
+    explicit SerialIntake(Sink &sink)
+        : sink_(sink),
+          mode_(kIdle),
+          lineLength_(0),
+          lineOverflow_(false),
+          depth_(0),
+          inString_(false),
+          escaped_(false),
+          lastByteMs_(0) {}
+
+    void feed(const uint8_t *data, size_t size, uint32_t nowMs);
+    // End a command or abandon an upload once the line has gone quiet.
+    void poll(uint32_t nowMs);
+
+   private:
+    enum Mode : uint8_t { kIdle, kLine, kJson };
+
+    // Consume upload bytes from data; returns how many belonged to it.
+    size_t feedJson(const uint8_t *data, size_t size);
+    void endLine();
+
+    Sink &sink_;
+    Mode mode_;
+    char line_[kLineSize];
+    size_t lineLength_;
+    bool lineOverflow_;
+    // Upload brace tracking
+    uint16_t depth_;
+    bool inString_;
+    bool escaped_;
+    uint32_t lastByteMs_;
+};
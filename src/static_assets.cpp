@@ -0,0 +1,64 @@
+#include "static_assets.h"
+
+#include <ArduinoJson.h>
+
+#include "json_file.h"
+
+namespace {
+struct TypeByExtension {
+    const char *extension;
+    const char *type;
+};
+
+const TypeByExtension kContentTypes[] = {
+    {".html", "text/html"},        {".htm", "text/html"},
+    {".css", "text/css"},          {".js", "text/javascript"},
+    {".json", "application/json"}, {".ico", "image/x-icon"},
+    {".png", "image/png"},         {".jpg", "image/jpeg"},
+    {".svg", "image/svg+xml"},     {".woff2", "font/woff2"},
+};
+}  // namespace
+
+/**
+ * Manifest format: {"<path>": {"etag": "<hash>", "gzip": bool,
+ * "immutable": bool}, ...}
+ *
+ */
+bool StaticAssets::load(FS &fs, const char *manifestPath) {
+    assets_.clear();
+    File file = fs.open(manifestPath, "r");
+    if (!file) return false;
+
+    DeserializationError err =
+        JsonFile::parse(file, [this](JsonDocument &doc) {
+            JsonObjectConst manifest = doc.as<JsonObjectConst>();
+            assets_.reserve(manifest.size());
+            for (JsonPairConst entry : manifest) {
+                Asset asset;
+                asset.path = entry.key().c_str();
+                asset.etag = entry.value()["etag"] | "";
+                asset.gzip = entry.value()["gzip"] | false;
+                asset.immutable = entry.value()["immutable"] | false;
+                assets_.push_back(asset);
+            }
+        });
+    file.close();
+    return !err;
+}
+
+const StaticAssets::Asset *StaticAssets::find(const String &path) const {
+    for (const Asset &asset : assets_) {
+        if (asset.path == path) return &asset;
+    }
+    return nullptr;
+}
+
+const char *StaticAssets::contentType(const String &path) {
+    int dot = path.lastIndexOf('.');
+    if (dot < 0) return "text/plain";
+    const char *extension = path.c_str() + dot;
+    for (const TypeByExtension &entry : kContentTypes) {
+        if (strcasecmp(entry.extension, extension) == 0) return entry.type;
+    }
+    return "text/plain";
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <vector>
+
+// Web UI files prepared at build time by scripts/compress_assets.py: stored
+// gzip-compressed as "<path>.gz" and listed with a content hash in a
+// manifest, so the server can answer a browser's revalidation (If-None-Match)
+// without touching the file and send the rest precompressed. Files built
+// with a hash in their name (e.g. /js/app.af1b54e7.js) never change and are
+// marked immutable.
+class StaticAssets {
+   public:
+    struct Asset {
+        String path;  // request path, e.g. "/index.html"
+        String etag;  // content hash, unquoted
+        bool gzip;    // stored as path + ".gz"
+        bool immutable;
+    };
+
+    // Read the manifest written by the build script. Returns false (and
+    // serves nothing from the table) if it is missing or unreadable.
+    bool load(FS &fs, const char *manifestPath);
+
+    // Manifest entry for a request path, or nullptr.
+    const Asset *find(const String &path) const;
+    size_t size() const { return assets_.size(); }
+
+    // MIME type from the path's extension.
+    static const char *contentType(const String &path);
+
+   private:
+    std::vector<Asset> assets_;
+};
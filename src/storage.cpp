@@ -0,0 +1,180 @@
+#include "storage.h"
+
+#include <LittleFS.h>
+#include <SPIFFS.h>
+
+#include "atomic_file.h"
+#include "file_stream.h"
+
+namespace {
+template <typename Fs>
+class FsBackend : public Storage::Backend {
+   public:
+    FsBackend(Fs &fs, const char *name) : fs_(fs), name_(name) {}
+    const char *name() const override { return name_; }
+    bool mount(bool format) override { return fs_.begin(format); }
+    void unmount() override { fs_.end(); }
+    size_t totalBytes() override { return fs_.totalBytes(); }
+    size_t usedBytes() override { return fs_.usedBytes(); }
+    fs::FS &fs() override { return fs_; }
+
+   private:
+    Fs &fs_;
+    const char *name_;
+};
+
+FsBackend<decltype(LittleFS)> gLittleFs(LittleFS, "LittleFS");
+FsBackend<decltype(SPIFFS)> gSpiffs(SPIFFS, "SPIFFS");
+Storage::Backend *gActive = &gLittleFs;
+
+// Files carried over from SPIFFS: the live config, its edit log and the
+// defaults a config reset copies from
+const char *const kMigrated[] = {
+    "/keyconfig.json", "/keyconfig.log",          "/config.json",
+    "/system.json",    "/keyconfig.default.json", "/config.default.json"};
+const size_t kMigratedCount = sizeof(kMigrated) / sizeof(kMigrated[0]);
+
+// Written and removed by bench()
+const char *const kScratchPath = "/bench.tmp";
+
+// A migrated file while the partition is reformatted
+struct Held {
+    uint8_t *data;  // nullptr: not on the old partition
+    size_t size;
+};
+
+void release(Held *held) {
+    for (size_t i = 0; i < kMigratedCount; i++) free(held[i].data);
+}
+
+// Read the migrated files into RAM. False if one of them cannot be.
+bool hold(fs::FS &from, Held *held) {
+    for (size_t i = 0; i < kMigratedCount; i++) {
+        if (!from.exists(kMigrated[i])) continue;
+        File file = from.open(kMigrated[i], FILE_READ);
+        if (!file) return false;
+        held[i].size = file.size();
+        held[i].data = (uint8_t *)malloc(held[i].size + 1);
+        bool read = held[i].data &&
+                    file.read(held[i].data, held[i].size) == held[i].size;
+        file.close();
+        if (!read) return false;
+    }
+    return true;
+}
+
+/**
+ * LittleFS did not mount: either a blank partition or one still holding
+ * SPIFFS from an older firmware. In the second case the config files are
+ * kept in RAM while the partition is reformatted and written back. If they
+ * cannot all be read, nothing is formatted and SPIFFS stays in use.
+ *
+ * @return {bool} whether a filesystem is mounted
+ */
+bool migrate() {
+    Held held[kMigratedCount] = {};
+    if (gSpiffs.mount(false)) {
+        if (!hold(gSpiffs.fs(), held)) {
+            release(held);
+            Serial.println("Storage: cannot read the SPIFFS config, "
+                           "staying on SPIFFS");
+            gActive = &gSpiffs;
+            return true;
+        }
+        gSpiffs.unmount();
+    }
+
+    if (!gLittleFs.mount(true)) {
+        release(held);
+        return false;
+    }
+    uint8_t moved = 0;
+    for (size_t i = 0; i < kMigratedCount; i++) {
+        if (!held[i].data) continue;
+        const Held &file = held[i];
+        bool written = AtomicFile::write(
+            gLittleFs.fs(), kMigrated[i], [&](Print &out) {
+                return out.write(file.data, file.size) == file.size;
+            });
+        if (written) moved++;
+    }
+    release(held);
+    if (moved) {
+        Serial.println("Storage: moved " + String(moved) +
+                       " config files from SPIFFS to LittleFS; flash the "
+                       "filesystem image again for the web UI");
+    }
+    return true;
+}
+}  // namespace
+
+namespace Storage {
+
+Backend &littleFs() { return gLittleFs; }
+Backend &spiffs() { return gSpiffs; }
+Backend &active() { return *gActive; }
+
+fs::FS &fs() {
+    static fs::FS mounted{fs::FSImplPtr()};
+    return mounted;
+}
+
+bool begin() {
+#ifdef STORAGE_SPIFFS
+    gActive = &gSpiffs;
+    bool mounted = gSpiffs.mount(true);
+#else
+    bool mounted = gLittleFs.mount(false) || migrate();
+#endif
+    // Point the shared fs::FS at the mounted implementation
+    if (mounted) fs() = gActive->fs();
+    return mounted;
+}
+
+bool bench(const char *path, uint8_t rounds, Timing &timing) {
+    if (rounds == 0) return false;
+    fs::FS &files = fs();
+    uint8_t chunk[FileStream::kChunkSize];
+    uint32_t existsUs = 0, openUs = 0, readUs = 0, writeUs = 0;
+    size_t size = 0;
+    for (uint8_t round = 0; round < rounds; round++) {
+        uint32_t start = micros();
+        files.exists(path);
+        existsUs += micros() - start;
+
+        start = micros();
+        File file = files.open(path, FILE_READ);
+        openUs += micros() - start;
+        if (!file) return false;
+
+        start = micros();
+        size = 0;
+        for (;;) {
+            size_t read = file.read(chunk, sizeof(chunk));
+            if (read == 0) break;
+            size += read;
+        }
+        file.close();
+        readUs += micros() - start;
+
+        start = micros();
+        File scratch = files.open(kScratchPath, FILE_WRITE);
+        for (size_t left = size; scratch && left;) {
+            size_t step = min(left, sizeof(chunk));
+            if (scratch.write(chunk, step) < step) break;
+            left -= step;
+        }
+        if (scratch) scratch.close();
+        writeUs += micros() - start;
+    }
+    files.remove(kScratchPath);
+
+    timing.existsUs = existsUs / rounds;
+    timing.openUs = openUs / rounds;
+    timing.readUs = readUs / rounds;
+    timing.writeUs = writeUs / rounds;
+    timing.bytes = size;
+    return true;
+}
+
+}  // namespace Storage
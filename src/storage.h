@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// The flash filesystem holding the config files and the web UI. Modules work
+// on the fs::FS that fs() returns; only mounting, sizes and the one-time move
+// off SPIFFS need to know which filesystem is underneath.
+//
+// LittleFS is the default: SPIFFS scans its flat object list on every open
+// and exists, and slows down as the partition fills. Building with
+// -D STORAGE_SPIFFS keeps SPIFFS (to compare the two with FS_BENCH).
+namespace Storage {
+
+// One filesystem implementation on the data partition.
+class Backend {
+   public:
+    virtual ~Backend() {}
+    virtual const char *name() const = 0;
+    // Mount, formatting a partition it cannot read if `format`.
+    virtual bool mount(bool format) = 0;
+    virtual void unmount() = 0;
+    virtual size_t totalBytes() = 0;
+    virtual size_t usedBytes() = 0;
+    virtual fs::FS &fs() = 0;
+};
+
+Backend &littleFs();
+Backend &spiffs();
+
+// Mount the configured backend. The first time LittleFS meets a partition
+// still holding SPIFFS, the config files are carried across; the web UI
+// files are not, so the filesystem image has to be flashed again.
+bool begin();
+// The backend begin() mounted (SPIFFS if it could not be migrated).
+Backend &active();
+// The mounted filesystem. Safe to keep a reference to from static
+// initialisation on; it is usable once begin() has succeeded.
+fs::FS &fs();
+
+// Average latency of the file operations on one file, in microseconds.
+struct Timing {
+    uint32_t existsUs;
+    uint32_t openUs;   // open for reading
+    uint32_t readUs;   // the whole file, and close
+    uint32_t writeUs;  // as many bytes to a scratch file, and close
+    size_t bytes;
+};
+// Time `rounds` of each operation on `path`. False if it cannot be read.
+bool bench(const char *path, uint8_t rounds, Timing &timing);
+
+}  // namespace Storage
@@ -12,20 +12,10 @@ void begin() {
     USB.begin();
 }
 
-void press(uint8_t keyStroke) { usbKeyboard.press(keyStroke); }
-
-void release(uint8_t keyStroke) { usbKeyboard.release(keyStroke); }
-
-void pressRaw(uint8_t keyStroke) { usbKeyboard.pressRaw(keyStroke); }
-
-void releaseRaw(uint8_t keyStroke) { usbKeyboard.releaseRaw(keyStroke); }
-
-void write(uint8_t keyStroke) { usbKeyboard.write(keyStroke); }
-
-void releaseAll() { usbKeyboard.releaseAll(); }
-
-void print(const String &text) { usbKeyboard.print(text); }
-
-void println(const String &text) { usbKeyboard.println(text); }
+void sendReport(const uint8_t *report) {
+    KeyReport keys;
+    memcpy(&keys, report, sizeof(keys));
+    usbKeyboard.sendReport(&keys);
+}
 
 }  // namespace UsbHid
@@ -9,12 +9,6 @@
 // them impossible to compile together.
 namespace UsbHid {
 void begin();
-void press(uint8_t keyStroke);
-void release(uint8_t keyStroke);
-void pressRaw(uint8_t keyStroke);
-void releaseRaw(uint8_t keyStroke);
-void write(uint8_t keyStroke);
-void releaseAll();
-void print(const String &text);
-void println(const String &text);
+// Send one 8-byte boot keyboard report (modifiers, reserved, 6 usages).
+void sendReport(const uint8_t *report);
 }  // namespace UsbHid
@@ -1,13 +1,23 @@
 #include "web_server.h"
 
 #include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
 #include <ESPmDNS.h>
 #include <ImprovWiFiLibrary.h>
-#include <SPIFFS.h>
-#include <WebServer.h>
 #include <WiFi.h>
 
+#include <algorithm>
+#include <memory>
+
+#include "atomic_file.h"
+#include "config_store.h"
+#include "config_upload.h"
 #include "display_state.h"
+#include "file_stream.h"
+#include "input_bus.h"
+#include "keyconfig_file.h"
+#include "static_assets.h"
+#include "storage.h"
 
 #ifndef FIRMWARE_VERSION
 #define FIRMWARE_VERSION "dev"
@@ -17,16 +27,61 @@
 static const int kJsonDocSize = 16384;
 
 // Defined in main.cpp.
-extern void switchLayout(int layoutIndex);
 extern int findLayoutIndex(String layoutName);
 extern volatile bool keymapsNeedsUpdate;
+extern volatile bool keyconfigNeedsCompact;
+extern volatile uint32_t keyconfigCompactions;
+extern volatile bool keyconfigCompactFailed;
+extern ConfigStore configStore;
+extern InputBus inputBus;
 extern volatile bool isSoftAPEnabled;
 extern String humanReadableSize(const size_t bytes);
-
-WebServer server(80);
+extern int patchKeyconfig(JsonVariantConst changes, char *error,
+                          size_t errorSize);
+extern KeyconfigFile keyconfigFile;
+
+// Event driven: requests are parsed and answered on the AsyncTCP task as
+// their data arrives, several connections at a time, with nothing polling.
+// Handlers must not block.
+AsyncWebServer server(80);
 ImprovWiFi improvSerial(&Serial);
 TaskHandle_t TaskNetwork;
 
+// Web side of config uploads; the serial side has its own temporary file.
+static ConfigUpload configUpload(Storage::fs(), "/keyconfig.web.tmp",
+                                 keyconfigFile);
+// Request whose body configUpload is receiving (one upload at a time)
+static AsyncWebServerRequest *configUploader = nullptr;
+
+// Once received, the upload is validated and installed by loop()
+// (finishConfigUpload()); the PUT is answered when that is done.
+enum UploadStep : uint8_t {
+    kUploadIdle,
+    kUploadQueued,     // waiting for loop()
+    kUploadDone,       // result in configUploadOk, response not sent yet
+    kUploadAbandoned,  // client left while queued; loop() cleans up
+};
+static uint8_t configUploadStep = kUploadIdle;
+static bool configUploadOk = false;
+// Request waiting for the result
+static AsyncWebServerRequest *configFinisher = nullptr;
+
+static uint8_t uploadStep() {
+    return __atomic_load_n(&configUploadStep, __ATOMIC_ACQUIRE);
+}
+
+static bool moveUploadStep(uint8_t from, uint8_t to) {
+    return __atomic_compare_exchange_n(&configUploadStep, &from, to, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Build-time web UI assets (scripts/compress_assets.py)
+static StaticAssets staticAssets;
+static const char kImmutableCache[] = "public, max-age=31536000, immutable";
+
+// Largest body gathered whole for the small JSON endpoints
+static const size_t kMaxSmallBody = 4096;
+
 static void onImprovWiFiErrorCb(ImprovTypes::Error err) {
     Serial.println("Error: " + String(err));
 }
@@ -38,14 +93,13 @@ static void onImprovWiFiConnectedCb(const char *ssid, const char *password) {
     doc["ssid"] = ssid;
     doc["password"] = password;
 
-    File configFile = SPIFFS.open("/config.json", "w");
-    if (!configFile) {
-        Serial.println("Failed to open config file for writing");
-    }
-    if (serializeJson(doc, configFile) == 0) {
+    bool written =
+        AtomicFile::write(Storage::fs(), "/config.json", [&](Print &out) {
+            return serializeJson(doc, out) > 0;
+        });
+    if (!written) {
         Serial.println("Failed to write to config file");
     }
-    configFile.close();
 }
 
 void setupImprov() {
@@ -57,67 +111,284 @@ void setupImprov() {
 }
 
 /**
- * Network related tasks
+ * Improv provisioning over serial (HTTP needs no polling)
  *
  */
 static void networkTask(void *pvParameters) {
     while (true) {
-        server.handleClient();
         improvSerial.handleSerial();
         vTaskDelay(50 / portTICK_PERIOD_MS);
     }
 }
 
-static void handleRoot();
-static void handleNotFound();
-static void sendCrossOriginHeader() { server.send(204); }
-
-static String getContentType(String filename) {
-    if (filename.endsWith(".htm"))
-        return "text/html";
-    else if (filename.endsWith(".html"))
-        return "text/html";
-    else if (filename.endsWith(".css"))
-        return "text/css";
-    else if (filename.endsWith(".js"))
-        return "text/javascript";
-    else if (filename.endsWith(".jpg"))
-        return "image/jpeg";
-    else if (filename.endsWith(".ico"))
-        return "image/x-icon";
-    return "text/plain";
+void finishConfigUpload() {
+    uint8_t step = uploadStep();
+    if (step != kUploadQueued && step != kUploadAbandoned) return;
+    configUploadOk = configUpload.finish();
+    if (configUploadOk) {
+        keymapsNeedsUpdate = true;
+    } else {
+        Serial.println((String) "Config upload rejected: " +
+                       configUpload.error());
+    }
+    if (!moveUploadStep(kUploadQueued, kUploadDone)) {
+        // Nobody left to tell
+        moveUploadStep(kUploadAbandoned, kUploadIdle);
+    }
+}
+
+static void sendMessage(AsyncWebServerRequest *request, int code,
+                        const char *message) {
+    StaticJsonDocument<192> res;
+    String buffer;
+    res["message"] = message;
+    serializeJson(res, buffer);
+    request->send(code, "application/json", buffer);
 }
 
-static bool handleFileRead(String path) {
-    Serial.println("handleFileRead: " + path);
-    String contentType = getContentType(path);
-    if (SPIFFS.exists(path)) {
-        File file = SPIFFS.open(path, "r");
-        size_t sent = server.streamFile(file, contentType);
-        file.close();
-        return true;
+static void sendJson(AsyncWebServerRequest *request, int code,
+                     const JsonDocument &res) {
+    String buffer;
+    serializeJson(res, buffer);
+    request->send(code, "application/json", buffer);
+}
+
+/**
+ * Gather a small request body into request->_tempObject (freed with the
+ * request), NUL terminated, for handlers that parse it whole. Larger ones
+ * are not kept; handlers turn them away with rejectLargeBody()
+ *
+ */
+static void collectBody(AsyncWebServerRequest *request, uint8_t *data,
+                        size_t len, size_t index, size_t total) {
+    if (index == 0 && total <= kMaxSmallBody) {
+        request->_tempObject = calloc(total + 1, 1);
+    }
+    if (!request->_tempObject || index + len > total) return;
+    memcpy(static_cast<char *>(request->_tempObject) + index, data, len);
+}
+
+static const char *bodyOf(AsyncWebServerRequest *request) {
+    return request->_tempObject
+               ? static_cast<const char *>(request->_tempObject)
+               : "";
+}
+
+/**
+ * Answer 413 for a body collectBody() would not keep, so the handler does
+ * not go on to parse an empty one
+ *
+ * @return {bool} whether the request was answered
+ */
+static bool rejectLargeBody(AsyncWebServerRequest *request) {
+    if (request->contentLength() <= kMaxSmallBody) return false;
+    sendMessage(request, 413, "request body too large");
+    return true;
+}
+
+/**
+ * PUT /api/config body: written to configUpload piece by piece as it
+ * arrives. A second upload while one is running is turned away.
+ *
+ */
+static void onConfigBody(AsyncWebServerRequest *request, uint8_t *data,
+                         size_t len, size_t index, size_t total) {
+    if (index == 0) {
+        if (configUploader || uploadStep() != kUploadIdle) return;
+        configUploader = request;
+        request->onDisconnect([request]() {
+            if (configUploader == request) {
+                configUpload.abort();
+                configUploader = nullptr;
+            } else if (configFinisher == request) {
+                configFinisher = nullptr;
+                if (!moveUploadStep(kUploadQueued, kUploadAbandoned)) {
+                    moveUploadStep(kUploadDone, kUploadIdle);
+                }
+            }
+        });
+        configUpload.begin();
     }
-    Serial.println("\tFile Not Found");
-    return false;
+    if (configUploader == request) configUpload.write(data, len);
 }
 
-static void handleNotFound() {
-    if (!handleFileRead(server.uri())) {
-        server.send(404, "text/plain", "Not found");
+static const char kConfigHead[] = "{\"message\":\"success\",\"config\":";
+
+// Body of GET /api/config: the stored file wrapped in the usual
+// {"message":"success","config":...} envelope, produced piece by piece as
+// the connection has room for it
+
+class ConfigResponseBody {
+   public:
+    static const size_t kHeadSize = sizeof(kConfigHead) - 1;
+
+    explicit ConfigResponseBody(File file) : file_(file) {}
+    size_t size() const { return kHeadSize + file_.size() + 1; }
+
+    size_t fill(uint8_t *buffer, size_t maxLen, size_t index) {
+        size_t fileEnd = kHeadSize + file_.size();
+        size_t written = 0;
+        while (written < maxLen) {
+            size_t at = index + written;
+            size_t room = maxLen - written;
+            size_t n;
+            if (at < kHeadSize) {
+                n = std::min(kHeadSize - at, room);
+                memcpy(buffer + written, kConfigHead + at, n);
+            } else if (at < fileEnd) {
+                n = FileStream::fill(file_, buffer + written,
+                                     std::min(fileEnd - at, room));
+                if (n == 0) break;
+            } else if (at == fileEnd) {
+                buffer[written] = '}';
+                n = 1;
+            } else {
+                break;
+            }
+            written += n;
+        }
+        return written;
+    }
+
+   private:
+    File file_;
+};
+
+static const char kCompactFailed[] =
+    "{\"message\":\"failed to save key edits\",\"config\":null}";
+
+// Body of GET /api/config for keyconfig while key edits are only in the
+// log. Folding them into the file is a full rewrite, too slow for the
+// server's task, so the loop does it and this body is held back until it
+// has, then streams the file as ConfigResponseBody does.
+class CompactedConfigBody {
+   public:
+    CompactedConfigBody() : seen_(compactions()), failed_(false) {
+        keyconfigNeedsCompact = true;
+    }
+
+    size_t fill(uint8_t *buffer, size_t maxLen, size_t index) {
+        if (!body_ && !failed_) {
+            uint32_t done = compactions();
+            if (done == seen_) return RESPONSE_TRY_AGAIN;
+            seen_ = done;
+            if (keyconfigFile.logBytes() > 0 && !keyconfigCompactFailed) {
+                // Edited again since that compaction began
+                keyconfigNeedsCompact = true;
+                return RESPONSE_TRY_AGAIN;
+            }
+            File file;
+            if (!keyconfigFile.logBytes()) {
+                file = Storage::fs().open("/keyconfig.json");
+            }
+            if (file && file.size() > 0) {
+                body_.reset(new ConfigResponseBody(file));
+            } else {
+                failed_ = true;
+            }
+        }
+        if (body_) return body_->fill(buffer, maxLen, index);
+
+        size_t size = sizeof(kCompactFailed) - 1;
+        if (index >= size) return 0;
+        size_t n = std::min(size - index, maxLen);
+        memcpy(buffer, kCompactFailed + index, n);
+        return n;
+    }
+
+   private:
+    static uint32_t compactions() {
+        return __atomic_load_n(&keyconfigCompactions, __ATOMIC_ACQUIRE);
     }
+
+    uint32_t seen_;
+    bool failed_;
+    std::unique_ptr<ConfigResponseBody> body_;
+};
+
+/**
+ * Whether the request's Accept-Encoding allows gzip: listed, or covered by
+ * "*", without q=0. A request with no Accept-Encoding at all gets no:
+ * browsers always send it, scripts that leave it out expect the plain file.
+ *
+ */
+static bool acceptsGzip(AsyncWebServerRequest *request) {
+    if (!request->hasHeader("Accept-Encoding")) return false;
+    String header = request->header("Accept-Encoding");
+    header.toLowerCase();
+    bool wildcard = false;
+    int start = 0;
+    while (start < (int)header.length()) {
+        int end = header.indexOf(',', start);
+        if (end < 0) end = header.length();
+        String coding = header.substring(start, end);
+        start = end + 1;
+
+        int params = coding.indexOf(';');
+        String name = params < 0 ? coding : coding.substring(0, params);
+        name.trim();
+        if (name != "gzip" && name != "*") continue;
+        int q = params < 0 ? -1 : coding.indexOf("q=", params);
+        bool accepted = q < 0 || coding.substring(q + 2).toFloat() > 0;
+        if (name == "gzip") return accepted;
+        wildcard = accepted;
+    }
+    return wildcard;
 }
 
-static void handleRoot() {
-    String pathWithExtension = "/index.html";
-    if (SPIFFS.exists(pathWithExtension)) {
-        Serial.println(F("index found on SPIFFS"));
-        File file = SPIFFS.open(pathWithExtension, "r");
-        size_t sent = server.streamFile(file, "text/html");
-        file.close();
+/**
+ * Web UI files. Manifest assets are answered with 304 when the browser's
+ * ETag matches (no filesystem access at all), otherwise from their stored .gz
+ * (the response adds Content-Encoding for a .gz file) with ETag and cache
+ * policy. Only the .gz is stored, so a client that does not accept gzip gets
+ * 406. Other stored files are sent as they are.
+ *
+ */
+static void handleStatic(AsyncWebServerRequest *request) {
+    if (request->method() != HTTP_GET) {
+        request->send(404, "text/plain", "Not found");
+        return;
+    }
+    String path = request->url();
+    if (path.endsWith("/")) path += "index.html";
+    const char *contentType = StaticAssets::contentType(path);
+
+    const StaticAssets::Asset *asset = staticAssets.find(path);
+    if (!asset) {
+        if (!Storage::fs().exists(path)) {
+            request->send(404, "text/plain", "Not found");
+            return;
+        }
+        request->send(Storage::fs(), path, contentType);
+        return;
+    }
+
+    String etag = "\"" + asset->etag + "\"";
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") &&
+        request->header("If-None-Match").indexOf(etag) >= 0) {
+        response = request->beginResponse(304);
+    } else if (asset->gzip && !acceptsGzip(request)) {
+        request->send(406, "text/plain", "Needs Accept-Encoding: gzip");
+        return;
     } else {
-        Serial.println(F("index not found on SPIFFS"));
-        handleNotFound();
+        File file =
+            Storage::fs().open(asset->gzip ? path + ".gz" : path, "r");
+        if (!file) {
+            request->send(404, "text/plain", "Not found");
+            return;
+        }
+        response = request->beginResponse(file, path, contentType);
     }
+    response->addHeader("ETag", etag);
+    if (asset->gzip) response->addHeader("Vary", "Accept-Encoding");
+    response->addHeader("Cache-Control",
+                        asset->immutable ? kImmutableCache : "no-cache");
+    request->send(response);
+}
+
+static void sendCrossOriginHeader(AsyncWebServerRequest *request) {
+    request->send(204);
 }
 
 /**
@@ -125,8 +396,8 @@ static void handleRoot() {
  *
  */
 void initWebServer(const char *apSsid, const char *mdnsName) {
-    Serial.println("Loading \"config.json\" from SPIFFS...");
-    File file = SPIFFS.open("/config.json");
+    Serial.println("Loading \"config.json\" from storage...");
+    File file = Storage::fs().open("/config.json");
     if (!file) {
         Serial.println("Failed to open file for reading");
         return;
@@ -181,20 +452,20 @@ void initWebServer(const char *apSsid, const char *mdnsName) {
     Serial.println((String) "IP: " + WiFi.localIP().toString().c_str());
     Serial.println((String) "Soft AP IP: " +
                    WiFi.softAPIP().toString().c_str());
-    server.enableCORS();
+    DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
+    DefaultHeaders::Instance().addHeader("Access-Control-Allow-Methods", "*");
+    DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "*");
 
-    server.on("/", handleRoot);
-
-    server.on("/api/spiffs", HTTP_GET, []() {
+    // Storage listing; the path keeps its SPIFFS-era name for the web UI
+    server.on("/api/spiffs", HTTP_GET, [](AsyncWebServerRequest *request) {
         DynamicJsonDocument res(2048 + 128);
-        String buffer;
         DynamicJsonDocument doc(2048);
 
         // create an empty array
         JsonArray array = doc.to<JsonArray>();
         StaticJsonDocument<256> item;
 
-        File root = SPIFFS.open("/");
+        File root = Storage::fs().open("/");
         File foundfile = root.openNextFile();
         while (foundfile) {
             item["name"] = String(foundfile.name());
@@ -203,27 +474,19 @@ void initWebServer(const char *apSsid, const char *mdnsName) {
             foundfile = root.openNextFile();
         }
 
+        Storage::Backend &storage = Storage::active();
         res["message"] = "success";
-        res["total"] = humanReadableSize(SPIFFS.totalBytes());
-        res["used"] = humanReadableSize(SPIFFS.usedBytes());
+        res["backend"] = storage.name();
+        res["total"] = humanReadableSize(storage.totalBytes());
+        res["used"] = humanReadableSize(storage.usedBytes());
         res["free"] =
-            humanReadableSize((SPIFFS.totalBytes() - SPIFFS.usedBytes()));
+            humanReadableSize((storage.totalBytes() - storage.usedBytes()));
         res["files"] = array;
-        serializeJson(res, buffer);
-        server.send(200, "application/json", buffer);
-        return;
+        sendJson(request, 200, res);
     });
 
-    server.on("/api/config", HTTP_GET, []() {
-        if (server.hasArg("plain") == false) {
-            // Handle error here
-            Serial.println("Arg Error");
-        }
-        String type = server.arg("type");
-        DynamicJsonDocument res(kJsonDocSize + 128);
-        String buffer;
-        DynamicJsonDocument doc(kJsonDocSize);
-
+    server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request) {
+        String type = request->arg("type");
         String filename = "";
 
         if (type == "keyconfig" || type == "macros") {
@@ -232,142 +495,169 @@ void initWebServer(const char *apSsid, const char *mdnsName) {
             filename = "keyconfig";
         }
 
-        Serial.println("Loading \"" + filename + ".json\" from SPIFFS...");
-        File file = SPIFFS.open("/" + filename + ".json");
-        if (!file) {
-            Serial.println("Failed to open file for reading");
+        if (filename == "keyconfig" && keyconfigFile.logBytes() > 0) {
+            // Logged key edits are not in the file yet: answer once the loop
+            // has saved them (the body is polled about twice a second)
+            std::shared_ptr<CompactedConfigBody> body(
+                new CompactedConfigBody());
+            request->send(request->beginChunkedResponse(
+                "application/json",
+                [body](uint8_t *buffer, size_t maxLen, size_t index) {
+                    return body->fill(buffer, maxLen, index);
+                }));
             return;
         }
-
-        Serial.println("Reading key configuration from \"" + filename +
-                       ".json\"...");
-        String keyConfigJSON = "";
-        while (file.available()) {
-            keyConfigJSON += (char)file.read();
-        }
-        file.close();
-
-        deserializeJson(doc, keyConfigJSON);
-        res["message"] = "success";
-        res["config"] = doc;
-        serializeJson(res, buffer);
-        server.send(200, "application/json", buffer);
-        return;
-    });
-
-    server.on("/api/config", HTTP_PUT, []() {
-        if (server.hasArg("plain") == false) {
-            // Handle error here
-            Serial.println("Arg Error");
-        }
-        String type = server.arg("type");
-        String body = server.arg("plain");
-        DynamicJsonDocument res(512);
-        String buffer;
-        // Handle incoming JSON data
-        DynamicJsonDocument doc(kJsonDocSize);
-        deserializeJson(doc, body);
-
-        // Return error if config is overflowed
-        if (doc.overflowed()) {
-            res["message"] = "overflowed";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
-            return;
-        }
-
-        String filename = "";
-
-        if (type == "keyconfig" || type == "macros") {
-            filename = type;
-        }
-
-        File config = SPIFFS.open("/" + filename + ".json", "w");
-        if (!config) {
-            res["message"] = "failed to create file";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
+        Serial.println("Loading \"" + filename + ".json\" from storage...");
+        File file = Storage::fs().open("/" + filename + ".json");
+        if (!file) {
+            Serial.println("Failed to open file for reading");
+            sendMessage(request, 404, "failed to open file");
             return;
         }
-
-        // Serialize JSON to file
-        if (!serializeJson(doc, config)) {
-            res["message"] = "failed to write file";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
+        if (file.size() == 0) {
+            request->send(200, "application/json",
+                          "{\"message\":\"success\",\"config\":null}");
             return;
         }
 
-        // Writing JSON to file
-        else {
-            res["message"] = "success";
-            serializeJson(res, buffer);
-            server.send(200, "application/json", buffer);
-            keymapsNeedsUpdate = true;
-            return;
-        }
+        // Stream the file into the "config" member of the usual envelope
+        // instead of parsing it and serializing it back
+        std::shared_ptr<ConfigResponseBody> body(new ConfigResponseBody(file));
+        request->send(request->beginResponse(
+            "application/json", body->size(),
+            [body](uint8_t *buffer, size_t maxLen, size_t index) {
+                return body->fill(buffer, maxLen, index);
+            }));
     });
 
-    server.on("/api/layout", HTTP_POST, []() {
-        if (server.hasArg("plain") == false) {
-            // Handle error here
-            Serial.println("Arg Error");
-        }
-        String type = server.arg("type");
-        String body = server.arg("plain");
-        DynamicJsonDocument res(4096);
-        String buffer;
-        // Handle incoming JSON data
-        DynamicJsonDocument doc(4096);
-        deserializeJson(doc, body);
-
-        // Return error if config is overflowed
-        if (doc.overflowed()) {
-            res["message"] = "overflowed";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
-            return;
-        }
-
-        // Change current layout by layout title
-        int index = findLayoutIndex(doc["layout"].as<String>());
-        if (index == -1) {
-            res["message"] = "layout not found";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
-            return;
-        }
-        switchLayout(index);
-
-        res["message"] = doc["layout"].as<String>();
-        serializeJson(res, buffer);
-        server.send(200, "application/json", buffer);
-        keymapsNeedsUpdate = true;
-        return;
-    });
+    // The body is not gathered into memory: onConfigBody passes it to
+    // ConfigUpload as it arrives, which writes it to a temporary file that
+    // is validated before it replaces keyconfig.json. Only keyconfig is
+    // accepted (macros.json is not read by the firmware; macros live in
+    // keyconfig).
+    server.on(
+        "/api/config", HTTP_PUT,
+        [](AsyncWebServerRequest *request) {
+            if (configUploader != request) {
+                bool busy = configUploader || uploadStep() != kUploadIdle;
+                sendMessage(request, busy ? 409 : 400,
+                            busy ? "another upload is in progress"
+                                 : "empty config");
+                return;
+            }
+            configUploader = nullptr;
+
+            String type = request->arg("type");
+            if (type.length() && type != "keyconfig") {
+                configUpload.abort();
+                sendMessage(request, 400, "unsupported config type");
+                return;
+            }
+
+            // Parsing and installing the file takes far too long for this
+            // task. The response goes out now and its body is held back
+            // (polled about twice a second) until loop() has the result, so
+            // the status is 200 either way and "message" tells them apart,
+            // as the web UI already reads it.
+            configFinisher = request;
+            __atomic_store_n(&configUploadStep, kUploadQueued,
+                             __ATOMIC_RELEASE);
+            request->send(request->beginChunkedResponse(
+                "application/json",
+                [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                    if (uploadStep() == kUploadQueued) {
+                        return RESPONSE_TRY_AGAIN;
+                    }
+                    if (index > 0) return 0;
+                    StaticJsonDocument<192> res;
+                    res["message"] =
+                        configUploadOk ? "success" : configUpload.error();
+                    size_t size = serializeJson(res, (char *)buffer, maxLen);
+                    configFinisher = nullptr;
+                    moveUploadStep(kUploadDone, kUploadIdle);
+                    return size;
+                }));
+        },
+        NULL, onConfigBody);
+
+    // Single-key edits: {"layer", "row", "col" | "ext", "keyStroke", "info"},
+    // one object or an array. Applied to the compiled keymap in place and
+    // appended to the change log; nothing is reparsed or rewritten.
+    server.on(
+        "/api/config", HTTP_PATCH,
+        [](AsyncWebServerRequest *request) {
+            if (rejectLargeBody(request)) return;
+            DynamicJsonDocument doc(4096);
+            DeserializationError err = deserializeJson(doc, bodyOf(request));
+            if (err) {
+                sendMessage(request, 400, "invalid JSON");
+                return;
+            }
+            char error[96];
+            int status =
+                patchKeyconfig(doc.as<JsonVariantConst>(), error,
+                               sizeof(error));
+            sendMessage(request, status, status == 200 ? "success" : error);
+        },
+        NULL, collectBody);
+
+    server.on(
+        "/api/layout", HTTP_POST,
+        [](AsyncWebServerRequest *request) {
+            if (rejectLargeBody(request)) return;
+            DynamicJsonDocument res(4096);
+            // Handle incoming JSON data
+            DynamicJsonDocument doc(4096);
+            deserializeJson(doc, bodyOf(request));
+
+            // Return error if config is overflowed
+            if (doc.overflowed()) {
+                sendMessage(request, 400, "overflowed");
+                return;
+            }
+
+            // Change current layout by layout title
+            int index;
+            {
+                ConfigStore::Reader reader(configStore);
+                if (!reader.ok()) {
+                    sendMessage(request, 503, "config is reloading, retry");
+                    return;
+                }
+                index = findLayoutIndex(doc["layout"].as<String>());
+            }
+            if (index == -1) {
+                sendMessage(request, 400, "layout not found");
+                return;
+            }
+            // The input task owns the active layer; a plain switch needs no
+            // reload
+            if (!inputBus.publish(kInputLayer, index, 0)) {
+                sendMessage(request, 503, "input queue full, retry");
+                return;
+            }
+
+            res["message"] = doc["layout"].as<String>();
+            sendJson(request, 200, res);
+        },
+        NULL, collectBody);
 
     server.on("/api/config", HTTP_OPTIONS, sendCrossOriginHeader);
 
-    server.on("/api/network", HTTP_GET, []() {
+    server.on("/api/network", HTTP_GET, [](AsyncWebServerRequest *request) {
         DynamicJsonDocument res(512 + 128);
-        String buffer;
         DynamicJsonDocument doc(512);
 
-        Serial.println("Loading \"config.json\" from SPIFFS...");
-        File file = SPIFFS.open("/config.json");
+        Serial.println("Loading \"config.json\" from storage...");
+        File file = Storage::fs().open("/config.json");
         if (!file) {
             Serial.println("Failed to open file for reading");
+            sendMessage(request, 404, "failed to open file");
             return;
         }
 
-        Serial.println("Reading WIFI configuration from \"config.json\"...");
-        String wifiConfigJSON = "";
-        while (file.available()) {
-            wifiConfigJSON += (char)file.read();
-        }
+        deserializeJson(doc, file);
         file.close();
-
-        deserializeJson(doc, wifiConfigJSON);
         doc["rssi"] = WiFi.RSSI();
         doc["mac"] = WiFi.macAddress();
         doc["ip"] = WiFi.localIP();
@@ -376,62 +666,44 @@ void initWebServer(const char *apSsid, const char *mdnsName) {
         doc["gatewayIP"] = WiFi.gatewayIP();
         res["message"] = "success";
         res["wifi"] = doc;
-        serializeJson(res, buffer);
-        server.send(200, "application/json", buffer);
-        return;
+        sendJson(request, 200, res);
     });
 
-    server.on("/api/network", HTTP_PUT, []() {
-        if (server.hasArg("plain") == false) {
-            // Handle error here
-            Serial.println("Arg Error");
-        }
-        String body = server.arg("plain");
-        DynamicJsonDocument res(512);
-        String buffer;
-        // Handle incoming JSON data
-        DynamicJsonDocument doc(256);
-        deserializeJson(doc, body);
-
-        // Return error if config is overflowed
-        if (doc.overflowed()) {
-            res["message"] = "overflowed";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
-            return;
-        }
-
-        const String filename = "config.json";
-
-        File config = SPIFFS.open("/" + filename, "w");
-        if (!config) {
-            res["message"] = "failed to create file";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
-            config.close();
-            return;
-        }
-
-        // Serialize JSON to file
-        if (!serializeJson(doc, config)) {
-            res["message"] = "failed to write file";
-            serializeJson(res, buffer);
-            server.send(400, "application/json", buffer);
-            return;
-        }
-
-        // Writing JSON to file
-        else {
-            res["message"] = "success";
-            serializeJson(res, buffer);
-            server.send(200, "application/json", buffer);
-            return;
-        }
-    });
+    server.on(
+        "/api/network", HTTP_PUT,
+        [](AsyncWebServerRequest *request) {
+            if (rejectLargeBody(request)) return;
+            // Handle incoming JSON data
+            DynamicJsonDocument doc(256);
+            deserializeJson(doc, bodyOf(request));
+
+            // Return error if config is overflowed
+            if (doc.overflowed()) {
+                sendMessage(request, 400, "overflowed");
+                return;
+            }
+
+            // Replaced atomically: a failed write keeps the old file
+            bool written =
+                AtomicFile::write(Storage::fs(), "/config.json",
+                                  [&](Print &out) {
+                    return serializeJson(doc, out) > 0;
+                });
+            if (!written) {
+                sendMessage(request, 400, "failed to write file");
+                return;
+            }
+            sendMessage(request, 200, "success");
+        },
+        NULL, collectBody);
 
     server.on("/api/network", HTTP_OPTIONS, sendCrossOriginHeader);
 
-    server.onNotFound(handleNotFound);
+    // Web UI: any other path is a stored file, "/" is index.html
+    if (!staticAssets.load(Storage::fs(), "/assets.json")) {
+        Serial.println("No asset manifest, serving web UI files as stored");
+    }
+    server.onNotFound(handleStatic);
 
     server.begin();
     Serial.println("HTTP server started");
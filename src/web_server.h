@@ -12,3 +12,7 @@ void setupImprov();
 // Connect WiFi (or fall back to soft AP), start mDNS + the HTTP server and the
 // network task. Call only in WiFi boot mode.
 void initWebServer(const char *apSsid, const char *mdnsName);
+
+// Validate and install a keyconfig received by PUT /api/config, whose
+// response waits for it. Too slow for the server's task; call from loop().
+void finishConfigUpload();
@@ -0,0 +1,41 @@
+#pragma once
+
+// Just enough of the Arduino core for the hardware-free modules to build on
+// the host ([env:native]). Not a simulation: nothing here touches time or
+// pins.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+class String : public std::string {
+   public:
+    String() {}
+    String(const char *text) : std::string(text ? text : "") {}
+    String(const std::string &text) : std::string(text) {}
+};
+
+// Log lines go to stdout
+class HostSerial {
+   public:
+    void print(const char *text) { fputs(text, stdout); }
+    void println(const char *text) { puts(text); }
+    void println(const String &text) { puts(text.c_str()); }
+};
+
+inline HostSerial &hostSerial() {
+    static HostSerial serial;
+    return serial;
+}
+#define Serial hostSerial()
@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-ins for the FreeRTOS types and critical sections the tested
+// modules use, built on the C++ standard library and GCC atomics.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFFu
+
+// portENTER_CRITICAL: a spin lock, like the ESP32's across cores
+struct portMUX_TYPE {
+    int locked;
+};
+#define portMUX_INITIALIZER_UNLOCKED \
+    { 0 }
+
+inline void portENTER_CRITICAL(portMUX_TYPE *mux) {
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *mux) {
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
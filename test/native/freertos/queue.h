@@ -0,0 +1,63 @@
+#pragma once
+
+// FreeRTOS queues for the host. Sends and receives never block: a test runs
+// the consumer side itself (e.g. MacroPlayer::playNext() with no wait), so
+// an empty or full queue fails at once whatever the wait.
+
+#include <string.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+
+typedef unsigned UBaseType_t;
+
+struct HostQueue {
+    HostQueue(UBaseType_t length, UBaseType_t itemSize)
+        : length(length), itemSize(itemSize) {}
+    std::mutex lock;
+    std::deque<std::vector<uint8_t> > items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+typedef HostQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return new HostQueue(length, itemSize);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                             TickType_t) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if (queue->items.size() >= queue->length) return pdFALSE;
+    const uint8_t *bytes = static_cast<const uint8_t *>(item);
+    queue->items.push_back(
+        std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if (queue->items.empty()) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->items.size();
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->length - queue->items.size();
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+    return pdTRUE;
+}
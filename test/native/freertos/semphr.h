@@ -0,0 +1,28 @@
+#pragma once
+
+// Recursive mutexes for the host, blocking across std::threads. Handles are
+// never deleted, as in the firmware.
+
+#include <mutex>
+
+#include "freertos/FreeRTOS.h"
+
+typedef std::recursive_mutex *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return new std::recursive_mutex();
+}
+
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t lock,
+                                          TickType_t wait) {
+    if (wait == portMAX_DELAY) {
+        lock->lock();
+        return pdTRUE;
+    }
+    return lock->try_lock() ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t lock) {
+    lock->unlock();
+    return pdTRUE;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// One host "task" on a virtual clock: waits that would time out advance the
+// tick count instead of sleeping, so timed code plays back instantly and
+// deterministically. A tick is one millisecond.
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+inline TickType_t &hostTickCount() {
+    static TickType_t ticks = 0;
+    return ticks;
+}
+
+inline bool &hostNotified() {
+    static bool notified = false;
+    return notified;
+}
+
+inline TickType_t xTaskGetTickCount() { return hostTickCount(); }
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return &hostNotified(); }
+
+inline void vTaskDelay(TickType_t ticks) { hostTickCount() += ticks; }
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) {
+    hostNotified() = true;
+    return pdTRUE;
+}
+
+// A pending notification returns at once; otherwise the full wait passes.
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    if (hostNotified()) {
+        if (clear) hostNotified() = false;
+        return 1;
+    }
+    if (wait != portMAX_DELAY) hostTickCount() += wait;
+    return 0;
+}
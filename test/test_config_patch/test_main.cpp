@@ -0,0 +1,218 @@
+#include <ArduinoJson.h>
+#include <string.h>
+#include <unity.h>
+
+#include <string>
+
+#include "config_patch.h"
+#include "config_schema.h"
+#include "keymap.h"
+
+namespace {
+char gError[96];
+
+// Parse `text` as one edit for a config of `layers` layers and `macros`
+// macros
+bool parse(ConfigPatch &patch, const char *text, size_t layers = 2,
+           size_t macros = 1) {
+    StaticJsonDocument<256> doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, text));
+    gError[0] = '\0';
+    return patch.fromJson(doc.as<JsonVariantConst>(), layers, macros, gError,
+                          sizeof(gError));
+}
+
+void assertRejected(const char *text, const char *message) {
+    ConfigPatch patch;
+    TEST_ASSERT_FALSE(parse(patch, text));
+    TEST_ASSERT_EQUAL_STRING(message, gError);
+}
+
+// keyConfig JSON for `layers` layers of zero key codes and null labels,
+// each with an extension board. ConfigSchema accepts it as it is.
+std::string emptyConfig(size_t layers) {
+    std::string row = "[0,0,0,0,0,0,0]";
+    std::string nulls = "[null,null,null,null,null,null,null]";
+    std::string keymap = "[" + row, keyInfo = "[" + nulls;
+    for (int r = 1; r < ROWS; r++) {
+        keymap += "," + row;
+        keyInfo += "," + nulls;
+    }
+    keymap += "]";
+    keyInfo += "]";
+    std::string layer =
+        "{\"keymap\":" + keymap + ",\"keyInfo\":" + keyInfo + "}";
+    std::string ext =
+        "{\"keymap\":[0,0,0],\"keyInfo\":[null,null,null],"
+        "\"rotaryMap\":[0,0,0],\"rotaryInfo\":[null,null,null]}";
+    std::string config = "{\"keyConfig\":[" + layer, exts = ext;
+    for (size_t i = 1; i < layers; i++) {
+        config += "," + layer;
+        exts += "," + ext;
+    }
+    return config + "],\"rotaryExtension\":[" + exts + "]}";
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_a_matrix_edit_round_trips() {
+    ConfigPatch patch;
+    const char *text =
+        "{\"layer\":1,\"row\":4,\"col\":6,\"keyStroke\":97,\"info\":\"a\"}";
+    TEST_ASSERT_TRUE(parse(patch, text));
+    TEST_ASSERT_EQUAL(ConfigPatch::kMatrixKey, patch.target);
+    TEST_ASSERT_EQUAL(1, patch.layer);
+    TEST_ASSERT_EQUAL(4, patch.row);
+    TEST_ASSERT_EQUAL(6, patch.col);
+    TEST_ASSERT_EQUAL(97, patch.keyStroke);
+    TEST_ASSERT_TRUE(patch.hasInfo);
+    TEST_ASSERT_EQUAL_STRING("a", patch.info);
+
+    StaticJsonDocument<256> out;
+    patch.toJson(out.to<JsonObject>());
+    char json[128];
+    serializeJson(out, json);
+    TEST_ASSERT_EQUAL_STRING(text, json);
+}
+
+void test_an_ext_edit_with_a_null_label() {
+    ConfigPatch patch;
+    const char *text = "{\"layer\":0,\"ext\":2,\"keyStroke\":0,\"info\":null}";
+    TEST_ASSERT_TRUE(parse(patch, text));
+    TEST_ASSERT_EQUAL(ConfigPatch::kExtKey, patch.target);
+    TEST_ASSERT_EQUAL(2, patch.col);
+    TEST_ASSERT_FALSE(patch.hasInfo);
+
+    StaticJsonDocument<256> out;
+    patch.toJson(out.to<JsonObject>());
+    char json[128];
+    serializeJson(out, json);
+    TEST_ASSERT_EQUAL_STRING(text, json);
+}
+
+void test_out_of_range_targets_are_rejected() {
+    assertRejected("{\"layer\":2,\"row\":0,\"col\":0,\"keyStroke\":1}",
+                   "layer out of range");
+    assertRejected("{\"layer\":-1,\"row\":0,\"col\":0,\"keyStroke\":1}",
+                   "layer out of range");
+    assertRejected("{\"layer\":0,\"row\":5,\"col\":0,\"keyStroke\":1}",
+                   "row/col out of range");
+    assertRejected("{\"layer\":0,\"row\":0,\"col\":7,\"keyStroke\":1}",
+                   "row/col out of range");
+    assertRejected("{\"layer\":0,\"row\":0,\"keyStroke\":1}",
+                   "row/col out of range");
+    assertRejected("{\"layer\":0,\"ext\":3,\"keyStroke\":1}",
+                   "ext out of range");
+    assertRejected("{\"layer\":\"0\",\"row\":0,\"col\":0,\"keyStroke\":1}",
+                   "layer out of range");
+}
+
+void test_bindings_are_checked_against_the_config() {
+    const std::string key = "{\"layer\":0,\"row\":0,\"col\":0,";
+    const char *const bad[] = {
+        "\"keyStroke\":256,\"info\":null}",
+        "\"keyStroke\":1,\"info\":\"MACRO_1\"}",
+        "\"keyStroke\":1,\"info\":\"MO_2\"}",
+        "\"keyStroke\":1,\"info\":\"MT_0\"}",
+        "\"keyStroke\":1,\"info\":7}",
+    };
+    for (const char *binding : bad) {
+        ConfigPatch patch;
+        TEST_ASSERT_FALSE(parse(patch, (key + binding).c_str()));
+        TEST_ASSERT_NOT_NULL(strstr(gError, "keyStroke must be 0-255"));
+    }
+    ConfigPatch patch;
+    TEST_ASSERT_TRUE(
+        parse(patch, (key + "\"keyStroke\":1,\"info\":\"MO_1\"}").c_str()));
+}
+
+void test_a_long_label_is_rejected() {
+    std::string text = "{\"layer\":0,\"row\":0,\"col\":0,\"keyStroke\":1,";
+    text += "\"info\":\"" + std::string(ConfigPatch::kInfoSize, 'x') + "\"}";
+    assertRejected(text.c_str(), "info too long");
+}
+
+void test_fits_follows_a_shrinking_config() {
+    ConfigPatch patch;
+    TEST_ASSERT_TRUE(parse(
+        patch,
+        "{\"layer\":0,\"row\":0,\"col\":0,\"keyStroke\":1,\"info\":\"MO_1\"}"));
+    TEST_ASSERT_TRUE(patch.fits(2, 0));
+    // Layer 1 is gone
+    TEST_ASSERT_FALSE(patch.fits(1, 0));
+    TEST_ASSERT_FALSE(patch.fits(0, 0));
+}
+
+void test_apply_writes_the_key_and_repeats_harmlessly() {
+    DynamicJsonDocument config(8192);
+    TEST_ASSERT_FALSE(deserializeJson(config, emptyConfig(2)));
+    ConfigPatch key, ext;
+    TEST_ASSERT_TRUE(parse(
+        key,
+        "{\"layer\":1,\"row\":2,\"col\":3,\"keyStroke\":98,\"info\":\"b\"}"));
+    TEST_ASSERT_TRUE(
+        parse(ext, "{\"layer\":0,\"ext\":1,\"keyStroke\":99,\"info\":\"c\"}"));
+
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_TRUE(key.applyTo(config.as<JsonVariant>()));
+        TEST_ASSERT_TRUE(ext.applyTo(config.as<JsonVariant>()));
+    }
+    JsonVariant layer = config["keyConfig"][1];
+    TEST_ASSERT_EQUAL(98, layer["keymap"][2][3].as<int>());
+    TEST_ASSERT_EQUAL_STRING("b", layer["keyInfo"][2][3].as<const char *>());
+    // Its neighbours and the same key on layer 0 are untouched
+    TEST_ASSERT_EQUAL(0, layer["keymap"][2][4].as<int>());
+    TEST_ASSERT_EQUAL(0, config["keyConfig"][0]["keymap"][2][3].as<int>());
+    JsonVariant board = config["rotaryExtension"][0];
+    TEST_ASSERT_EQUAL(99, board["keymap"][1].as<int>());
+    TEST_ASSERT_EQUAL_STRING("c", board["keyInfo"][1].as<const char *>());
+}
+
+void test_apply_to_a_missing_key_fails() {
+    DynamicJsonDocument config(8192);
+    TEST_ASSERT_FALSE(deserializeJson(config, emptyConfig(1)));
+    ConfigPatch patch;
+    TEST_ASSERT_TRUE(parse(
+        patch, "{\"layer\":1,\"row\":0,\"col\":0,\"keyStroke\":1}", 2, 0));
+    TEST_ASSERT_FALSE(patch.applyTo(config.as<JsonVariant>()));
+}
+
+void test_an_applied_edit_keeps_the_config_valid() {
+    DynamicJsonDocument config(8192);
+    TEST_ASSERT_FALSE(deserializeJson(config, emptyConfig(2)));
+    TEST_ASSERT_TRUE(ConfigSchema::validate(config.as<JsonVariantConst>(),
+                                            gError, sizeof(gError)));
+    ConfigPatch patch;
+    TEST_ASSERT_TRUE(parse(
+        patch,
+        "{\"layer\":0,\"row\":4,\"col\":6,\"keyStroke\":0,\"info\":\"MO_1\"}"));
+    TEST_ASSERT_TRUE(patch.applyTo(config.as<JsonVariant>()));
+    TEST_ASSERT_TRUE(ConfigSchema::validate(config.as<JsonVariantConst>(),
+                                            gError, sizeof(gError)));
+
+    // An edit replayed onto a config that lost the layer it points at
+    DynamicJsonDocument smaller(8192);
+    TEST_ASSERT_FALSE(deserializeJson(smaller, emptyConfig(1)));
+    TEST_ASSERT_FALSE(patch.fits(1, 0));
+    TEST_ASSERT_TRUE(patch.applyTo(smaller.as<JsonVariant>()));
+    TEST_ASSERT_FALSE(ConfigSchema::validate(smaller.as<JsonVariantConst>(),
+                                             gError, sizeof(gError)));
+    TEST_ASSERT_NOT_NULL(strstr(gError, "keyConfig[0]"));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_a_matrix_edit_round_trips);
+    RUN_TEST(test_an_ext_edit_with_a_null_label);
+    RUN_TEST(test_out_of_range_targets_are_rejected);
+    RUN_TEST(test_bindings_are_checked_against_the_config);
+    RUN_TEST(test_a_long_label_is_rejected);
+    RUN_TEST(test_fits_follows_a_shrinking_config);
+    RUN_TEST(test_apply_writes_the_key_and_repeats_harmlessly);
+    RUN_TEST(test_apply_to_a_missing_key_fails);
+    RUN_TEST(test_an_applied_edit_keeps_the_config_valid);
+    return UNITY_END();
+}
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "debounce.h"
+
+namespace {
+struct Edge {
+    uint32_t ms;
+    bool pressed;
+};
+
+// Bounce trace of one key sampled every millisecond, '1' = contact closed:
+// 4 ms of chatter on the press, held, 4 ms of chatter on the release at
+// 50 ms, then open.
+std::string bounceTrace() {
+    return "1010" + std::string(46, '1') + "0101" + std::string(46, '0');
+}
+
+// Replay `trace` on `key` from startMs, returning the reported edges with
+// their time relative to startMs.
+std::vector<Edge> replay(Debouncer &debouncer, const std::string &trace,
+                         uint32_t startMs, uint8_t key = 0) {
+    std::vector<Edge> edges;
+    Debouncer::State bit = (Debouncer::State)1 << key;
+    for (size_t i = 0; i < trace.size(); i++) {
+        Debouncer::State raw = trace[i] == '1' ? bit : 0;
+        if (debouncer.update(raw, startMs + i) & bit) {
+            edges.push_back({(uint32_t)i, (debouncer.state() & bit) != 0});
+        }
+    }
+    return edges;
+}
+
+Debouncer make(DebounceMode mode, uint8_t pressMs = 5,
+               uint8_t releaseMs = 5) {
+    Debouncer debouncer(35);
+    debouncer.configure({mode, pressMs, releaseMs});
+    return debouncer;
+}
+
+void assertEdges(const std::vector<Edge> &edges, uint32_t pressMs,
+                 uint32_t releaseMs) {
+    TEST_ASSERT_EQUAL(2, edges.size());
+    TEST_ASSERT_TRUE(edges[0].pressed);
+    TEST_ASSERT_EQUAL_UINT32(pressMs, edges[0].ms);
+    TEST_ASSERT_FALSE(edges[1].pressed);
+    TEST_ASSERT_EQUAL_UINT32(releaseMs, edges[1].ms);
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_eager_reports_first_contact_and_swallows_chatter() {
+    Debouncer debouncer = make(kDebounceEager);
+    assertEdges(replay(debouncer, bounceTrace(), 1000), 0, 50);
+}
+
+void test_deferred_waits_for_a_stable_level() {
+    Debouncer debouncer = make(kDebounceDeferred);
+    // The level settles at 4 and 54 ms, then stays for the 5 ms window
+    assertEdges(replay(debouncer, bounceTrace(), 1000), 9, 59);
+}
+
+void test_asymmetric_is_eager_on_press_deferred_on_release() {
+    Debouncer debouncer = make(kDebounceAsymmetric);
+    assertEdges(replay(debouncer, bounceTrace(), 1000), 0, 59);
+}
+
+void test_deferred_filters_a_noise_spike() {
+    Debouncer debouncer = make(kDebounceDeferred);
+    std::string spike = "0001" + std::string(20, '0');
+    TEST_ASSERT_EQUAL(0, replay(debouncer, spike, 1000).size());
+    TEST_ASSERT_EQUAL_HEX64(0, debouncer.state());
+}
+
+void test_eager_lockout_lasts_the_window() {
+    Debouncer debouncer = make(kDebounceEager);
+    // A spike is a press; the release follows once the lockout is over
+    std::string spike = "0001" + std::string(20, '0');
+    assertEdges(replay(debouncer, spike, 1000), 3, 8);
+}
+
+void test_separate_press_and_release_windows() {
+    Debouncer debouncer = make(kDebounceDeferred, 2, 10);
+    assertEdges(replay(debouncer, bounceTrace(), 1000), 6, 64);
+}
+
+void test_timestamps_wrap_at_16_bits() {
+    Debouncer debouncer = make(kDebounceDeferred);
+    assertEdges(replay(debouncer, bounceTrace(), 65530), 9, 59);
+    Debouncer eager = make(kDebounceEager);
+    assertEdges(replay(eager, bounceTrace(), UINT32_MAX - 20), 0, 50);
+}
+
+void test_keys_debounce_independently() {
+    Debouncer debouncer = make(kDebounceDeferred);
+    std::string trace = bounceTrace();
+    // Key 34 goes down cleanly and stays down
+    const Debouncer::State held = (Debouncer::State)1 << 34;
+    std::vector<Edge> edges[2];
+    for (size_t i = 0; i < trace.size(); i++) {
+        Debouncer::State raw = (trace[i] == '1' ? 1 : 0) | held;
+        Debouncer::State changed = debouncer.update(raw, 1000 + i);
+        if (changed & 1) edges[0].push_back({(uint32_t)i, true});
+        if (changed & held) edges[1].push_back({(uint32_t)i, true});
+    }
+    TEST_ASSERT_EQUAL(2, edges[0].size());
+    TEST_ASSERT_EQUAL(1, edges[1].size());
+    TEST_ASSERT_EQUAL_UINT32(5, edges[1][0].ms);
+}
+
+void test_keys_past_the_count_are_ignored() {
+    Debouncer debouncer(3);
+    debouncer.configure({kDebounceEager, 5, 5});
+    TEST_ASSERT_EQUAL_HEX64(1, debouncer.update(0x21, 0));
+    TEST_ASSERT_EQUAL_HEX64(1, debouncer.state());
+}
+
+void test_settings_poll_once_per_publish() {
+    DebounceSettings settings;
+    uint32_t seen = 0;
+    DebounceConfig config = {kDebounceDeferred, 0, 0};
+    TEST_ASSERT_TRUE(settings.poll(seen, &config));
+    TEST_ASSERT_EQUAL(kDebounceEager, config.mode);
+    TEST_ASSERT_EQUAL_UINT8(5, config.pressMs);
+    TEST_ASSERT_FALSE(settings.poll(seen, &config));
+
+    settings.publish({kDebounceAsymmetric, 8, 20});
+    TEST_ASSERT_TRUE(settings.poll(seen, &config));
+    TEST_ASSERT_EQUAL(kDebounceAsymmetric, config.mode);
+    TEST_ASSERT_EQUAL_UINT8(8, config.pressMs);
+    TEST_ASSERT_EQUAL_UINT8(20, config.releaseMs);
+    TEST_ASSERT_FALSE(settings.poll(seen, &config));
+}
+
+void test_settings_each_poller_sees_every_publish() {
+    DebounceSettings settings;
+    uint32_t matrixSeen = 0;
+    uint32_t extSeen = 0;
+    DebounceConfig config;
+    TEST_ASSERT_TRUE(settings.poll(matrixSeen, &config));
+    // Reloading an unchanged config still counts as a publish
+    settings.publish(kDefaultDebounce);
+    TEST_ASSERT_TRUE(settings.poll(matrixSeen, &config));
+    TEST_ASSERT_TRUE(settings.poll(extSeen, &config));
+    TEST_ASSERT_FALSE(settings.poll(extSeen, &config));
+    // The count wraps without ever matching a fresh poller
+    for (int i = 0; i < 300; i++) settings.publish(kDefaultDebounce);
+    uint32_t fresh = 0;
+    TEST_ASSERT_TRUE(settings.poll(fresh, &config));
+}
+
+// Bench: latency and edge count of every mode on the same bounce trace,
+// replayed on all 35 keys at once.
+void test_bench_bounce_trace_replay() {
+    const DebounceMode modes[] = {kDebounceEager, kDebounceDeferred,
+                                  kDebounceAsymmetric};
+    const char *const names[] = {"eager", "deferred", "asymmetric"};
+    std::string trace = bounceTrace();
+    for (int m = 0; m < 3; m++) {
+        Debouncer debouncer = make(modes[m]);
+        int edges = 0;
+        uint32_t pressAt = 0, releaseAt = 0;
+        for (size_t i = 0; i < trace.size(); i++) {
+            Debouncer::State raw = trace[i] == '1' ? (1ULL << 35) - 1 : 0;
+            Debouncer::State changed = debouncer.update(raw, i);
+            if (!changed) continue;
+            TEST_ASSERT_EQUAL_HEX64((1ULL << 35) - 1, changed);
+            edges++;
+            if (debouncer.state()) {
+                pressAt = i;
+            } else {
+                releaseAt = i - 50;
+            }
+        }
+        char line[96];
+        snprintf(line, sizeof(line),
+                 "%-10s press +%u ms, release +%u ms, %d edges per key",
+                 names[m], (unsigned)pressAt, (unsigned)releaseAt, edges);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_EQUAL(2, edges);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_eager_reports_first_contact_and_swallows_chatter);
+    RUN_TEST(test_deferred_waits_for_a_stable_level);
+    RUN_TEST(test_asymmetric_is_eager_on_press_deferred_on_release);
+    RUN_TEST(test_deferred_filters_a_noise_spike);
+    RUN_TEST(test_eager_lockout_lasts_the_window);
+    RUN_TEST(test_separate_press_and_release_windows);
+    RUN_TEST(test_timestamps_wrap_at_16_bits);
+    RUN_TEST(test_keys_debounce_independently);
+    RUN_TEST(test_keys_past_the_count_are_ignored);
+    RUN_TEST(test_settings_poll_once_per_publish);
+    RUN_TEST(test_settings_each_poller_sees_every_publish);
+    RUN_TEST(test_bench_bounce_trace_replay);
+    return UNITY_END();
+}
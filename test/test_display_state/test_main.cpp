@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "display_state.h"
+
+// Display state is one set of globals; each test starts from what the one
+// before left behind and only checks what it changed.
+
+namespace {
+// Lines written by the stress writers: a full line of one letter, so a
+// copy torn between two writes shows two letters.
+std::string stressLine(int i) {
+    return std::string(Display::kLineSize - 1, 'a' + i % 26);
+}
+
+bool isStressLine(const char *line) {
+    if (!*line) return true;  // before the first write
+    return std::string(line) == std::string(strlen(line), line[0]) &&
+           strlen(line) == Display::kLineSize - 1;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_snapshot_returns_what_was_set() {
+    Display::setTop("Layer 1");
+    Display::setBottom("Ready");
+    Display::setIcon(3);
+    Display::State state;
+    Display::snapshot(state);
+    TEST_ASSERT_EQUAL_STRING("Layer 1", state.top);
+    TEST_ASSERT_EQUAL_STRING("Ready", state.bottom);
+    TEST_ASSERT_EQUAL(3, state.icon);
+    TEST_ASSERT_EQUAL_UINT32(Display::generation(), state.generation);
+}
+
+void test_only_changes_bump_the_generation() {
+    Display::setTop("same");
+    uint32_t before = Display::generation();
+    Display::setTop("same");
+    Display::setTop(String("same"));
+    Display::setIcon(7);
+    Display::setIcon(7);
+    TEST_ASSERT_EQUAL_UINT32(before + 1, Display::generation());
+    Display::setBottom(nullptr);
+    Display::setBottom("");
+    Display::State state;
+    Display::snapshot(state);
+    TEST_ASSERT_EQUAL_STRING("", state.bottom);
+}
+
+void test_long_lines_are_cut() {
+    std::string text(100, 'x');
+    Display::setTop(text.c_str());
+    Display::State state;
+    Display::snapshot(state);
+    TEST_ASSERT_EQUAL(Display::kLineSize - 1, strlen(state.top));
+}
+
+void test_key_info_is_taken_once() {
+    char label[Display::kLineSize];
+    Display::takeKeyInfo(label);
+    TEST_ASSERT_FALSE(Display::takeKeyInfo(label));
+    Display::setKeyInfo("Copy");
+    Display::setKeyInfo("Paste");
+    TEST_ASSERT_TRUE(Display::takeKeyInfo(label));
+    TEST_ASSERT_EQUAL_STRING("Paste", label);
+    TEST_ASSERT_FALSE(Display::takeKeyInfo(label));
+}
+
+void test_show_layout_prefixes_the_title() {
+    Display::setLayout("Photoshop");
+    Display::State state;
+    Display::snapshot(state);
+    // Setting the title alone shows nothing
+    TEST_ASSERT_NOT_EQUAL(0, strcmp("@Photoshop", state.bottom));
+    Display::showLayout();
+    Display::snapshot(state);
+    TEST_ASSERT_EQUAL_STRING("@Photoshop", state.bottom);
+}
+
+// Bench: two writers on their own threads rewrite both lines as fast as
+// they can while the reader snapshots; no snapshot may see a torn line or
+// the generation go back.
+void test_bench_seqlock_stress() {
+    const int kWrites = 200000;
+    Display::setTop("");
+    Display::setBottom("");
+    std::atomic<int> running(2);
+    auto writer = [&](bool top) {
+        for (int i = 0; i < kWrites; i++) {
+            std::string line = stressLine(i);
+            if (top) {
+                Display::setTop(line.c_str());
+            } else {
+                Display::setBottom(line.c_str());
+            }
+        }
+        running--;
+    };
+    std::thread topWriter(writer, true);
+    std::thread bottomWriter(writer, false);
+
+    long snapshots = 0, torn = 0;
+    uint32_t last = 0;
+    bool backwards = false;
+    Display::State state;
+    while (running > 0) {
+        Display::snapshot(state);
+        snapshots++;
+        if (!isStressLine(state.top) || !isStressLine(state.bottom)) torn++;
+        if (state.generation < last) backwards = true;
+        last = state.generation;
+    }
+    topWriter.join();
+    bottomWriter.join();
+
+    char line[96];
+    snprintf(line, sizeof(line),
+             "%d writes per thread, %ld snapshots, %ld torn", kWrites,
+             snapshots, torn);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_FALSE(backwards);
+    Display::snapshot(state);
+    TEST_ASSERT_TRUE(isStressLine(state.top));
+    TEST_ASSERT_TRUE(isStressLine(state.bottom));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_snapshot_returns_what_was_set);
+    RUN_TEST(test_only_changes_bump_the_generation);
+    RUN_TEST(test_long_lines_are_cut);
+    RUN_TEST(test_key_info_is_taken_once);
+    RUN_TEST(test_show_layout_prefixes_the_title);
+    RUN_TEST(test_bench_seqlock_stress);
+    return UNITY_END();
+}
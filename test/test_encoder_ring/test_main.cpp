@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "encoder_ring.h"
+
+namespace {
+// What the consumer took, per direction
+struct Totals {
+    uint32_t events = 0;
+    uint32_t cw = 0;
+    uint32_t ccw = 0;
+    bool timeWentBack = false;
+    uint16_t lastMs = 0;
+
+    void add(const EncoderRing::Event &event) {
+        if (events && (int16_t)(event.timeMs - lastMs) < 0) {
+            timeWentBack = true;
+        }
+        lastMs = event.timeMs;
+        events++;
+        (event.direction > 0 ? cw : ccw) += event.count;
+    }
+
+    void drain(EncoderRing &ring) {
+        EncoderRing::Event event;
+        while (ring.pop(event)) add(event);
+    }
+};
+
+// Producer side of a stress run: detents pushed and dropped per direction
+struct Pushed {
+    uint32_t cw = 0;
+    uint32_t ccw = 0;
+    uint32_t dropped = 0;
+};
+
+// Push `detents` detents one millisecond apart, turning around every
+// `runLength`, sleeping between them when `paced` (a 1 kHz spin).
+Pushed produce(EncoderRing &ring, int detents, int runLength, bool paced) {
+    Pushed pushed;
+    for (int i = 0; i < detents; i++) {
+        int8_t direction = (i / runLength) % 2 ? -1 : 1;
+        if (ring.push(direction, i) == EncoderRing::kDropped) {
+            pushed.dropped++;
+        } else {
+            (direction > 0 ? pushed.cw : pushed.ccw)++;
+        }
+        if (paced) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pushed;
+}
+
+// Run produce() on its own thread while this one drains the ring every
+// `pollMs`, the way the output task does.
+Totals stress(EncoderRing &ring, Pushed &pushed, int detents, int runLength,
+              bool paced, int pollMs) {
+    std::atomic<bool> done(false);
+    std::thread producer([&] {
+        pushed = produce(ring, detents, runLength, paced);
+        done = true;
+    });
+    Totals taken;
+    while (!done) {
+        taken.drain(ring);
+        std::this_thread::sleep_for(std::chrono::milliseconds(pollMs));
+    }
+    producer.join();
+    taken.drain(ring);
+    return taken;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_same_direction_detents_merge() {
+    EncoderRing ring;
+    TEST_ASSERT_EQUAL(EncoderRing::kAppended, ring.push(1, 10));
+    TEST_ASSERT_EQUAL(EncoderRing::kMerged, ring.push(1, 11));
+    TEST_ASSERT_EQUAL(EncoderRing::kMerged, ring.push(1, 12));
+    EncoderRing::Event event;
+    TEST_ASSERT_TRUE(ring.pop(event));
+    TEST_ASSERT_EQUAL(1, event.direction);
+    TEST_ASSERT_EQUAL(3, event.count);
+    TEST_ASSERT_EQUAL(12, event.timeMs);
+    TEST_ASSERT_FALSE(ring.pop(event));
+}
+
+void test_turning_back_starts_a_new_event() {
+    EncoderRing ring;
+    ring.push(1, 0);
+    TEST_ASSERT_EQUAL(EncoderRing::kAppended, ring.push(-1, 1));
+    TEST_ASSERT_EQUAL(EncoderRing::kMerged, ring.push(-1, 2));
+    EncoderRing::Event event;
+    ring.pop(event);
+    TEST_ASSERT_EQUAL(1, event.direction);
+    ring.pop(event);
+    TEST_ASSERT_EQUAL(-1, event.direction);
+    TEST_ASSERT_EQUAL(2, event.count);
+}
+
+void test_a_taken_event_is_not_merged_into() {
+    EncoderRing ring;
+    ring.push(1, 0);
+    EncoderRing::Event event;
+    ring.pop(event);
+    TEST_ASSERT_EQUAL(EncoderRing::kAppended, ring.push(1, 1));
+    ring.pop(event);
+    TEST_ASSERT_EQUAL(1, event.count);
+}
+
+void test_a_full_count_starts_a_new_event() {
+    EncoderRing ring;
+    for (int i = 0; i < 300; i++) ring.push(1, i);
+    Totals taken;
+    taken.drain(ring);
+    TEST_ASSERT_EQUAL_UINT32(2, taken.events);
+    TEST_ASSERT_EQUAL_UINT32(300, taken.cw);
+}
+
+void test_a_full_ring_drops_and_counts() {
+    EncoderRing ring;
+    for (uint32_t i = 0; i < EncoderRing::kSize; i++) {
+        TEST_ASSERT_EQUAL(EncoderRing::kAppended, ring.push(i % 2 ? -1 : 1, i));
+    }
+    // The newest event is CCW, so a CW detent cannot merge
+    TEST_ASSERT_EQUAL(EncoderRing::kDropped, ring.push(1, 100));
+    TEST_ASSERT_EQUAL(EncoderRing::kMerged, ring.push(-1, 101));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.dropped());
+
+    Totals taken;
+    taken.drain(ring);
+    TEST_ASSERT_EQUAL_UINT32(EncoderRing::kSize, taken.events);
+    TEST_ASSERT_EQUAL_UINT32(EncoderRing::kSize / 2 + 1, taken.ccw);
+    TEST_ASSERT_EQUAL(EncoderRing::kAppended, ring.push(1, 102));
+}
+
+// Bench: a 1 kHz spin with a turn every 7 detents against a consumer that
+// polls every 10 ms. Merging keeps it lossless; every detent is accounted
+// for and events come out in order.
+void test_bench_1khz_spin() {
+    EncoderRing ring;
+    Pushed pushed;
+    Totals taken = stress(ring, pushed, 1000, 7, true, 10);
+
+    char line[96];
+    snprintf(line, sizeof(line),
+             "1000 detents at 1 kHz: %u events, %u dropped",
+             (unsigned)taken.events, (unsigned)pushed.dropped);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(0, pushed.dropped);
+    TEST_ASSERT_EQUAL_UINT32(pushed.cw, taken.cw);
+    TEST_ASSERT_EQUAL_UINT32(pushed.ccw, taken.ccw);
+    TEST_ASSERT_FALSE(taken.timeWentBack);
+}
+
+// Bench: the producer flat out, turning on every detent, against a consumer
+// that polls every millisecond. Once the ring is full only detents in the
+// newest event's direction get in; every detent is either taken or counted
+// as dropped.
+void test_bench_unmergeable_flood() {
+    EncoderRing ring;
+    Pushed pushed;
+    Totals taken = stress(ring, pushed, 100000, 1, false, 1);
+
+    char line[96];
+    snprintf(line, sizeof(line),
+             "100000 alternating detents flat out: %u events, %u dropped",
+             (unsigned)taken.events, (unsigned)pushed.dropped);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(pushed.dropped, ring.dropped());
+    TEST_ASSERT_EQUAL_UINT32(pushed.cw, taken.cw);
+    TEST_ASSERT_EQUAL_UINT32(pushed.ccw, taken.ccw);
+    TEST_ASSERT_EQUAL_UINT32(100000, taken.cw + taken.ccw + pushed.dropped);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_direction_detents_merge);
+    RUN_TEST(test_turning_back_starts_a_new_event);
+    RUN_TEST(test_a_taken_event_is_not_merged_into);
+    RUN_TEST(test_a_full_count_starts_a_new_event);
+    RUN_TEST(test_a_full_ring_drops_and_counts);
+    RUN_TEST(test_bench_1khz_spin);
+    RUN_TEST(test_bench_unmergeable_flood);
+    return UNITY_END();
+}
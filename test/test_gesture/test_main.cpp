@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "gesture.h"
+
+namespace {
+// Logs "<ms> <gesture> <index>"
+class RecordingListener : public GestureRecognizer::Listener {
+   public:
+    std::vector<std::string> log;
+
+    void gesture(GestureRecognizer::Gesture gesture, uint8_t index,
+                 uint32_t nowMs) override {
+        const char *const names[] = {"tap",     "doubletap", "hold",
+                                     "holdend", "chord",     "chordend"};
+        char line[32];
+        snprintf(line, sizeof(line), "%u %s %u", (unsigned)nowMs,
+                 names[gesture], index);
+        log.push_back(line);
+    }
+};
+
+// Recognizer with 1000 ms holds and a 300 ms double-tap window
+struct Fixture {
+    RecordingListener listener;
+    GestureRecognizer gestures;
+
+    Fixture() : gestures(listener, 8) { gestures.setTiming(1000, 300); }
+
+    // Tick at every deadline up to untilMs, like the input task's waits
+    void runUntil(uint32_t &nowMs, uint32_t untilMs) {
+        for (;;) {
+            uint32_t wait = gestures.nextTickIn(nowMs);
+            if (wait == UINT32_MAX || nowMs + wait > untilMs) break;
+            nowMs += wait;
+            gestures.tick(nowMs);
+        }
+        nowMs = untilMs;
+    }
+
+    // Edges as (ms, input, pressed), ticking in between, then up to endMs
+    void play(const std::vector<std::vector<uint32_t>> &edges,
+              uint32_t endMs) {
+        uint32_t nowMs = 0;
+        for (const std::vector<uint32_t> &edge : edges) {
+            runUntil(nowMs, edge[0]);
+            gestures.update(edge[1], edge[2], nowMs);
+        }
+        runUntil(nowMs, endMs);
+    }
+
+    void assertLog(const std::vector<std::string> &expected) {
+        TEST_ASSERT_EQUAL(expected.size(), listener.log.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            TEST_ASSERT_EQUAL_STRING(expected[i].c_str(),
+                                     listener.log[i].c_str());
+        }
+    }
+};
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_a_short_press_is_a_tap_on_release() {
+    Fixture f;
+    f.play({{0, 2, 1}, {100, 2, 0}}, 5000);
+    f.assertLog({"100 tap 2"});
+}
+
+void test_a_long_press_is_a_hold_then_hold_end() {
+    Fixture f;
+    f.play({{0, 2, 1}, {2500, 2, 0}}, 5000);
+    f.assertLog({"1000 hold 2", "2500 holdend 2"});
+}
+
+void test_double_tap_buttons_wait_for_the_window() {
+    Fixture f;
+    f.gestures.setDoubleTap(1 << 2);
+    f.play({{0, 2, 1}, {100, 2, 0}, {1000, 2, 1}, {1050, 2, 0}, {1200, 2, 1},
+            {1250, 2, 0}},
+           5000);
+    f.assertLog({"400 tap 2", "1250 doubletap 2"});
+}
+
+void test_a_chord_swallows_its_members() {
+    Fixture f;
+    TEST_ASSERT_EQUAL(0, f.gestures.addChord((1 << 1) | (1 << 2)));
+    f.play({{0, 1, 1}, {50, 2, 1}, {3000, 1, 0}, {3100, 2, 0}}, 5000);
+    f.assertLog({"50 chord 0", "3000 chordend 0"});
+}
+
+void test_a_held_button_does_not_start_a_chord() {
+    Fixture f;
+    f.gestures.addChord((1 << 1) | (1 << 2));
+    f.play({{0, 1, 1}, {1500, 2, 1}, {1600, 2, 0}, {2000, 1, 0}}, 5000);
+    f.assertLog({"1000 hold 1", "1600 tap 2", "2000 holdend 1"});
+}
+
+void test_the_chord_table_fills_up() {
+    Fixture f;
+    for (int i = 0; i < GestureRecognizer::kMaxChords; i++) {
+        TEST_ASSERT_EQUAL(i, f.gestures.addChord(1 << i));
+    }
+    TEST_ASSERT_EQUAL(-1, f.gestures.addChord(1 << 7));
+    TEST_ASSERT_EQUAL(-1, Fixture().gestures.addChord(0));
+}
+
+void test_hold_now_decides_pending_presses() {
+    Fixture f;
+    f.gestures.update(3, true, 0);
+    f.gestures.update(4, true, 10);
+    f.gestures.holdNow(20);
+    // Already decided: nothing more
+    f.gestures.holdNow(30);
+    f.gestures.update(3, false, 40);
+    f.assertLog({"20 hold 3", "20 hold 4", "40 holdend 3"});
+    TEST_ASSERT_EQUAL(UINT32_MAX, f.gestures.nextTickIn(40));
+}
+
+void test_next_tick_in_is_the_nearest_deadline() {
+    Fixture f;
+    f.gestures.setDoubleTap(1 << 5);
+    TEST_ASSERT_EQUAL(UINT32_MAX, f.gestures.nextTickIn(0));
+    f.gestures.update(1, true, 100);
+    TEST_ASSERT_EQUAL(1000, f.gestures.nextTickIn(100));
+    f.gestures.update(5, true, 200);
+    f.gestures.update(5, false, 250);
+    TEST_ASSERT_EQUAL(300, f.gestures.nextTickIn(250));
+    // Overdue reads as zero
+    TEST_ASSERT_EQUAL(0, f.gestures.nextTickIn(2000));
+}
+
+void test_deadlines_survive_the_millis_wrap() {
+    Fixture f;
+    uint32_t start = UINT32_MAX - 100;
+    f.gestures.update(0, true, start);
+    TEST_ASSERT_EQUAL(1000, f.gestures.nextTickIn(start));
+    f.gestures.tick(start + 999);
+    TEST_ASSERT_EQUAL(0, f.listener.log.size());
+    f.gestures.tick(start + 1000);
+    TEST_ASSERT_EQUAL(1, f.listener.log.size());
+}
+
+void test_out_of_range_and_repeated_edges_are_ignored() {
+    Fixture f;
+    f.gestures.update(8, true, 0);
+    f.gestures.update(1, false, 0);
+    f.gestures.update(1, true, 0);
+    f.gestures.update(1, true, 50);
+    f.gestures.update(1, false, 100);
+    f.assertLog({"100 tap 1"});
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_a_short_press_is_a_tap_on_release);
+    RUN_TEST(test_a_long_press_is_a_hold_then_hold_end);
+    RUN_TEST(test_double_tap_buttons_wait_for_the_window);
+    RUN_TEST(test_a_chord_swallows_its_members);
+    RUN_TEST(test_a_held_button_does_not_start_a_chord);
+    RUN_TEST(test_the_chord_table_fills_up);
+    RUN_TEST(test_hold_now_decides_pending_presses);
+    RUN_TEST(test_next_tick_in_is_the_nearest_deadline);
+    RUN_TEST(test_deadlines_survive_the_millis_wrap);
+    RUN_TEST(test_out_of_range_and_repeated_edges_are_ignored);
+    return UNITY_END();
+}
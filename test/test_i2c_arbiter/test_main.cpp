@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+
+#include "i2c_schedule.h"
+
+namespace {
+uint32_t gNowUs = 0;
+
+uint32_t fakeClock() { return gNowUs; }
+
+// Fake bus: every transaction takes its duration on the fake clock and
+// leaves its name in the log.
+struct Transaction {
+    const char *name;
+    uint32_t busUs;
+};
+
+std::string gLog;
+
+bool transfer(void *arg) {
+    const Transaction *t = static_cast<const Transaction *>(arg);
+    gNowUs += t->busUs;
+    gLog += t->name;
+    return true;
+}
+
+// What the arbiter task does with each notification
+bool serveOne(I2cSchedule &schedule) {
+    I2cSchedule::Entry entry;
+    if (!schedule.pop(&entry)) return false;
+    schedule.execute(entry);
+    return true;
+}
+
+Transaction gRead = {"r", 150};
+Transaction gPages[] = {{"A", 1100}, {"B", 1100}, {"C", 1100}, {"D", 1100}};
+}  // namespace
+
+void setUp() {
+    gNowUs = 0;
+    gLog.clear();
+}
+
+void tearDown() {}
+
+void test_high_priority_jobs_go_first() {
+    I2cSchedule schedule(fakeClock);
+    schedule.push(kI2cLow, kI2cOled, transfer, &gPages[0], nullptr);
+    schedule.push(kI2cLow, kI2cOled, transfer, &gPages[1], nullptr);
+    schedule.push(kI2cHigh, kI2cExtension, transfer, &gRead, nullptr);
+    while (serveOne(schedule)) {
+    }
+    TEST_ASSERT_EQUAL_STRING("rAB", gLog.c_str());
+}
+
+void test_each_priority_keeps_its_order() {
+    I2cSchedule schedule(fakeClock);
+    for (int i = 0; i < 4; i++) {
+        schedule.push(kI2cLow, kI2cOled, transfer, &gPages[i], nullptr);
+    }
+    while (serveOne(schedule)) {
+    }
+    TEST_ASSERT_EQUAL_STRING("ABCD", gLog.c_str());
+}
+
+void test_low_priority_jobs_are_not_starved() {
+    I2cSchedule schedule(fakeClock);
+    for (int i = 0; i < 4; i++) {
+        schedule.push(kI2cLow, kI2cOled, transfer, &gPages[i], nullptr);
+    }
+    // An input task that queues its next read as soon as one is done keeps
+    // a high job waiting all the time
+    schedule.push(kI2cHigh, kI2cExtension, transfer, &gRead, nullptr);
+    for (int i = 0; i < 40 && schedule.waiting(kI2cLow); i++) {
+        I2cSchedule::Entry entry;
+        TEST_ASSERT_TRUE(schedule.pop(&entry));
+        schedule.execute(entry);
+        if (entry.device == kI2cExtension) {
+            schedule.push(kI2cHigh, kI2cExtension, transfer, &gRead,
+                          nullptr);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, schedule.waiting(kI2cLow));
+    TEST_ASSERT_EQUAL_STRING("rrrrArrrrBrrrrCrrrrD", gLog.c_str());
+}
+
+void test_a_full_queue_refuses() {
+    I2cSchedule schedule(fakeClock);
+    for (size_t i = 0; i < I2cSchedule::kQueueLength; i++) {
+        TEST_ASSERT_TRUE(
+            schedule.push(kI2cLow, kI2cOled, transfer, &gPages[0], nullptr));
+    }
+    TEST_ASSERT_FALSE(
+        schedule.push(kI2cLow, kI2cOled, transfer, &gPages[0], nullptr));
+    // The other priority has its own room
+    TEST_ASSERT_TRUE(
+        schedule.push(kI2cHigh, kI2cExtension, transfer, &gRead, nullptr));
+    TEST_ASSERT_TRUE(serveOne(schedule));
+    TEST_ASSERT_TRUE(serveOne(schedule));
+    TEST_ASSERT_TRUE(
+        schedule.push(kI2cLow, kI2cOled, transfer, &gPages[0], nullptr));
+}
+
+void test_stats_split_wait_and_bus_time() {
+    I2cSchedule schedule(fakeClock);
+    schedule.push(kI2cLow, kI2cOled, transfer, &gPages[0], nullptr);
+    gNowUs = 100;
+    schedule.push(kI2cHigh, kI2cExtension, transfer, &gRead, nullptr);
+    gNowUs = 200;
+    while (serveOne(schedule)) {
+    }
+    schedule.executeNow(kI2cExtension, transfer, &gRead);
+
+    const I2cSchedule::DeviceStats &ext = schedule.stats(kI2cExtension);
+    TEST_ASSERT_EQUAL_UINT32(2, ext.transactions);
+    TEST_ASSERT_EQUAL_UINT32(100, ext.maxWaitUs);
+    TEST_ASSERT_EQUAL_UINT32(150, ext.maxBusUs);
+    TEST_ASSERT_EQUAL_UINT64(300, ext.totalBusUs);
+
+    const I2cSchedule::DeviceStats &oled = schedule.stats(kI2cOled);
+    TEST_ASSERT_EQUAL_UINT32(1, oled.transactions);
+    // Queued at 0, started after the read that ended at 350
+    TEST_ASSERT_EQUAL_UINT32(350, oled.maxWaitUs);
+    TEST_ASSERT_EQUAL_UINT32(1100, oled.maxBusUs);
+}
+
+// Extension board read for the bench: how late it started against when it
+// was due
+struct PolledRead {
+    uint32_t dueUs;
+    uint32_t worstLateUs;
+};
+
+bool pollRead(void *arg) {
+    PolledRead *read = static_cast<PolledRead *>(arg);
+    uint32_t late = gNowUs - read->dueUs;
+    if (late > read->worstLateUs) read->worstLateUs = late;
+    return transfer(&gRead);
+}
+
+// Bench: one simulated second of an extension board read due every 3 ms
+// next to a 4-page display frame every 33 ms. The transactions don't
+// preempt each other, so a read can start late by one page at most.
+void test_bench_reads_next_to_frames() {
+    I2cSchedule schedule(fakeClock);
+    PolledRead read = {0, 0};
+    uint32_t nextFrame = 0;
+    bool readQueued = false;
+    while (gNowUs < 1000000) {
+        if (!readQueued && gNowUs >= read.dueUs) {
+            schedule.push(kI2cHigh, kI2cExtension, pollRead, &read, nullptr);
+            readQueued = true;
+        }
+        if (gNowUs >= nextFrame) {
+            for (int i = 0; i < 4; i++) {
+                schedule.push(kI2cLow, kI2cOled, transfer, &gPages[i],
+                              nullptr);
+            }
+            nextFrame += 33000;
+        }
+        I2cSchedule::Entry entry;
+        if (schedule.pop(&entry)) {
+            schedule.execute(entry);
+            if (entry.device == kI2cExtension) {
+                readQueued = false;
+                read.dueUs += 3000;
+            }
+        } else {
+            gNowUs = read.dueUs < nextFrame ? read.dueUs : nextFrame;
+        }
+    }
+    const I2cSchedule::DeviceStats &ext = schedule.stats(kI2cExtension);
+    const I2cSchedule::DeviceStats &oled = schedule.stats(kI2cOled);
+    char line[120];
+    snprintf(line, sizeof(line),
+             "1 s: %u reads, latest start %u us; %u pages, worst wait %u us",
+             (unsigned)ext.transactions, (unsigned)read.worstLateUs,
+             (unsigned)oled.transactions, (unsigned)oled.maxWaitUs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(read.worstLateUs <= gPages[0].busUs);
+    TEST_ASSERT_EQUAL_UINT32(4 * 31, oled.transactions);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_high_priority_jobs_go_first);
+    RUN_TEST(test_each_priority_keeps_its_order);
+    RUN_TEST(test_low_priority_jobs_are_not_starved);
+    RUN_TEST(test_a_full_queue_refuses);
+    RUN_TEST(test_stats_split_wait_and_bus_time);
+    RUN_TEST(test_bench_reads_next_to_frames);
+    return UNITY_END();
+}
@@ -0,0 +1,90 @@
+#include <unity.h>
+
+#include <string>
+
+#include "input_bus.h"
+
+namespace {
+// Fake bus with room for `room` edges, logging each as "+<key>" / "-<key>"
+struct FakeBus {
+    int room;
+    std::string log;
+
+    bool send(uint8_t key, bool pressed) {
+        if (room == 0) return false;
+        room--;
+        log += (pressed ? "+" : "-") + std::to_string(key);
+        return true;
+    }
+};
+
+FakeBus gBus;
+
+void sync(KeySync &keys, KeySync::State state, int room) {
+    gBus.room = room;
+    keys.sync(state, [](uint8_t key, bool pressed) {
+        return gBus.send(key, pressed);
+    });
+}
+}  // namespace
+
+void setUp() { gBus = FakeBus(); }
+
+void tearDown() {}
+
+void test_changed_keys_go_out_lowest_first() {
+    KeySync keys;
+    sync(keys, (1ULL << 34) | (1ULL << 3) | 1, 8);
+    TEST_ASSERT_EQUAL_STRING("+0+3+34", gBus.log.c_str());
+    sync(keys, 1ULL << 3, 8);
+    TEST_ASSERT_EQUAL_STRING("+0+3+34-0-34", gBus.log.c_str());
+    TEST_ASSERT_EQUAL(0, keys.pending(1ULL << 3));
+}
+
+void test_an_unchanged_state_sends_nothing() {
+    KeySync keys;
+    sync(keys, 1ULL << 5, 8);
+    sync(keys, 1ULL << 5, 8);
+    TEST_ASSERT_EQUAL_STRING("+5", gBus.log.c_str());
+}
+
+void test_a_refused_release_is_sent_again() {
+    KeySync keys;
+    sync(keys, 1ULL << 7, 8);
+    // Bus full as the key comes up: the release stays pending
+    sync(keys, 0, 0);
+    TEST_ASSERT_EQUAL(1ULL << 7, keys.pending(0));
+    sync(keys, 0, 0);
+    // Room again: it goes out, once
+    sync(keys, 0, 8);
+    sync(keys, 0, 8);
+    TEST_ASSERT_EQUAL_STRING("+7-7", gBus.log.c_str());
+    TEST_ASSERT_EQUAL(0, keys.pending(0));
+}
+
+void test_a_partly_refused_pass_keeps_the_rest_pending() {
+    KeySync keys;
+    sync(keys, 0x7, 2);
+    TEST_ASSERT_EQUAL_STRING("+0+1", gBus.log.c_str());
+    TEST_ASSERT_EQUAL(0x4, keys.pending(0x7));
+    sync(keys, 0x7, 2);
+    TEST_ASSERT_EQUAL_STRING("+0+1+2", gBus.log.c_str());
+}
+
+void test_a_refused_press_and_release_cancel_out() {
+    KeySync keys;
+    sync(keys, 1ULL << 9, 0);
+    sync(keys, 0, 8);
+    TEST_ASSERT_EQUAL_STRING("", gBus.log.c_str());
+    TEST_ASSERT_EQUAL(0, keys.pending(0));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_changed_keys_go_out_lowest_first);
+    RUN_TEST(test_an_unchanged_state_sends_nothing);
+    RUN_TEST(test_a_refused_release_is_sent_again);
+    RUN_TEST(test_a_partly_refused_pass_keeps_the_rest_pending);
+    RUN_TEST(test_a_refused_press_and_release_cancel_out);
+    return UNITY_END();
+}
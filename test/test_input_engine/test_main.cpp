@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "input_engine.h"
+
+namespace {
+// Logs every action as "<ms> <what>", timestamped with the engine clock
+class RecordingActions : public InputEngine::Actions {
+   public:
+    std::vector<std::string> log;
+    uint32_t nowMs = 0;
+    uint64_t tapHoldKeys = 0;  // matrix keys bound to a mod-tap
+    int activities = 0;
+
+    void activity() override { activities++; }
+    void key(InputSource source, uint8_t index, bool pressed) override {
+        char line[32];
+        snprintf(line, sizeof(line), "key %u:%u %s", source, index,
+                 pressed ? "down" : "up");
+        add(line);
+    }
+    bool beginTapHold(uint8_t index) override {
+        return (tapHoldKeys >> index) & 1;
+    }
+    void tapHold(uint8_t index, GestureRecognizer::Gesture gesture) override {
+        const char *const names[] = {"tap", "doubletap", "hold", "holdend"};
+        char line[32];
+        snprintf(line, sizeof(line), "taphold %u %s", index, names[gesture]);
+        add(line);
+    }
+    void turn(InputSource source, int8_t direction, uint8_t count,
+              uint32_t timeMs) override {
+        char line[32];
+        snprintf(line, sizeof(line), "turn %u:%d x%u", source, direction,
+                 count);
+        add(line);
+    }
+    void layout(uint8_t index) override { add("layout", index); }
+    void command(InputEngine::Command command) override {
+        add("command", command);
+    }
+    void resetCountdown(uint8_t secondsLeft) override {
+        add("countdown", secondsLeft);
+    }
+
+   private:
+    void add(const char *name, unsigned arg) {
+        char line[32];
+        snprintf(line, sizeof(line), "%s %u", name, arg);
+        add(line);
+    }
+    void add(const char *line) {
+        char stamped[48];
+        snprintf(stamped, sizeof(stamped), "%u %s", (unsigned)nowMs, line);
+        log.push_back(stamped);
+    }
+};
+
+InputEvent event(uint32_t timeMs, InputSource source, uint8_t index,
+                 int8_t value, uint8_t count = 0) {
+    return {timeMs, (uint8_t)source, index, value, count};
+}
+
+// Feed `events` the way the input task does: before each one, run the ticks
+// the engine asked for, then dispatch it. Ticks continue until `untilMs`.
+void play(InputEngine &engine, RecordingActions &actions,
+          const std::vector<InputEvent> &events, uint32_t untilMs) {
+    size_t next = 0;
+    for (;;) {
+        uint32_t dueMs = next < events.size() ? events[next].timeMs : untilMs;
+        uint32_t wait = engine.nextTickIn(actions.nowMs);
+        if (wait != UINT32_MAX && actions.nowMs + wait <= dueMs) {
+            actions.nowMs += wait;
+            engine.tick(actions.nowMs);
+            continue;
+        }
+        actions.nowMs = dueMs;
+        if (next == events.size()) return;
+        engine.dispatch(events[next++]);
+    }
+}
+
+void assertLog(const RecordingActions &actions,
+               const std::vector<std::string> &expected) {
+    TEST_ASSERT_EQUAL(expected.size(), actions.log.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), actions.log[i].c_str());
+    }
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_plain_keys_pass_straight_through() {
+    RecordingActions actions;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(10, kInputMatrix, 5, 1), event(20, kInputExtButton, 2, 1),
+          event(30, kInputMatrix, 5, 0), event(40, kInputExtButton, 2, 0)},
+         2000);
+    assertLog(actions, {"10 key 0:5 down", "20 key 3:2 down", "30 key 0:5 up",
+                        "40 key 3:2 up"});
+    TEST_ASSERT_EQUAL(2, actions.activities);
+}
+
+void test_a_quick_mod_tap_is_a_tap() {
+    RecordingActions actions;
+    actions.tapHoldKeys = 1 << 3;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(0, kInputMatrix, 3, 1), event(150, kInputMatrix, 3, 0)},
+         1000);
+    assertLog(actions, {"150 taphold 3 tap"});
+}
+
+void test_a_long_mod_tap_is_a_hold() {
+    RecordingActions actions;
+    actions.tapHoldKeys = 1 << 3;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(0, kInputMatrix, 3, 1), event(500, kInputMatrix, 3, 0)},
+         1000);
+    assertLog(actions, {"200 taphold 3 hold", "500 taphold 3 holdend"});
+}
+
+void test_a_key_during_a_mod_tap_makes_it_a_hold() {
+    RecordingActions actions;
+    actions.tapHoldKeys = 1 << 3;
+    InputEngine engine(actions);
+    // Shift-on-hold, then 'a' well within the tap time
+    play(engine, actions,
+         {event(0, kInputMatrix, 3, 1), event(40, kInputMatrix, 9, 1),
+          event(60, kInputMatrix, 9, 0), event(80, kInputMatrix, 3, 0)},
+         1000);
+    assertLog(actions, {"40 taphold 3 hold", "40 key 0:9 down",
+                        "60 key 0:9 up", "80 taphold 3 holdend"});
+}
+
+void test_encoder_turns_and_the_bd_switch() {
+    RecordingActions actions;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(0, kInputOnboardEncoder, 0, 1, 3),
+          event(1, kInputExtEncoder, 0, -1, 0),  // nothing left to send
+          event(2, kInputExtEncoder, 0, -1, 1),
+          event(3, kInputBdSwitch, 0, 1), event(4, kInputBdSwitch, 0, 0),
+          event(5, kInputBdSwitch, 1, 1), event(6, kInputBdSwitch, 2, 1),
+          event(7, kInputLayer, 4, 0)},
+         100);
+    char next[32], previous[32], first[32];
+    snprintf(next, sizeof(next), "3 command %u", InputEngine::kNextLayout);
+    snprintf(previous, sizeof(previous), "5 command %u",
+             InputEngine::kPreviousLayout);
+    snprintf(first, sizeof(first), "6 command %u", InputEngine::kFirstLayout);
+    assertLog(actions, {"0 turn 4:1 x3", "2 turn 5:-1 x1", next, previous,
+                        first, "7 layout 4"});
+}
+
+void test_config_button_tap_and_hold() {
+    RecordingActions actions;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(0, kInputConfigButton, 0, 1),
+          event(100, kInputConfigButton, 0, 0),
+          event(2000, kInputConfigButton, 1, 1),
+          event(4000, kInputConfigButton, 1, 0)},
+         5000);
+    char tap[32], hold[32];
+    snprintf(tap, sizeof(tap), "100 command %u", InputEngine::kToggleOutput);
+    snprintf(hold, sizeof(hold), "3000 command %u", InputEngine::kSleep);
+    assertLog(actions, {tap, hold});
+}
+
+void test_the_reset_chord_counts_down() {
+    RecordingActions actions;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(0, kInputConfigButton, 1, 1),
+          event(10, kInputConfigButton, 2, 1)},
+         6000);
+    char reset[32];
+    snprintf(reset, sizeof(reset), "5010 command %u",
+             InputEngine::kResetConfig);
+    assertLog(actions, {"10 countdown 5", "1010 countdown 4",
+                        "2010 countdown 3", "3010 countdown 2",
+                        "4010 countdown 1", reset});
+}
+
+void test_letting_go_cancels_the_reset() {
+    RecordingActions actions;
+    InputEngine engine(actions);
+    play(engine, actions,
+         {event(0, kInputConfigButton, 1, 1),
+          event(10, kInputConfigButton, 2, 1),
+          event(1500, kInputConfigButton, 2, 0),
+          event(1600, kInputConfigButton, 1, 0)},
+         8000);
+    char canceled[32];
+    snprintf(canceled, sizeof(canceled), "1500 command %u",
+             InputEngine::kResetCanceled);
+    assertLog(actions, {"10 countdown 5", "1010 countdown 4", canceled});
+    TEST_ASSERT_EQUAL(UINT32_MAX, engine.nextTickIn(actions.nowMs));
+}
+
+// Bench: cost of a typing stream over 48 keys, three of them mod-taps,
+// 100000 edges 5 ms apart with the ticks the engine asks for in between.
+// The time includes the recording double's string formatting.
+void test_bench_event_stream() {
+    const int kEdges = 100000;
+    RecordingActions actions;
+    actions.tapHoldKeys = 0x0000000100010001ULL;  // keys 0, 16, 32
+    InputEngine engine(actions);
+    std::vector<InputEvent> events;
+    for (int i = 0; i < kEdges; i++) {
+        uint8_t key = (i / 2) % 48;
+        events.push_back(event(5 * i, kInputMatrix, key, i % 2 ? 0 : 1));
+    }
+    auto start = std::chrono::steady_clock::now();
+    play(engine, actions, events, 5 * kEdges);
+    auto took = std::chrono::steady_clock::now() - start;
+    double ns =
+        std::chrono::duration<double, std::nano>(took).count() / kEdges;
+
+    int tapHolds = 0;
+    for (const std::string &line : actions.log) {
+        if (line.find("taphold") != std::string::npos) tapHolds++;
+    }
+    char line[96];
+    snprintf(line, sizeof(line),
+             "%d edges: %d actions, %d of them mod-tap, %.0f ns per edge",
+             kEdges, (int)actions.log.size(), tapHolds, ns);
+    TEST_MESSAGE(line);
+    // A key edge per plain edge, one tap per quick mod-tap press/release
+    TEST_ASSERT_EQUAL(kEdges / 16 / 2, tapHolds);
+    TEST_ASSERT_EQUAL(kEdges - tapHolds, actions.log.size());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_keys_pass_straight_through);
+    RUN_TEST(test_a_quick_mod_tap_is_a_tap);
+    RUN_TEST(test_a_long_mod_tap_is_a_hold);
+    RUN_TEST(test_a_key_during_a_mod_tap_makes_it_a_hold);
+    RUN_TEST(test_encoder_turns_and_the_bd_switch);
+    RUN_TEST(test_config_button_tap_and_hold);
+    RUN_TEST(test_the_reset_chord_counts_down);
+    RUN_TEST(test_letting_go_cancels_the_reset);
+    RUN_TEST(test_bench_event_stream);
+    return UNITY_END();
+}
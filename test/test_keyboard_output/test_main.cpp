@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "keyboard_output.h"
+
+namespace {
+struct Report {
+    uint8_t bytes[KeyboardOutput::kReportSize];
+};
+
+// Keeps every report instead of handing it to a HID transport
+class RecordingOutput : public KeyboardOutput {
+   public:
+    std::vector<Report> reports;
+
+    const Report &last() const { return reports.back(); }
+
+   protected:
+    void sendReport(const uint8_t *report) override {
+        Report copy;
+        memcpy(copy.bytes, report, sizeof(copy.bytes));
+        reports.push_back(copy);
+    }
+};
+
+const uint8_t kLeftCtrl = 128;
+const uint8_t kLeftShift = 129;
+// Raw HID usages are sent as usage + 136
+const uint8_t kF1 = 136 + 0x3a;
+
+void assertReport(const Report &report, uint8_t modifiers, uint8_t key0,
+                  uint8_t key1 = 0, uint8_t key2 = 0) {
+    const uint8_t expected[KeyboardOutput::kReportSize] = {
+        modifiers, 0, key0, key1, key2, 0, 0, 0};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, report.bytes, sizeof(expected));
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_stage_outside_a_frame_sends_at_once() {
+    RecordingOutput output;
+    output.stagePress('a');
+    TEST_ASSERT_EQUAL(1, output.reports.size());
+    assertReport(output.last(), 0, 0x04);
+    output.stageRelease('a');
+    TEST_ASSERT_EQUAL(2, output.reports.size());
+    assertReport(output.last(), 0, 0);
+}
+
+void test_a_frame_sends_a_chord_as_one_report() {
+    RecordingOutput output;
+    output.beginFrame();
+    output.stagePress(kLeftCtrl);
+    output.stagePress('a');
+    output.stagePress('b');
+    output.stagePress('c');
+    TEST_ASSERT_EQUAL(0, output.reports.size());
+    output.commit();
+    TEST_ASSERT_EQUAL(1, output.reports.size());
+    assertReport(output.last(), 0x01, 0x04, 0x05, 0x06);
+    TEST_ASSERT_EQUAL_UINT32(1, output.reportsSent());
+}
+
+void test_an_unchanged_frame_sends_nothing() {
+    RecordingOutput output;
+    output.beginFrame();
+    output.stageRelease('a');
+    output.commit();
+    output.beginFrame();
+    output.commit();
+    TEST_ASSERT_EQUAL(0, output.reports.size());
+}
+
+void test_key_code_conventions() {
+    RecordingOutput output;
+    output.press('A');  // shifted ASCII
+    assertReport(output.last(), 0x02, 0x04);
+    output.releaseAll();
+    output.press(kLeftShift);
+    assertReport(output.last(), 0x02, 0);
+    output.releaseAll();
+    output.press(kF1);
+    assertReport(output.last(), 0, 0x3a);
+    output.releaseAll();
+    assertReport(output.last(), 0, 0);
+}
+
+void test_a_seventh_key_is_dropped() {
+    RecordingOutput output;
+    output.beginFrame();
+    for (char c = 'a'; c <= 'g'; c++) output.stagePress(c);
+    output.commit();
+    const uint8_t expected[] = {0, 0, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, output.last().bytes, 8);
+    // Its release changes nothing either
+    output.stageRelease('g');
+    TEST_ASSERT_EQUAL(1, output.reports.size());
+}
+
+void test_immediate_calls_flush_what_is_staged() {
+    RecordingOutput output;
+    output.beginFrame();
+    output.stagePress('a');
+    output.write('b');
+    // 'a' went out with the press of 'b', then 'b' was released
+    TEST_ASSERT_EQUAL(2, output.reports.size());
+    assertReport(output.reports[0], 0, 0x04, 0x05);
+    assertReport(output.reports[1], 0, 0x04);
+    output.commit();
+    TEST_ASSERT_EQUAL(2, output.reports.size());
+}
+
+void test_print_types_each_character() {
+    RecordingOutput output;
+    output.print("Hi");
+    TEST_ASSERT_EQUAL(4, output.reports.size());
+    assertReport(output.reports[0], 0x02, 0x0b);
+    assertReport(output.reports[1], 0, 0);
+    assertReport(output.reports[2], 0, 0x0c);
+    assertReport(output.reports[3], 0, 0);
+}
+
+void test_macro_keys_merge_with_held_keys() {
+    RecordingOutput output;
+    output.stagePress('x');
+    output.macroPress(kLeftCtrl);
+    output.macroPress('x');
+    output.macroPress('c');
+    assertReport(output.last(), 0x01, 0x1b, 0x06);
+    // The macro letting go of 'x' leaves the user's 'x' down
+    output.macroRelease('x');
+    assertReport(output.last(), 0x01, 0x1b, 0x06);
+    output.macroReleaseAll();
+    assertReport(output.last(), 0, 0x1b);
+    output.releaseAll();
+    assertReport(output.last(), 0, 0);
+}
+
+void test_release_all_drops_macro_keys_too() {
+    RecordingOutput output;
+    output.macroPress('a');
+    output.releaseAll();
+    output.stagePress('b');
+    assertReport(output.last(), 0, 0x05);
+}
+
+// Another task's key event waits for the open frame's commit instead of
+// splitting it.
+void test_a_frame_holds_off_other_threads() {
+    RecordingOutput output;
+    std::atomic<bool> started(false);
+    output.beginFrame();
+    output.stagePress('a');
+    std::thread other([&] {
+        started = true;
+        output.write('z');
+    });
+    while (!started) std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    TEST_ASSERT_EQUAL(0, output.reports.size());
+    output.stagePress('b');
+    output.commit();
+    other.join();
+
+    TEST_ASSERT_EQUAL(3, output.reports.size());
+    assertReport(output.reports[0], 0, 0x04, 0x05);
+    assertReport(output.reports[1], 0, 0x04, 0x05, 0x1d);
+    assertReport(output.reports[2], 0, 0x04, 0x05);
+}
+
+// Bench: reports for a scan pass that changes a five-key chord, with and
+// without a frame.
+void test_bench_reports_per_chord() {
+    const uint8_t chord[] = {kLeftCtrl, kLeftShift, 'a', 'b', 'c'};
+    RecordingOutput single, batched;
+    for (uint8_t key : chord) single.stagePress(key);
+    batched.beginFrame();
+    for (uint8_t key : chord) batched.stagePress(key);
+    batched.commit();
+
+    char line[64];
+    snprintf(line, sizeof(line), "chord of 5: %u reports unbatched, %u batched",
+             (unsigned)single.reportsSent(), (unsigned)batched.reportsSent());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(5, single.reportsSent());
+    TEST_ASSERT_EQUAL_UINT32(1, batched.reportsSent());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(single.last().bytes, batched.last().bytes,
+                                 KeyboardOutput::kReportSize);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stage_outside_a_frame_sends_at_once);
+    RUN_TEST(test_a_frame_sends_a_chord_as_one_report);
+    RUN_TEST(test_an_unchanged_frame_sends_nothing);
+    RUN_TEST(test_key_code_conventions);
+    RUN_TEST(test_a_seventh_key_is_dropped);
+    RUN_TEST(test_immediate_calls_flush_what_is_staged);
+    RUN_TEST(test_print_types_each_character);
+    RUN_TEST(test_macro_keys_merge_with_held_keys);
+    RUN_TEST(test_release_all_drops_macro_keys_too);
+    RUN_TEST(test_a_frame_holds_off_other_threads);
+    RUN_TEST(test_bench_reports_per_chord);
+    return UNITY_END();
+}
@@ -0,0 +1,411 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "keymap.h"
+#include "label_pool.h"
+#include "layer_stack.h"
+
+namespace {
+const int kLayers = 8;
+
+// One layer's label text: long enough to live on the heap as a String
+std::string labelAt(int layer, int key) {
+    char text[24];
+    snprintf(text, sizeof(text), "Layer %d key %02d", layer, key);
+    return text;
+}
+
+std::string labelRow(int layer, int first, int count) {
+    std::string row = "[";
+    for (int i = 0; i < count; i++) {
+        if (i) row += ",";
+        row += "\"" + labelAt(layer, first + i) + "\"";
+    }
+    return row + "]";
+}
+
+std::string codeRow(int layer, int first, int count) {
+    std::string row = "[";
+    for (int i = 0; i < count; i++) {
+        if (i) row += ",";
+        row += std::to_string(4 + (layer * 40 + first + i) % 96);
+    }
+    return row + "]";
+}
+
+// keyConfig / onBoardRotaryEncoder / rotaryExtension for kLayers layers,
+// every binding with its own key code and label
+std::string fullConfig() {
+    std::string keys, encoders, exts;
+    for (int l = 0; l < kLayers; l++) {
+        std::string keymap = "[", keyInfo = "[";
+        for (int r = 0; r < ROWS; r++) {
+            if (r) keymap += ",", keyInfo += ",";
+            keymap += codeRow(l, r * COLS, COLS);
+            keyInfo += labelRow(l, r * COLS, COLS);
+        }
+        std::string comma = l ? "," : "";
+        keys += comma + "{\"title\":\"Layout " + std::to_string(l) +
+                "\",\"keymap\":" + keymap + "],\"keyInfo\":" + keyInfo +
+                "]}";
+        encoders += comma + "{\"rotaryMap\":" + codeRow(l, 35, 3) +
+                    ",\"rotaryInfo\":" + labelRow(l, 35, 3) + "}";
+        exts += comma + "{\"keymap\":" + codeRow(l, 38, 3) +
+                ",\"keyInfo\":" + labelRow(l, 38, 3) +
+                ",\"rotaryMap\":" + codeRow(l, 41, 3) +
+                ",\"rotaryInfo\":" + labelRow(l, 41, 3) + "}";
+    }
+    return "{\"keyConfig\":[" + keys + "],\"onBoardRotaryEncoder\":[" +
+           encoders + "],\"rotaryExtension\":[" + exts + "]}";
+}
+
+// The keymap as initKeys() kept it before the compiled tables: a String
+// per binding, rebuilt from the document on every layer switch
+struct StringKey {
+    uint8_t keyStroke;
+    String keyInfo;
+    bool state;
+};
+
+struct StringEncoder {
+    StringKey button;
+    uint8_t rotaryCCW;
+    uint8_t rotaryCW;
+    String rotaryCCWInfo;
+    String rotaryCWInfo;
+};
+
+struct StringKeymap {
+    StringKey keys[ROWS][COLS];
+    StringEncoder onboardEncoder;
+    StringKey extKeys[EXT_KEYS];
+    StringEncoder extEncoder;
+};
+
+template <size_t N>
+void copyCodes(JsonVariantConst from, uint8_t (&to)[N]) {
+    for (size_t i = 0; i < N; i++) to[i] = from[i].as<uint8_t>();
+}
+
+template <size_t N>
+void copyLabels(JsonVariantConst from, String (&to)[N]) {
+    for (size_t i = 0; i < N; i++) to[i] = from[i].as<const char *>();
+}
+
+void loadEncoder(JsonVariantConst config, StringEncoder &encoder) {
+    uint8_t rotaryMap[3];
+    String rotaryInfo[3];
+    copyCodes(config["rotaryMap"], rotaryMap);
+    copyLabels(config["rotaryInfo"], rotaryInfo);
+    encoder.button.keyStroke = rotaryMap[0];
+    encoder.button.keyInfo = rotaryInfo[0];
+    encoder.button.state = false;
+    encoder.rotaryCCW = rotaryMap[1];
+    encoder.rotaryCW = rotaryMap[2];
+    encoder.rotaryCCWInfo = rotaryInfo[1];
+    encoder.rotaryCWInfo = rotaryInfo[2];
+}
+
+// The old initKeys() minus its GPIO setup: copy the layer's arrays out of
+// the document into temporaries, then into the keymap
+void switchByJson(JsonVariantConst root, int index, StringKeymap &keymap) {
+    JsonVariantConst config = root["keyConfig"][index];
+    uint8_t keyLayout[ROWS][COLS];
+    String keyInfo[ROWS][COLS];
+    for (int r = 0; r < ROWS; r++) {
+        copyCodes(config["keymap"][r], keyLayout[r]);
+        copyLabels(config["keyInfo"][r], keyInfo[r]);
+    }
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            keymap.keys[r][c].keyStroke = keyLayout[r][c];
+            keymap.keys[r][c].keyInfo = keyInfo[r][c];
+            keymap.keys[r][c].state = false;
+        }
+    }
+
+    loadEncoder(root["onBoardRotaryEncoder"][index], keymap.onboardEncoder);
+
+    JsonVariantConst extension = root["rotaryExtension"][index];
+    uint8_t extKeyLayout[EXT_KEYS];
+    String extKeyInfo[EXT_KEYS];
+    copyCodes(extension["keymap"], extKeyLayout);
+    copyLabels(extension["keyInfo"], extKeyInfo);
+    for (int k = 0; k < EXT_KEYS; k++) {
+        keymap.extKeys[k].keyStroke = extKeyLayout[k];
+        keymap.extKeys[k].keyInfo = extKeyInfo[k];
+        keymap.extKeys[k].state = false;
+    }
+    loadEncoder(extension, keymap.extEncoder);
+}
+
+Keymap::KeyEntry compileKey(JsonVariantConst keyStroke, JsonVariantConst info,
+                            LabelPool &labels) {
+    return {keyStroke.as<uint8_t>(), Keymap::kActionKey, 0,
+            labels.intern(info.as<const char *>())};
+}
+
+Keymap::EncoderEntry compileEncoder(JsonVariantConst config,
+                                    LabelPool &labels) {
+    Keymap::EncoderEntry entry = {};
+    JsonVariantConst map = config["rotaryMap"], info = config["rotaryInfo"];
+    entry.button = compileKey(map[0], info[0], labels);
+    entry.ccw = compileKey(map[1], info[1], labels);
+    entry.cw = compileKey(map[2], info[2], labels);
+    return entry;
+}
+
+// What ConfigStore::compile() does once per load, minus action decoding
+std::vector<Keymap::Layer> compileLayers(JsonVariantConst root,
+                                         LabelPool &labels) {
+    std::vector<Keymap::Layer> layers(root["keyConfig"].size());
+    for (size_t i = 0; i < layers.size(); i++) {
+        Keymap::Layer &layer = layers[i];
+        JsonVariantConst config = root["keyConfig"][i];
+        layer.title = labels.intern(config["title"].as<const char *>());
+        for (int r = 0; r < ROWS; r++) {
+            for (int c = 0; c < COLS; c++) {
+                layer.keys[r][c] = compileKey(
+                    config["keymap"][r][c], config["keyInfo"][r][c], labels);
+            }
+        }
+        layer.onboardEncoder =
+            compileEncoder(root["onBoardRotaryEncoder"][i], labels);
+        JsonVariantConst extension = root["rotaryExtension"][i];
+        for (int k = 0; k < EXT_KEYS; k++) {
+            layer.extKeys[k] = compileKey(extension["keymap"][k],
+                                          extension["keyInfo"][k], labels);
+        }
+        layer.extEncoder = compileEncoder(extension, labels);
+    }
+    return layers;
+}
+
+// What activateLayer() does to the keymap now: repoint the base layer
+struct TableKeymap {
+    const std::vector<Keymap::Layer> *layers;
+    LayerStack stack;
+    const Keymap::Layer *active;
+
+    void activate(int index) {
+        stack.setBase(index);
+        active = &(*layers)[index];
+    }
+};
+
+// Arduino's String::startsWith, on the host String
+bool startsWith(const String &text, const char *prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Where one scan pass sends the 35 keys, and how many label compares it took
+struct PassCounts {
+    uint32_t macros;
+    uint32_t tapToggles;
+    uint32_t keys;
+    uint32_t fn;
+    uint32_t compares;
+};
+
+// One pass of the old loop() body: prefix matching on every cell, pressed
+// or not, and keyPress() / keyRelease() comparing against "FN"
+void passByLabel(StringKey (&keys)[ROWS][COLS], uint64_t down,
+                 PassCounts &counts) {
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            StringKey &key = keys[r][c];
+            if (down >> (r * COLS + c) & 1) {
+                counts.compares++;
+                if (startsWith(key.keyInfo, "MACRO_")) {
+                    counts.macros++;
+                    continue;
+                }
+                counts.compares++;
+                if (startsWith(key.keyInfo, "TT_")) {
+                    counts.tapToggles++;
+                    continue;
+                }
+                counts.compares++;
+                if (key.keyInfo == "FN") counts.fn++;
+                counts.keys++;
+            } else {
+                counts.compares += 2;
+                if (startsWith(key.keyInfo, "TT_")) counts.tapToggles++;
+                if (key.keyInfo == "FN") counts.fn++;
+            }
+        }
+    }
+}
+
+// The same pass on the decoded actions
+void passByAction(const Keymap::Layer &layer, uint64_t down,
+                  PassCounts &counts) {
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            const Keymap::KeyEntry &entry = layer.keys[r][c];
+            bool pressed = down >> (r * COLS + c) & 1;
+            switch (entry.action) {
+                case Keymap::kActionMacro:
+                    if (pressed) counts.macros++;
+                    break;
+                case Keymap::kActionTapToggle:
+                    counts.tapToggles++;
+                    break;
+                case Keymap::kActionFn:
+                    counts.fn++;
+                    if (pressed) counts.keys++;
+                    break;
+                default:
+                    if (pressed) counts.keys++;
+            }
+        }
+    }
+}
+
+template <typename Switch>
+double nsPerSwitch(int switches, Switch switchTo) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < switches; i++) switchTo(i % kLayers);
+    auto took = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(took).count() /
+           switches;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_compiled_layers_match_the_document() {
+    DynamicJsonDocument doc(64 * 1024);
+    TEST_ASSERT_FALSE(deserializeJson(doc, fullConfig()));
+    JsonVariantConst root = doc.as<JsonVariantConst>();
+    LabelPool labels;
+    std::vector<Keymap::Layer> layers = compileLayers(root, labels);
+    TEST_ASSERT_EQUAL(kLayers, layers.size());
+
+    StringKeymap keymap;
+    for (int l = 0; l < kLayers; l++) {
+        switchByJson(root, l, keymap);
+        const Keymap::Layer &layer = layers[l];
+        for (int r = 0; r < ROWS; r++) {
+            for (int c = 0; c < COLS; c++) {
+                TEST_ASSERT_EQUAL(keymap.keys[r][c].keyStroke,
+                                  layer.keys[r][c].keyStroke);
+                TEST_ASSERT_EQUAL_STRING(
+                    keymap.keys[r][c].keyInfo.c_str(),
+                    labels.get(layer.keys[r][c].label));
+            }
+        }
+        for (int k = 0; k < EXT_KEYS; k++) {
+            TEST_ASSERT_EQUAL(keymap.extKeys[k].keyStroke,
+                              layer.extKeys[k].keyStroke);
+            TEST_ASSERT_EQUAL_STRING(keymap.extKeys[k].keyInfo.c_str(),
+                                     labels.get(layer.extKeys[k].label));
+        }
+        TEST_ASSERT_EQUAL(keymap.onboardEncoder.rotaryCW,
+                          layer.onboardEncoder.cw.keyStroke);
+        TEST_ASSERT_EQUAL_STRING(keymap.extEncoder.rotaryCCWInfo.c_str(),
+                                 labels.get(layer.extEncoder.ccw.label));
+    }
+}
+
+// Bench: layer switch latency, re-walking the document into Strings (the
+// old initKeys()) against repointing the compiled table. Host times, so
+// only the ratio carries over to the ESP32.
+void test_bench_layer_switch() {
+    const int kSwitches = 20000;
+    DynamicJsonDocument doc(64 * 1024);
+    TEST_ASSERT_FALSE(deserializeJson(doc, fullConfig()));
+    JsonVariantConst root = doc.as<JsonVariantConst>();
+
+    StringKeymap stringKeymap;
+    double before = nsPerSwitch(kSwitches, [&](int index) {
+        switchByJson(root, index, stringKeymap);
+    });
+
+    LabelPool labels;
+    std::vector<Keymap::Layer> layers = compileLayers(root, labels);
+    TableKeymap tableKeymap = {&layers, LayerStack(), nullptr};
+    volatile uint8_t seen = 0;
+    double after = nsPerSwitch(kSwitches, [&](int index) {
+        tableKeymap.activate(index);
+        seen = tableKeymap.active->keys[index % ROWS][0].keyStroke;
+    });
+
+    char line[96];
+    snprintf(line, sizeof(line),
+             "layer switch: JSON walk %.0f ns, compiled table %.1f ns",
+             before, after);
+    TEST_MESSAGE(line);
+    int last = (kSwitches - 1) % kLayers;
+    TEST_ASSERT_EQUAL(layers[last].keys[last % ROWS][0].keyStroke, seen);
+    TEST_ASSERT_TRUE(after < before);
+}
+
+// Bench: one scan pass over the 35 keys with the action taken from the
+// label on every pass (the old loop()) against the action decoded at load,
+// 2 keys held. Host times; the compare count is what the ESP32 saves.
+void test_bench_scan_pass_dispatch() {
+    const int kPasses = 200000;
+    const uint64_t kDown = (1ULL << 3) | (1ULL << 17);
+    const char *special[] = {"MACRO_0", "TT_1", "FN", "MACRO_2"};
+    StringKey stringKeys[ROWS][COLS];
+    Keymap::Layer layer = {};
+    LabelPool labels;
+    for (int i = 0; i < ROWS * COLS; i++) {
+        std::string text = i % 9 == 3 ? special[i / 9] : labelAt(0, i);
+        StringKey &key = stringKeys[i / COLS][i % COLS];
+        key.keyStroke = 4 + i;
+        key.keyInfo = text.c_str();
+        Keymap::KeyEntry &entry = layer.keys[i / COLS][i % COLS];
+        entry = {(uint8_t)(4 + i), Keymap::kActionKey, 0,
+                 labels.intern(text.c_str())};
+        if (text == "FN") entry.action = Keymap::kActionFn;
+        if (startsWith(key.keyInfo, "TT_")) {
+            entry.action = Keymap::kActionTapToggle;
+        }
+        if (startsWith(key.keyInfo, "MACRO_")) {
+            entry.action = Keymap::kActionMacro;
+        }
+    }
+
+    PassCounts byLabel = {}, byAction = {};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kPasses; i++) passByLabel(stringKeys, kDown, byLabel);
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < kPasses; i++) passByAction(layer, kDown, byAction);
+    auto end = std::chrono::steady_clock::now();
+    double before =
+        std::chrono::duration<double, std::nano>(middle - start).count() /
+        kPasses;
+    double after =
+        std::chrono::duration<double, std::nano>(end - middle).count() /
+        kPasses;
+
+    char line[112];
+    snprintf(line, sizeof(line),
+             "scan pass: label prefixes %.0f ns (%u String compares), "
+             "decoded actions %.0f ns (0)",
+             before, (unsigned)(byLabel.compares / kPasses), after);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(byLabel.macros, byAction.macros);
+    TEST_ASSERT_EQUAL(byLabel.tapToggles, byAction.tapToggles);
+    TEST_ASSERT_EQUAL(byLabel.keys, byAction.keys);
+    TEST_ASSERT_EQUAL(byLabel.fn, byAction.fn);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_compiled_layers_match_the_document);
+    RUN_TEST(test_bench_layer_switch);
+    RUN_TEST(test_bench_scan_pass_dispatch);
+    return UNITY_END();
+}
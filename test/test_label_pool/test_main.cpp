@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <deque>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "display_state.h"
+#include "label_pool.h"
+
+// Heap allocations made while gCounting is set, with their sizes
+static bool gCounting = false;
+static std::vector<size_t> gAllocations;
+
+__attribute__((noinline)) void *operator new(size_t size) {
+    if (gCounting) {
+        gCounting = false;
+        gAllocations.push_back(size);
+        gCounting = true;
+    }
+    void *block = malloc(size ? size : 1);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+__attribute__((noinline)) void operator delete(void *block) noexcept {
+    free(block);
+}
+
+__attribute__((noinline)) void operator delete(void *block,
+                                               size_t) noexcept {
+    free(block);
+}
+
+namespace {
+// First-fit heap with coalescing, standing in for the ESP32's: each block
+// takes the request rounded up to 4 bytes plus an 8-byte header.
+class HeapModel {
+   public:
+    explicit HeapModel(uint32_t capacity) : allocations_(0) {
+        free_[0] = capacity;
+    }
+
+    // Offset of the new block, or -1 when no free block is large enough.
+    long alloc(size_t size) {
+        uint32_t need = ((size + 3) & ~3u) + 8;
+        for (auto it = free_.begin(); it != free_.end(); ++it) {
+            if (it->second < need) continue;
+            uint32_t at = it->first;
+            uint32_t left = it->second - need;
+            free_.erase(it);
+            if (left) free_[at + need] = left;
+            used_[at] = need;
+            allocations_++;
+            return at;
+        }
+        return -1;
+    }
+
+    void release(long at) {
+        if (at < 0) return;
+        uint32_t size = used_[at];
+        used_.erase(at);
+        auto next = free_.insert(std::make_pair((uint32_t)at, size)).first;
+        auto following = std::next(next);
+        if (following != free_.end() &&
+            next->first + next->second == following->first) {
+            next->second += following->second;
+            free_.erase(following);
+        }
+        if (next != free_.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == next->first) {
+                previous->second += next->second;
+                free_.erase(next);
+            }
+        }
+    }
+
+    uint32_t freeBytes() const {
+        uint32_t total = 0;
+        for (auto &block : free_) total += block.second;
+        return total;
+    }
+
+    uint32_t largestFree() const {
+        uint32_t largest = 0;
+        for (auto &block : free_) {
+            if (block.second > largest) largest = block.second;
+        }
+        return largest;
+    }
+
+    // Free blocks other than the largest: holes left between live ones
+    uint32_t holes() const { return free_.empty() ? 0 : free_.size() - 1; }
+
+    uint32_t allocations() const { return allocations_; }
+
+   private:
+    std::map<uint32_t, uint32_t> free_;
+    std::map<uint32_t, uint32_t> used_;
+    uint32_t allocations_;
+};
+
+const int kLayers = 4;
+// A day of use
+const uint32_t kSwitches = 3000;
+const uint32_t kPresses = 40000;
+const int kLabelsPerLayer = 44;  // 35 keys, 3 + 3 encoder, 3 ext keys
+const char *const kLabelNames[] = {
+    "Copy",         "Paste",           "Undo",          "Redo",
+    "Vol+",         "Vol-",            "Mute",          "Play/Pause",
+    "MACRO_0",      "MACRO_1",         "MACRO_12",      "TT_1",
+    "MO_2",         "TG_3",            "Screenshot",    "Screenshot Area",
+    "Toggle Mic Mute", "Next Desktop", "Previous Desktop", "Brush Size+",
+    "Zoom To Fit",  "Lock Screen",     "Terminal",      "Emoji Picker",
+};
+
+std::string labelAt(int layer, int slot) {
+    const int names = sizeof(kLabelNames) / sizeof(*kLabelNames);
+    return kLabelNames[(layer * 7 + slot * 5) % names];
+}
+
+// Arduino String copies keep up to 11 characters inline
+long copyString(HeapModel &heap, const std::string &text, uint32_t &count) {
+    if (text.size() <= 11) return -1;
+    count++;
+    return heap.alloc(text.size() + 1);
+}
+
+uint32_t next(uint32_t &seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+struct DayResult {
+    uint32_t labelAllocations;
+    uint32_t worstHoles;
+    uint32_t holes;
+    uint32_t holeBytes;
+};
+
+// One day: about kSwitches layer switches among kPresses key presses, on a
+// heap that also serves short- and long-lived buffers for everything else
+// (BLE, Wi-Fi, serial), identical for both runs. `oldStrings` replays the
+// String copies the keymap used to make; otherwise nothing is allocated
+// after the load (the pool's own blocks are taken from gAllocations).
+DayResult replayDay(bool oldStrings, const std::vector<size_t> &poolBlocks) {
+    HeapModel heap(160 * 1024);
+    for (size_t size : poolBlocks) heap.alloc(size);
+
+    std::vector<long> keys(kLabelsPerLayer, -1);
+    long display = -1;
+    std::deque<std::pair<uint32_t, long>> buffers;
+    uint32_t seed = 12345;
+    int layer = 0;
+    uint32_t copies = 0;
+    uint32_t worst = heap.holes();
+    for (uint32_t event = 0; event < kPresses; event++) {
+        if (next(seed) % 8 == 0) {
+            buffers.push_back(std::make_pair(
+                event + 1 + next(seed) % 500,
+                heap.alloc(16 + next(seed) % 240)));
+        }
+        if (next(seed) % 400 == 0) heap.alloc(64 + next(seed) % 960);
+        while (!buffers.empty() && buffers.front().first <= event) {
+            heap.release(buffers.front().second);
+            buffers.pop_front();
+        }
+
+        if (event % (kPresses / kSwitches) == 0) {
+            layer = (layer + 1) % kLayers;
+            if (oldStrings) {
+                // initKeys(): copyArray into temporaries, assign, drop them
+                std::vector<long> temps;
+                for (int i = 0; i < kLabelsPerLayer; i++) {
+                    temps.push_back(
+                        copyString(heap, labelAt(layer, i), copies));
+                }
+                for (int i = 0; i < kLabelsPerLayer; i++) {
+                    heap.release(keys[i]);
+                    keys[i] = copyString(heap, labelAt(layer, i), copies);
+                }
+                for (long temp : temps) heap.release(temp);
+            }
+        }
+        if (oldStrings) {
+            // Display::setKeyInfo() kept a String copy of the label
+            heap.release(display);
+            display = copyString(heap, labelAt(layer, event % 35), copies);
+        }
+        if (heap.holes() > worst) worst = heap.holes();
+    }
+    return {copies, worst, heap.holes(),
+            heap.freeBytes() - heap.largestFree()};
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_the_empty_string_is_id_0() {
+    LabelPool labels;
+    TEST_ASSERT_EQUAL(LabelPool::kEmpty, labels.intern(""));
+    TEST_ASSERT_EQUAL(LabelPool::kEmpty, labels.intern(nullptr));
+    TEST_ASSERT_EQUAL_STRING("", labels.get(LabelPool::kEmpty));
+    TEST_ASSERT_EQUAL(1, labels.size());
+}
+
+void test_equal_strings_share_an_id() {
+    LabelPool labels;
+    uint16_t copy = labels.intern("Copy");
+    uint16_t paste = labels.intern("Paste");
+    TEST_ASSERT_NOT_EQUAL(copy, paste);
+    TEST_ASSERT_NOT_EQUAL(LabelPool::kEmpty, copy);
+    // A different buffer with the same text
+    std::string again = "Copy";
+    TEST_ASSERT_EQUAL(copy, labels.intern(again.c_str()));
+    TEST_ASSERT_EQUAL(3, labels.size());
+    TEST_ASSERT_EQUAL_STRING("Copy", labels.get(copy));
+    TEST_ASSERT_EQUAL_STRING("Paste", labels.get(paste));
+}
+
+void test_prefixes_are_distinct_labels() {
+    LabelPool labels;
+    uint16_t longer = labels.intern("Layer 10");
+    uint16_t shorter = labels.intern("Layer 1");
+    TEST_ASSERT_NOT_EQUAL(longer, shorter);
+    TEST_ASSERT_EQUAL_STRING("Layer 1", labels.get(shorter));
+}
+
+void test_unknown_ids_read_as_empty() {
+    LabelPool labels;
+    labels.intern("a");
+    TEST_ASSERT_EQUAL_STRING("", labels.get(2));
+    TEST_ASSERT_EQUAL_STRING("", labels.get(UINT16_MAX));
+}
+
+void test_clear_keeps_only_the_empty_string() {
+    LabelPool labels;
+    uint16_t id = labels.intern("Mute");
+    labels.clear();
+    TEST_ASSERT_EQUAL(1, labels.size());
+    TEST_ASSERT_EQUAL_STRING("", labels.get(id));
+    TEST_ASSERT_EQUAL(id, labels.intern("Vol+"));
+}
+
+void test_a_full_arena_falls_back_to_empty() {
+    LabelPool labels;
+    char text[16];
+    uint16_t last = LabelPool::kEmpty;
+    // 9 bytes per label fill the 64 KB arena after about 7281 labels
+    for (int i = 0; i < 8000; i++) {
+        snprintf(text, sizeof(text), "key %04d", i);
+        uint16_t id = labels.intern(text);
+        if (id == LabelPool::kEmpty) break;
+        last = id;
+    }
+    TEST_ASSERT_TRUE(last > 7000);
+    TEST_ASSERT_EQUAL(LabelPool::kEmpty, labels.intern("one more"));
+    // What is already in the pool still resolves
+    TEST_ASSERT_EQUAL(1, labels.intern("key 0000"));
+    snprintf(text, sizeof(text), "key %04d", last - 1);
+    TEST_ASSERT_EQUAL_STRING(text, labels.get(last));
+}
+
+// Bench: a day of layer switches and key presses with the old per-key
+// String copies against the label pool. Allocation counts for the new path
+// are the real ones (LabelPool, Display); the heap is a model.
+void test_bench_day_of_layer_switches() {
+    std::vector<uint16_t> ids(kLayers * kLabelsPerLayer);
+    std::vector<std::string> texts;
+    for (int layer = 0; layer < kLayers; layer++) {
+        for (int i = 0; i < kLabelsPerLayer; i++) {
+            texts.push_back(labelAt(layer, i));
+        }
+    }
+    // What the pool allocates while a config loads
+    LabelPool pool;
+    gAllocations.clear();
+    gCounting = true;
+    for (size_t i = 0; i < texts.size(); i++) {
+        ids[i] = pool.intern(texts[i].c_str());
+    }
+    gCounting = false;
+    std::vector<size_t> poolBlocks = gAllocations;
+
+    // The new key path: resolve the id, hand the text to the display
+    gAllocations.clear();
+    gCounting = true;
+    char shown[Display::kLineSize];
+    for (uint32_t press = 0; press < kPresses; press++) {
+        int layer = press / (kPresses / kSwitches) % kLayers;
+        Display::setKeyInfo(pool.get(ids[layer * kLabelsPerLayer +
+                                         press % 35]));
+        Display::takeKeyInfo(shown);
+    }
+    gCounting = false;
+    size_t dayAllocations = gAllocations.size();
+
+    DayResult before = replayDay(true, std::vector<size_t>());
+    DayResult after = replayDay(false, poolBlocks);
+    char line[120];
+    snprintf(line, sizeof(line),
+             "label allocations in a day: String copies %u, label pool %u "
+             "(%u at load)",
+             (unsigned)before.labelAllocations,
+             (unsigned)(after.labelAllocations + dayAllocations),
+             (unsigned)poolBlocks.size());
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line),
+             "free holes, day max / at day end: String copies %u / %u "
+             "(%u B), label pool %u / %u (%u B)",
+             (unsigned)before.worstHoles, (unsigned)before.holes,
+             (unsigned)before.holeBytes, (unsigned)after.worstHoles,
+             (unsigned)after.holes, (unsigned)after.holeBytes);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(0, dayAllocations);
+    TEST_ASSERT_EQUAL(0, after.labelAllocations);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_the_empty_string_is_id_0);
+    RUN_TEST(test_equal_strings_share_an_id);
+    RUN_TEST(test_prefixes_are_distinct_labels);
+    RUN_TEST(test_unknown_ids_read_as_empty);
+    RUN_TEST(test_clear_keeps_only_the_empty_string);
+    RUN_TEST(test_a_full_arena_falls_back_to_empty);
+    RUN_TEST(test_bench_day_of_layer_switches);
+    return UNITY_END();
+}
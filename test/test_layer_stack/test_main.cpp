@@ -0,0 +1,174 @@
+#include <string.h>
+#include <unity.h>
+
+#include "layer_stack.h"
+
+namespace {
+using Keymap::KeyEntry;
+
+KeyEntry entry(Keymap::KeyAction action, uint8_t arg = 0,
+               uint8_t keyStroke = 0) {
+    return {keyStroke, action, arg, 0};
+}
+
+KeyEntry momentary(uint8_t layer) {
+    return entry(Keymap::kActionMomentary, layer);
+}
+KeyEntry toggle(uint8_t layer) {
+    return entry(Keymap::kActionToggleLayer, layer);
+}
+KeyEntry oneShot(uint8_t layer) { return entry(Keymap::kActionOneShot, layer); }
+KeyEntry tapToggle(uint8_t layer) {
+    return entry(Keymap::kActionTapToggle, layer);
+}
+
+// Four layers where key (0, 0) types 'a' + layer, except on layer 2 where
+// it is transparent
+Keymap::Layer gLayers[4];
+
+const Keymap::Layer &layerAt(uint8_t index) { return gLayers[index]; }
+
+const KeyEntry &firstKey(const Keymap::Layer &layer) {
+    return layer.keys[0][0];
+}
+
+char resolveFirstKey(const LayerStack &stack) {
+    return stack.resolve(layerAt, firstKey).keyStroke;
+}
+}  // namespace
+
+void setUp() {
+    memset(gLayers, 0, sizeof(gLayers));
+    for (uint8_t i = 0; i < 4; i++) {
+        gLayers[i].keys[0][0] = entry(Keymap::kActionKey, 0, 'a' + i);
+    }
+    gLayers[2].keys[0][0] = entry(Keymap::kActionTransparent);
+}
+
+void tearDown() {}
+
+void test_momentary_lasts_while_held() {
+    LayerStack stack;
+    TEST_ASSERT_TRUE(stack.press(momentary(1), 0));
+    TEST_ASSERT_EQUAL('b', resolveFirstKey(stack));
+    TEST_ASSERT_TRUE(stack.release(momentary(1), 10));
+    TEST_ASSERT_EQUAL('a', resolveFirstKey(stack));
+    TEST_ASSERT_FALSE(stack.release(momentary(1), 20));
+}
+
+void test_transparent_entries_fall_through() {
+    LayerStack stack;
+    stack.setBase(3);
+    stack.press(momentary(1), 0);
+    stack.press(momentary(2), 0);
+    TEST_ASSERT_EQUAL(2, stack.top());
+    TEST_ASSERT_EQUAL(1, stack.resolveLayer(layerAt, firstKey));
+    TEST_ASSERT_EQUAL('b', resolveFirstKey(stack));
+    stack.release(momentary(1), 0);
+    TEST_ASSERT_EQUAL('d', resolveFirstKey(stack));
+}
+
+void test_transparent_on_the_base_stays_transparent() {
+    LayerStack stack;
+    stack.setBase(2);
+    TEST_ASSERT_EQUAL(Keymap::kActionTransparent,
+                      stack.resolve(layerAt, firstKey).action);
+}
+
+void test_toggle_flips_per_press() {
+    LayerStack stack;
+    TEST_ASSERT_TRUE(stack.press(toggle(3), 0));
+    TEST_ASSERT_FALSE(stack.release(toggle(3), 10));
+    TEST_ASSERT_EQUAL('d', resolveFirstKey(stack));
+    TEST_ASSERT_TRUE(stack.press(toggle(3), 20));
+    TEST_ASSERT_EQUAL('a', resolveFirstKey(stack));
+}
+
+void test_one_shot_covers_the_next_key_only() {
+    LayerStack stack;
+    TEST_ASSERT_TRUE(stack.press(oneShot(1), 0));
+    TEST_ASSERT_FALSE(stack.press(oneShot(1), 5));
+    stack.release(oneShot(1), 10);
+    TEST_ASSERT_EQUAL('b', resolveFirstKey(stack));
+    TEST_ASSERT_TRUE(stack.consumeOneShot());
+    TEST_ASSERT_EQUAL('a', resolveFirstKey(stack));
+    TEST_ASSERT_FALSE(stack.consumeOneShot());
+}
+
+void test_one_shot_keeps_other_layers() {
+    LayerStack stack;
+    stack.press(toggle(3), 0);
+    stack.press(oneShot(1), 0);
+    stack.press(momentary(2), 0);
+    stack.consumeOneShot();
+    TEST_ASSERT_EQUAL(2, stack.top());
+    TEST_ASSERT_EQUAL('d', resolveFirstKey(stack));
+}
+
+void test_tap_toggle_is_momentary_when_held() {
+    LayerStack stack;
+    stack.press(tapToggle(1), 0);
+    TEST_ASSERT_EQUAL('b', resolveFirstKey(stack));
+    TEST_ASSERT_TRUE(stack.release(tapToggle(1), 500));
+    TEST_ASSERT_EQUAL('a', resolveFirstKey(stack));
+}
+
+void test_tap_toggle_locks_after_quick_taps() {
+    LayerStack stack;
+    stack.press(tapToggle(1), 0);
+    stack.release(tapToggle(1), 50);
+    stack.press(tapToggle(1), 150);
+    // The second quick tap locks the layer on
+    TEST_ASSERT_FALSE(stack.release(tapToggle(1), 200));
+    TEST_ASSERT_EQUAL('b', resolveFirstKey(stack));
+    // The next press unlocks it; its release changes nothing
+    TEST_ASSERT_TRUE(stack.press(tapToggle(1), 1000));
+    TEST_ASSERT_EQUAL('a', resolveFirstKey(stack));
+    TEST_ASSERT_FALSE(stack.release(tapToggle(1), 1050));
+}
+
+void test_slow_taps_do_not_lock() {
+    LayerStack stack;
+    stack.press(tapToggle(1), 0);
+    stack.release(tapToggle(1), 50);
+    // Gap longer than kTapTermMs
+    stack.press(tapToggle(1), 50 + LayerStack::kTapTermMs + 1);
+    TEST_ASSERT_TRUE(stack.release(tapToggle(1), 400));
+    TEST_ASSERT_EQUAL('a', resolveFirstKey(stack));
+}
+
+void test_the_stack_is_bounded() {
+    LayerStack stack;
+    for (uint8_t i = 0; i < LayerStack::kMaxDepth; i++) {
+        TEST_ASSERT_TRUE(stack.press(momentary(1), 0));
+    }
+    TEST_ASSERT_FALSE(stack.press(momentary(3), 0));
+    TEST_ASSERT_EQUAL(1, stack.top());
+    stack.clear();
+    TEST_ASSERT_EQUAL(stack.base(), stack.top());
+}
+
+void test_only_layer_keys_are_layer_keys() {
+    TEST_ASSERT_TRUE(LayerStack::isLayerKey(momentary(1)));
+    TEST_ASSERT_TRUE(LayerStack::isLayerKey(tapToggle(1)));
+    TEST_ASSERT_FALSE(LayerStack::isLayerKey(entry(Keymap::kActionKey)));
+    TEST_ASSERT_FALSE(LayerStack::isLayerKey(entry(Keymap::kActionModTap)));
+    LayerStack stack;
+    TEST_ASSERT_FALSE(stack.press(entry(Keymap::kActionMacro, 1), 0));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_momentary_lasts_while_held);
+    RUN_TEST(test_transparent_entries_fall_through);
+    RUN_TEST(test_transparent_on_the_base_stays_transparent);
+    RUN_TEST(test_toggle_flips_per_press);
+    RUN_TEST(test_one_shot_covers_the_next_key_only);
+    RUN_TEST(test_one_shot_keeps_other_layers);
+    RUN_TEST(test_tap_toggle_is_momentary_when_held);
+    RUN_TEST(test_tap_toggle_locks_after_quick_taps);
+    RUN_TEST(test_slow_taps_do_not_lock);
+    RUN_TEST(test_the_stack_is_bounded);
+    RUN_TEST(test_only_layer_keys_are_layer_keys);
+    return UNITY_END();
+}
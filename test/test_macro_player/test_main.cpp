@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "macro_player.h"
+
+// MacroPlayer on the host's virtual clock (test/native/freertos/task.h):
+// pauses advance the tick count instead of sleeping, so each test plays a
+// macro back in full and checks what reached the output, and when.
+
+namespace {
+std::vector<std::string> gTimeline;
+
+void record(const char *line) {
+    char stamped[64];
+    snprintf(stamped, sizeof(stamped), "%u %s",
+             (unsigned)xTaskGetTickCount(), line);
+    gTimeline.push_back(stamped);
+}
+
+// Logs "<ms> <modifiers>:<first key>" per report
+class RecordingOutput : public KeyboardOutput {
+   protected:
+    void sendReport(const uint8_t *report) override {
+        char line[16];
+        snprintf(line, sizeof(line), "%02x:%02x", report[0], report[2]);
+        record(line);
+    }
+};
+
+RecordingOutput gOutput;
+
+KeyboardOutput &output() { return gOutput; }
+
+void onLayer(uint8_t index) {
+    char line[16];
+    snprintf(line, sizeof(line), "layer %u", index);
+    record(line);
+}
+
+void playAll(MacroPlayer &player) {
+    while (player.playNext(output, onLayer, 0)) {
+    }
+}
+
+void assertTimeline(const std::vector<std::string> &expected) {
+    TEST_ASSERT_EQUAL(expected.size(), gTimeline.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), gTimeline[i].c_str());
+    }
+}
+
+// Compile one program and queue it the way macroPressByIndex does
+template <typename Emit>
+bool runMacro(MacroPlayer &player, Emit emit) {
+    MacroTable table;
+    LabelPool labels;
+    table.beginProgram(0);
+    emit(table);
+    table.endProgram();
+    const MacroTable::Entry *macro = table.get(0);
+    MacroProgram::run(table.code(*macro), macro->size, labels, player);
+    return player.finish(100);
+}
+
+const uint8_t kLeftCtrl = 128;
+}  // namespace
+
+void setUp() {
+    hostTickCount() = 0;
+    hostNotified() = false;
+    gOutput.releaseAll();
+    gTimeline.clear();
+}
+
+void tearDown() {}
+
+void test_typed_text_keeps_the_inter_key_gap() {
+    MacroPlayer player;
+    player.begin();
+    player.setInterKeyMs(8);
+    player.type("ab");
+    TEST_ASSERT_TRUE(player.finish(100));
+    TEST_ASSERT_TRUE(player.busy());
+    playAll(player);
+    assertTimeline({"0 00:04", "0 00:00", "8 00:05", "8 00:00", "16 00:00"});
+    // The gap after the macro
+    TEST_ASSERT_EQUAL_UINT32(116, xTaskGetTickCount());
+    TEST_ASSERT_FALSE(player.busy());
+}
+
+void test_program_steps_play_in_order() {
+    MacroPlayer player;
+    player.begin();
+    TEST_ASSERT_TRUE(runMacro(player, [](MacroTable &table) {
+        table.emit(MacroProgram::kOpPress);
+        table.emit(kLeftCtrl);
+        table.emit(MacroProgram::kOpDelay);
+        table.emit16(50);
+        table.emit(MacroProgram::kOpTap);
+        table.emit('c');
+        table.emit(MacroProgram::kOpRelease);
+        table.emit(kLeftCtrl);
+        table.emit(MacroProgram::kOpLayer);
+        table.emit(2);
+    }));
+    playAll(player);
+    assertTimeline({"0 01:00", "50 01:06", "50 01:00", "50 00:00", "50 layer 2",
+                    "50 00:00"});
+}
+
+void test_repeat_spaces_its_taps() {
+    MacroPlayer player;
+    player.begin();
+    runMacro(player, [](MacroTable &table) {
+        table.emit(MacroProgram::kOpRepeat);
+        table.emit(3);
+        size_t length = table.mark();
+        table.emit16(0);
+        size_t body = table.mark();
+        table.emit(MacroProgram::kOpTap);
+        table.emit('x');
+        table.emit(MacroProgram::kOpDelay);
+        table.emit16(10);
+        table.patch16(length, table.mark() - body);
+    });
+    playAll(player);
+    assertTimeline({"0 00:1b", "0 00:00", "10 00:1b", "10 00:00", "20 00:1b",
+                    "20 00:00", "30 00:00"});
+}
+
+void test_a_macro_too_long_for_the_queue_still_releases() {
+    MacroPlayer player;
+    player.begin();
+    player.press(kLeftCtrl);
+    std::string text(MacroPlayer::kQueueLength + 100, 'a');
+    player.type(text.c_str());
+    TEST_ASSERT_FALSE(player.finish(100));
+
+    playAll(player);
+    // The press, as many characters as fit, and the closing release
+    size_t writes = MacroPlayer::kQueueLength - MacroPlayer::kFinishEvents - 1;
+    TEST_ASSERT_EQUAL(1 + 2 * writes + 1, gTimeline.size());
+    TEST_ASSERT_EQUAL_STRING("0 01:00", gTimeline[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("0 00:00", gTimeline.back().c_str());
+
+    // The next macro is not cut short
+    player.type("a");
+    TEST_ASSERT_TRUE(player.finish(100));
+}
+
+void test_cancel_between_events_releases_held_keys() {
+    MacroPlayer player;
+    player.begin();
+    runMacro(player, [](MacroTable &table) {
+        table.emit(MacroProgram::kOpPress);
+        table.emit(kLeftCtrl);
+        table.emit(MacroProgram::kOpPress);
+        table.emit('c');
+        table.emit(MacroProgram::kOpDelay);
+        table.emit16(500);
+        table.emit(MacroProgram::kOpReleaseAll);
+    });
+    TEST_ASSERT_TRUE(player.playNext(output, onLayer, 0));
+
+    // A key press cancels the macro while Ctrl is down
+    player.cancel();
+    playAll(player);
+    assertTimeline({"0 01:00", "0 00:00"});
+    TEST_ASSERT_EQUAL_UINT32(0, xTaskGetTickCount());
+    TEST_ASSERT_FALSE(player.busy());
+}
+
+// The key press that cancels a macro is staged by the input task before
+// the macro task plays the cancel; it has to stay down.
+void test_cancel_keeps_the_key_that_cancelled_it() {
+    MacroPlayer player;
+    player.begin();
+    runMacro(player, [](MacroTable &table) {
+        table.emit(MacroProgram::kOpPress);
+        table.emit(kLeftCtrl);
+        table.emit(MacroProgram::kOpDelay);
+        table.emit16(500);
+    });
+    TEST_ASSERT_TRUE(player.playNext(output, onLayer, 0));
+
+    gOutput.beginFrame();
+    gOutput.stagePress('x');
+    player.cancel();
+    gOutput.commit();
+    playAll(player);
+    // Ctrl + x, then x alone once the macro's Ctrl is let go
+    assertTimeline({"0 01:00", "0 01:1b", "0 00:1b"});
+    gOutput.stageRelease('x');
+    TEST_ASSERT_EQUAL_STRING("0 00:00", gTimeline.back().c_str());
+}
+
+void test_cancel_when_idle_does_nothing() {
+    MacroPlayer player;
+    player.begin();
+    player.cancel();
+    TEST_ASSERT_FALSE(player.busy());
+    TEST_ASSERT_FALSE(player.playNext(output, onLayer, 0));
+}
+
+// Bench: virtual playback time of a 100 character string per transport
+// with the default macroDelay.
+void test_bench_typing_time() {
+    std::string text(100, 'k');
+    uint32_t took[2];
+    const uint8_t gaps[2] = {kDefaultMacroDelay.usbMs,
+                             kDefaultMacroDelay.bleMs};
+    for (int i = 0; i < 2; i++) {
+        MacroPlayer player;
+        player.begin();
+        player.setInterKeyMs(gaps[i]);
+        player.type(text.c_str());
+        player.finish(0);
+        hostTickCount() = 0;
+        playAll(player);
+        took[i] = xTaskGetTickCount();
+    }
+    char line[80];
+    snprintf(line, sizeof(line), "100 characters: usb %u ms, ble %u ms",
+             (unsigned)took[0], (unsigned)took[1]);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(100 * kDefaultMacroDelay.usbMs, took[0]);
+    TEST_ASSERT_EQUAL_UINT32(100 * kDefaultMacroDelay.bleMs, took[1]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_typed_text_keeps_the_inter_key_gap);
+    RUN_TEST(test_program_steps_play_in_order);
+    RUN_TEST(test_repeat_spaces_its_taps);
+    RUN_TEST(test_a_macro_too_long_for_the_queue_still_releases);
+    RUN_TEST(test_cancel_between_events_releases_held_keys);
+    RUN_TEST(test_cancel_keeps_the_key_that_cancelled_it);
+    RUN_TEST(test_cancel_when_idle_does_nothing);
+    RUN_TEST(test_bench_typing_time);
+    return UNITY_END();
+}
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "macro_program.h"
+
+namespace {
+// Writes every action as a short line
+class RecordingSink : public MacroProgram::Sink {
+   public:
+    std::vector<std::string> steps;
+
+    void press(uint8_t keyStroke) override { add("press", keyStroke); }
+    void release(uint8_t keyStroke) override { add("release", keyStroke); }
+    void tap(uint8_t keyStroke) override { add("tap", keyStroke); }
+    void releaseAll() override { steps.push_back("releaseAll"); }
+    void pause(uint16_t ms) override { add("pause", ms); }
+    void type(const char *text) override {
+        steps.push_back(std::string("type ") + text);
+    }
+    void layer(uint8_t index) override { add("layer", index); }
+
+   private:
+    void add(const char *name, unsigned arg) {
+        char line[32];
+        snprintf(line, sizeof(line), "%s %u", name, arg);
+        steps.push_back(line);
+    }
+};
+
+void assertSteps(const RecordingSink &sink,
+                 const std::vector<std::string> &expected) {
+    TEST_ASSERT_EQUAL(expected.size(), sink.steps.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), sink.steps[i].c_str());
+    }
+}
+
+bool run(const std::vector<uint8_t> &code, RecordingSink &sink,
+         const LabelPool &labels = LabelPool()) {
+    return MacroProgram::run(code.data(), code.size(), labels, sink);
+}
+
+// kOpRepeat `times` over `body`
+void emitRepeat(std::vector<uint8_t> &code, uint8_t times,
+                const std::vector<uint8_t> &body) {
+    code.push_back(MacroProgram::kOpRepeat);
+    code.push_back(times);
+    code.push_back(body.size() & 0xFF);
+    code.push_back(body.size() >> 8);
+    code.insert(code.end(), body.begin(), body.end());
+}
+}  // namespace
+
+using namespace MacroProgram;
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_every_op_reaches_the_sink() {
+    LabelPool labels;
+    uint16_t hello = labels.intern("hello");
+    // Ctrl down and up, tap 'a', release all, 300 ms, "hello", layer 3
+    std::vector<uint8_t> code = {kOpPress, 128, kOpRelease, 128, kOpTap, 'a',
+                                 kOpReleaseAll, kOpDelay, 0x2c, 0x01, kOpType,
+                                 (uint8_t)hello, 0, kOpLayer, 3};
+    RecordingSink sink;
+    TEST_ASSERT_TRUE(run(code, sink, labels));
+    assertSteps(sink, {"press 128", "release 128", "tap 97", "releaseAll",
+                       "pause 300", "type hello", "layer 3"});
+}
+
+void test_repeat_runs_its_body() {
+    std::vector<uint8_t> code;
+    emitRepeat(code, 3, {kOpTap, 'x'});
+    code.push_back(kOpTap);
+    code.push_back('y');
+    RecordingSink sink;
+    TEST_ASSERT_TRUE(run(code, sink));
+    assertSteps(sink, {"tap 120", "tap 120", "tap 120", "tap 121"});
+}
+
+void test_nested_repeats_multiply() {
+    std::vector<uint8_t> inner, code;
+    emitRepeat(inner, 3, {kOpTap, 'x'});
+    emitRepeat(code, 2, inner);
+    RecordingSink sink;
+    TEST_ASSERT_TRUE(run(code, sink));
+    TEST_ASSERT_EQUAL(6, sink.steps.size());
+}
+
+void test_nesting_past_the_limit_fails() {
+    std::vector<uint8_t> code = {kOpTap, 'x'};
+    for (uint8_t i = 0; i <= kMaxDepth; i++) {
+        std::vector<uint8_t> outer;
+        emitRepeat(outer, 1, code);
+        code = outer;
+    }
+    RecordingSink sink;
+    TEST_ASSERT_FALSE(run(code, sink));
+    TEST_ASSERT_EQUAL(0, sink.steps.size());
+}
+
+void test_truncated_operands_fail_after_the_ops_before() {
+    const std::vector<uint8_t> cut[] = {
+        {kOpTap, 'a', kOpPress},
+        {kOpTap, 'a', kOpDelay, 0x10},
+        {kOpTap, 'a', kOpType, 0x01},
+        {kOpTap, 'a', kOpRepeat, 2, 0x05},
+        // Body longer than what is left
+        {kOpTap, 'a', kOpRepeat, 2, 0x05, 0x00, kOpTap, 'b'},
+    };
+    for (const std::vector<uint8_t> &code : cut) {
+        RecordingSink sink;
+        TEST_ASSERT_FALSE(run(code, sink));
+        assertSteps(sink, {"tap 97"});
+    }
+}
+
+void test_unknown_opcode_fails() {
+    RecordingSink sink;
+    TEST_ASSERT_FALSE(run({kOpTap, 'a', 0xEE, kOpTap, 'b'}, sink));
+    assertSteps(sink, {"tap 97"});
+    TEST_ASSERT_FALSE(run({0}, sink));
+}
+
+void test_empty_program_does_nothing() {
+    RecordingSink sink;
+    TEST_ASSERT_TRUE(run({}, sink));
+    TEST_ASSERT_EQUAL(0, sink.steps.size());
+}
+
+void test_table_keeps_programs_apart() {
+    MacroTable table;
+    table.beginProgram(7);
+    table.emit(kOpTap);
+    table.emit('a');
+    table.endProgram();
+    table.beginProgram(8);
+    table.emit(kOpDelay);
+    table.emit16(500);
+    table.endProgram();
+
+    TEST_ASSERT_EQUAL(2, table.count());
+    TEST_ASSERT_EQUAL(5, table.arenaSize());
+    const MacroTable::Entry *second = table.get(1);
+    TEST_ASSERT_NOT_NULL(second);
+    TEST_ASSERT_EQUAL(2, second->offset);
+    TEST_ASSERT_EQUAL(3, second->size);
+    TEST_ASSERT_EQUAL(8, second->name);
+    TEST_ASSERT_NULL(table.get(2));
+
+    RecordingSink sink;
+    TEST_ASSERT_TRUE(MacroProgram::run(table.code(*second), second->size,
+                                       LabelPool(), sink));
+    assertSteps(sink, {"pause 500"});
+
+    table.clear();
+    TEST_ASSERT_EQUAL(0, table.count());
+    TEST_ASSERT_EQUAL(0, table.arenaSize());
+}
+
+void test_patch16_back_fills_a_length() {
+    MacroTable table;
+    table.beginProgram(0);
+    size_t at = table.mark();
+    table.emit16(0);
+    table.emit(kOpTap);
+    table.patch16(at, 0x1234);
+    table.endProgram();
+    const uint8_t *code = table.code(*table.get(0));
+    TEST_ASSERT_EQUAL_HEX8(0x34, code[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, code[1]);
+}
+
+void test_a_program_past_64_kb_is_dropped_empty() {
+    MacroTable table;
+    table.beginProgram(1);
+    table.emit(kOpTap);
+    table.emit('a');
+    table.endProgram();
+    table.beginProgram(2);
+    for (size_t i = 0; i < 0x10000; i++) table.emit(kOpReleaseAll);
+    table.endProgram();
+
+    TEST_ASSERT_EQUAL(2, table.count());
+    TEST_ASSERT_EQUAL(2, table.arenaSize());
+    TEST_ASSERT_EQUAL(0, table.get(1)->size);
+    TEST_ASSERT_EQUAL(2, table.get(1)->name);
+    // The program before it is untouched
+    TEST_ASSERT_EQUAL(2, table.get(0)->size);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_op_reaches_the_sink);
+    RUN_TEST(test_repeat_runs_its_body);
+    RUN_TEST(test_nested_repeats_multiply);
+    RUN_TEST(test_nesting_past_the_limit_fails);
+    RUN_TEST(test_truncated_operands_fail_after_the_ops_before);
+    RUN_TEST(test_unknown_opcode_fails);
+    RUN_TEST(test_empty_program_does_nothing);
+    RUN_TEST(test_table_keeps_programs_apart);
+    RUN_TEST(test_patch16_back_fills_a_length);
+    RUN_TEST(test_a_program_past_64_kb_is_dropped_empty);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+#include <unity.h>
+
+#include "matrix_scanner.h"
+
+namespace {
+// Fake GPIO: the keys held down, and how often each row was driven
+bool gDown[ROWS][COLS];
+int gRowReads[ROWS];
+
+uint8_t readFakeRow(uint8_t row) {
+    gRowReads[row]++;
+    uint8_t active = 0;
+    for (uint8_t c = 0; c < COLS; c++) {
+        if (gDown[row][c]) active |= 1 << c;
+    }
+    return active;
+}
+
+struct Edge {
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+};
+
+// Edges dispatched for one scan pass against the previous state
+struct Dispatch {
+    Edge edges[ROWS * COLS];
+    int count;
+
+    void scan(const MatrixScanner &scanner, MatrixScanner::State &last) {
+        MatrixScanner::State now = scanner.read();
+        count = 0;
+        forEachKeyChange(now ^ last, now, [this](int row, int col,
+                                                 bool pressed) {
+            edges[count++] = {(uint8_t)row, (uint8_t)col, pressed};
+        });
+        last = now;
+    }
+};
+}  // namespace
+
+void setUp() {
+    memset(gDown, 0, sizeof(gDown));
+    memset(gRowReads, 0, sizeof(gRowReads));
+}
+
+void tearDown() {}
+
+void test_each_key_maps_to_its_bit() {
+    MatrixScanner scanner(readFakeRow);
+    for (uint8_t r = 0; r < ROWS; r++) {
+        for (uint8_t c = 0; c < COLS; c++) {
+            gDown[r][c] = true;
+            TEST_ASSERT_EQUAL_HEX64((MatrixScanner::State)1 << (r * COLS + c),
+                                    scanner.read());
+            gDown[r][c] = false;
+        }
+    }
+}
+
+void test_read_drives_every_row_once() {
+    MatrixScanner scanner(readFakeRow);
+    scanner.read();
+    for (uint8_t r = 0; r < ROWS; r++) {
+        TEST_ASSERT_EQUAL(1, gRowReads[r]);
+    }
+}
+
+void test_unchanged_scan_dispatches_nothing() {
+    MatrixScanner scanner(readFakeRow);
+    MatrixScanner::State last = 0;
+    Dispatch dispatch;
+    gDown[2][3] = true;
+    dispatch.scan(scanner, last);
+    TEST_ASSERT_EQUAL(1, dispatch.count);
+    dispatch.scan(scanner, last);
+    TEST_ASSERT_EQUAL(0, dispatch.count);
+}
+
+void test_only_changed_keys_are_dispatched_in_row_major_order() {
+    MatrixScanner scanner(readFakeRow);
+    MatrixScanner::State last = 0;
+    Dispatch dispatch;
+    gDown[0][6] = true;
+    gDown[4][0] = true;
+    dispatch.scan(scanner, last);
+
+    // One key released, one pressed, one held: two edges
+    gDown[0][6] = false;
+    gDown[1][2] = true;
+    dispatch.scan(scanner, last);
+    TEST_ASSERT_EQUAL(2, dispatch.count);
+    TEST_ASSERT_EQUAL(0, dispatch.edges[0].row);
+    TEST_ASSERT_EQUAL(6, dispatch.edges[0].col);
+    TEST_ASSERT_FALSE(dispatch.edges[0].pressed);
+    TEST_ASSERT_EQUAL(1, dispatch.edges[1].row);
+    TEST_ASSERT_EQUAL(2, dispatch.edges[1].col);
+    TEST_ASSERT_TRUE(dispatch.edges[1].pressed);
+}
+
+void test_full_matrix_press_and_release() {
+    MatrixScanner scanner(readFakeRow);
+    MatrixScanner::State last = 0;
+    Dispatch dispatch;
+    memset(gDown, 1, sizeof(gDown));
+    dispatch.scan(scanner, last);
+    TEST_ASSERT_EQUAL(ROWS * COLS, dispatch.count);
+    for (int i = 0; i < dispatch.count; i++) {
+        TEST_ASSERT_EQUAL(i / COLS, dispatch.edges[i].row);
+        TEST_ASSERT_EQUAL(i % COLS, dispatch.edges[i].col);
+        TEST_ASSERT_TRUE(dispatch.edges[i].pressed);
+    }
+
+    memset(gDown, 0, sizeof(gDown));
+    dispatch.scan(scanner, last);
+    TEST_ASSERT_EQUAL(ROWS * COLS, dispatch.count);
+    TEST_ASSERT_FALSE(dispatch.edges[ROWS * COLS - 1].pressed);
+    TEST_ASSERT_EQUAL_HEX64(0, last);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_each_key_maps_to_its_bit);
+    RUN_TEST(test_read_drives_every_row_once);
+    RUN_TEST(test_unchanged_scan_dispatches_nothing);
+    RUN_TEST(test_only_changed_keys_are_dispatched_in_row_major_order);
+    RUN_TEST(test_full_matrix_press_and_release);
+    return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <chrono>
+#include <vector>
+
+#include "quadrature.h"
+
+namespace {
+// One A/B sample, bits A << 1 | B
+typedef uint8_t Sample;
+
+// The CW quadrature cycle from the detent: AB 11 -> 01 -> 00 -> 10 -> 11
+const Sample kCycle[4] = {0b11, 0b01, 0b00, 0b10};
+
+// Samples for `detents` full cycles from the 11 rest position; negative
+// detents run CCW. With `bounce`, each edge chatters back once before it
+// settles, the way a mechanical contact does.
+std::vector<Sample> waveform(int detents, bool bounce = false) {
+    std::vector<Sample> samples = {kCycle[0]};
+    int position = 0;
+    int direction = detents < 0 ? -1 : 1;
+    for (int i = 0; i < 4 * abs(detents); i++) {
+        Sample before = kCycle[position];
+        position = (position + direction + 4) % 4;
+        if (bounce) {
+            samples.push_back(kCycle[position]);
+            samples.push_back(before);
+        }
+        samples.push_back(kCycle[position]);
+    }
+    return samples;
+}
+
+// Sum of the steps reported for `samples`
+int decode(QuadratureDecoder &decoder, const std::vector<Sample> &samples) {
+    int steps = 0;
+    for (Sample sample : samples) {
+        steps += decoder.update(sample & 2, sample & 1);
+    }
+    return steps;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_full_cycles_count_one_step_each() {
+    QuadratureDecoder decoder(4);
+    TEST_ASSERT_EQUAL(3, decode(decoder, waveform(3)));
+    QuadratureDecoder ccw(4);
+    TEST_ASSERT_EQUAL(-3, decode(ccw, waveform(-3)));
+}
+
+void test_half_step_encoders_count_twice() {
+    QuadratureDecoder decoder(2);
+    TEST_ASSERT_EQUAL(6, decode(decoder, waveform(3)));
+}
+
+void test_the_step_lands_on_the_last_transition() {
+    QuadratureDecoder decoder(4);
+    std::vector<Sample> samples = waveform(1);
+    for (size_t i = 0; i + 1 < samples.size(); i++) {
+        TEST_ASSERT_EQUAL(0, decoder.update(samples[i] & 2, samples[i] & 1));
+    }
+    TEST_ASSERT_EQUAL(1, decoder.update(true, true));
+}
+
+void test_the_first_sample_only_sets_the_state() {
+    QuadratureDecoder decoder(4);
+    // Starting mid-cycle is no movement
+    TEST_ASSERT_EQUAL(0, decoder.update(false, false));
+    TEST_ASSERT_EQUAL(0, decoder.update(false, false));
+}
+
+void test_contact_bounce_cancels_out() {
+    QuadratureDecoder decoder(4);
+    TEST_ASSERT_EQUAL(5, decode(decoder, waveform(5, true)));
+    QuadratureDecoder ccw(4);
+    TEST_ASSERT_EQUAL(-5, decode(ccw, waveform(-5, true)));
+}
+
+void test_a_missed_sample_is_no_movement() {
+    QuadratureDecoder decoder(4);
+    // 11 -> 00 skips 01: both pins changed
+    std::vector<Sample> samples = {0b11, 0b00, 0b10, 0b11};
+    TEST_ASSERT_EQUAL(0, decode(decoder, samples));
+    // The cycle after it still counts
+    TEST_ASSERT_EQUAL(1, decode(decoder, waveform(1)));
+}
+
+void test_turning_back_mid_cycle_emits_nothing() {
+    QuadratureDecoder decoder(4);
+    std::vector<Sample> samples = {0b11, 0b01, 0b00, 0b01, 0b11};
+    TEST_ASSERT_EQUAL(0, decode(decoder, samples));
+    TEST_ASSERT_EQUAL(-1, decode(decoder, waveform(-1)));
+}
+
+void test_accelerator_needs_the_same_direction_fast() {
+    StepAccelerator accelerator;
+    accelerator.isFast(1, 1, 1000, 30);
+    TEST_ASSERT_TRUE(accelerator.isFast(1, 1, 1020, 30));
+    TEST_ASSERT_FALSE(accelerator.isFast(1, 1, 1060, 30));
+    // Reversing is never fast
+    TEST_ASSERT_FALSE(accelerator.isFast(-1, 1, 1065, 30));
+    // Several detents at once get count times the window
+    TEST_ASSERT_TRUE(accelerator.isFast(-1, 3, 1150, 30));
+    // fastMs 0 turns it off
+    TEST_ASSERT_FALSE(accelerator.isFast(-1, 1, 1151, 0));
+}
+
+void test_accelerator_survives_the_16_bit_wrap() {
+    StepAccelerator accelerator;
+    accelerator.isFast(1, 1, 65530, 30);
+    TEST_ASSERT_TRUE(accelerator.isFast(1, 1, 10, 30));
+}
+
+// Bench: decode 10000 bouncing detents each way and time the per-sample
+// cost of update(), which runs in the encoder ISR.
+void test_bench_bouncing_waveform() {
+    const int kDetents = 10000;
+    std::vector<Sample> cw = waveform(kDetents, true);
+    std::vector<Sample> ccw = waveform(-kDetents, true);
+    QuadratureDecoder decoder(4);
+    auto start = std::chrono::steady_clock::now();
+    int forward = decode(decoder, cw);
+    int back = decode(decoder, ccw);
+    auto took = std::chrono::steady_clock::now() - start;
+    double ns = std::chrono::duration<double, std::nano>(took).count() /
+                (cw.size() + ccw.size());
+
+    char line[96];
+    snprintf(line, sizeof(line),
+             "%d detents each way with bounce: %+d / %+d, %.1f ns per sample",
+             kDetents, forward, back, ns);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(kDetents, forward);
+    TEST_ASSERT_EQUAL(-kDetents, back);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_cycles_count_one_step_each);
+    RUN_TEST(test_half_step_encoders_count_twice);
+    RUN_TEST(test_the_step_lands_on_the_last_transition);
+    RUN_TEST(test_the_first_sample_only_sets_the_state);
+    RUN_TEST(test_contact_bounce_cancels_out);
+    RUN_TEST(test_a_missed_sample_is_no_movement);
+    RUN_TEST(test_turning_back_mid_cycle_emits_nothing);
+    RUN_TEST(test_accelerator_needs_the_same_direction_fast);
+    RUN_TEST(test_accelerator_survives_the_16_bit_wrap);
+    RUN_TEST(test_bench_bouncing_waveform);
+    return UNITY_END();
+}
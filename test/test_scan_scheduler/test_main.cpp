@@ -0,0 +1,105 @@
+#include <unity.h>
+
+#include <string>
+
+#include "scan_scheduler.h"
+
+namespace {
+const uint32_t kIdleAfterMs = 1000;
+const uint32_t kIdlePollMs = 50;
+
+// Simulated loop(): one scan pass per character of `trace` ('1' = a key
+// active in that pass), each pass followed by the wait the scheduler asks
+// for (1 ms per active pass, the scan's own cost). Returns the transitions
+// as a string: 'E' enter idle, 'W' wake, '.' no change.
+std::string run(ScanScheduler &scheduler, const std::string &trace,
+                uint32_t &nowMs) {
+    std::string steps;
+    for (size_t i = 0; i < trace.size(); i++) {
+        switch (scheduler.onScan(trace[i] == '1', nowMs)) {
+            case ScanScheduler::kEnterIdle:
+                steps += 'E';
+                break;
+            case ScanScheduler::kWake:
+                steps += 'W';
+                break;
+            default:
+                steps += '.';
+        }
+        uint32_t waitMs = scheduler.waitMs();
+        nowMs += waitMs ? waitMs : 1;
+    }
+    return steps;
+}
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_starts_active_and_scans_back_to_back() {
+    ScanScheduler scheduler(kIdleAfterMs, kIdlePollMs);
+    TEST_ASSERT_EQUAL(ScanScheduler::kActive, scheduler.mode());
+    TEST_ASSERT_EQUAL(0, scheduler.waitMs());
+    TEST_ASSERT_EQUAL(ScanScheduler::kStayActive, scheduler.onScan(false, 0));
+    TEST_ASSERT_EQUAL(0, scheduler.waitMs());
+}
+
+void test_goes_idle_after_quiet_period() {
+    ScanScheduler scheduler(kIdleAfterMs, kIdlePollMs);
+    TEST_ASSERT_EQUAL(ScanScheduler::kStayActive,
+                      scheduler.onScan(true, 5000));
+    TEST_ASSERT_EQUAL(ScanScheduler::kStayActive,
+                      scheduler.onScan(false, 5999));
+    TEST_ASSERT_EQUAL(ScanScheduler::kEnterIdle,
+                      scheduler.onScan(false, 6000));
+    TEST_ASSERT_EQUAL(ScanScheduler::kIdle, scheduler.mode());
+    TEST_ASSERT_EQUAL(kIdlePollMs, scheduler.waitMs());
+}
+
+void test_enters_idle_once_and_stays() {
+    ScanScheduler scheduler(kIdleAfterMs, kIdlePollMs);
+    uint32_t nowMs = 0;
+    // 1000 quiet 1 ms passes, then 50 ms polls: one entry, no re-entries
+    std::string steps = run(scheduler, std::string(1010, '0'), nowMs);
+    TEST_ASSERT_EQUAL_STRING((std::string(1000, '.') + "E" +
+                              std::string(9, '.')).c_str(),
+                             steps.c_str());
+    TEST_ASSERT_EQUAL(1000 + 10 * kIdlePollMs, nowMs);
+}
+
+void test_activity_wakes_and_restarts_the_quiet_period() {
+    ScanScheduler scheduler(kIdleAfterMs, kIdlePollMs);
+    uint32_t nowMs = 0;
+    run(scheduler, std::string(1001, '0'), nowMs);
+    TEST_ASSERT_EQUAL(ScanScheduler::kIdle, scheduler.mode());
+
+    // A key press wakes it; held keys keep it active; the quiet period
+    // counts from the last active pass, not from the wake.
+    std::string steps = run(scheduler, "111" + std::string(999, '0'), nowMs);
+    TEST_ASSERT_EQUAL('W', steps[0]);
+    TEST_ASSERT_EQUAL(std::string::npos, steps.find('E'));
+    TEST_ASSERT_EQUAL(ScanScheduler::kActive, scheduler.mode());
+    TEST_ASSERT_EQUAL(0, scheduler.waitMs());
+
+    TEST_ASSERT_EQUAL_STRING("E", run(scheduler, "0", nowMs).c_str());
+}
+
+void test_quiet_period_survives_clock_wrap() {
+    ScanScheduler scheduler(kIdleAfterMs, kIdlePollMs);
+    uint32_t start = UINT32_MAX - 100;
+    scheduler.onScan(true, start);
+    TEST_ASSERT_EQUAL(ScanScheduler::kStayActive,
+                      scheduler.onScan(false, start + 999));
+    TEST_ASSERT_EQUAL(ScanScheduler::kEnterIdle,
+                      scheduler.onScan(false, start + 1000));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_active_and_scans_back_to_back);
+    RUN_TEST(test_goes_idle_after_quiet_period);
+    RUN_TEST(test_enters_idle_once_and_stays);
+    RUN_TEST(test_activity_wakes_and_restarts_the_quiet_period);
+    RUN_TEST(test_quiet_period_survives_clock_wrap);
+    return UNITY_END();
+}
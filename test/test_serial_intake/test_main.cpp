@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "serial_intake.h"
+
+namespace {
+// Keeps commands, and uploads reassembled from their pieces
+class RecordingSink : public SerialIntake::Sink {
+   public:
+    std::vector<std::string> commands;
+    std::vector<std::string> uploads;
+    std::vector<bool> complete;
+    size_t pieces = 0;
+    bool open = false;
+
+    void command(const char *line) override { commands.push_back(line); }
+    void jsonBegin() override {
+        TEST_ASSERT_FALSE(open);
+        open = true;
+        uploads.push_back("");
+    }
+    void jsonData(const uint8_t *data, size_t size) override {
+        TEST_ASSERT_TRUE(open);
+        uploads.back().append((const char *)data, size);
+        pieces++;
+    }
+    void jsonEnd(bool done) override {
+        TEST_ASSERT_TRUE(open);
+        open = false;
+        complete.push_back(done);
+    }
+};
+
+void feed(SerialIntake &intake, const std::string &text, uint32_t nowMs) {
+    intake.feed((const uint8_t *)text.data(), text.size(), nowMs);
+}
+
+// Feed `text` in `chunk` byte pieces, all at nowMs
+void feedChunked(SerialIntake &intake, const std::string &text, size_t chunk,
+                 uint32_t nowMs) {
+    for (size_t at = 0; at < text.size(); at += chunk) {
+        feed(intake, text.substr(at, chunk), nowMs);
+    }
+}
+
+const char *const kPrettyConfig =
+    "{\n"
+    "  \"layouts\": [\n"
+    "    {\"title\": \"braces } and ] in a string\",\n"
+    "     \"keyInfo\": [\"quote \\\" and \\\\\", \"{\"]}\n"
+    "  ]\n"
+    "}";
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_commands_end_at_a_newline() {
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    feed(intake, "READ_CONFIG\r\n  WRITE_WIFI{\"ssid\":\"x\"}  \n", 0);
+    TEST_ASSERT_EQUAL(2, sink.commands.size());
+    TEST_ASSERT_EQUAL_STRING("READ_CONFIG", sink.commands[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("WRITE_WIFI{\"ssid\":\"x\"}",
+                             sink.commands[1].c_str());
+    TEST_ASSERT_EQUAL(0, sink.uploads.size());
+}
+
+void test_a_bare_command_ends_when_the_line_goes_quiet() {
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    feed(intake, "READ_", 0);
+    feed(intake, "CONFIG", 50);
+    intake.poll(50 + SerialIntake::kIdleMs - 1);
+    TEST_ASSERT_EQUAL(0, sink.commands.size());
+    intake.poll(50 + SerialIntake::kIdleMs);
+    TEST_ASSERT_EQUAL(1, sink.commands.size());
+    TEST_ASSERT_EQUAL_STRING("READ_CONFIG", sink.commands[0].c_str());
+}
+
+void test_an_overlong_command_is_dropped_whole() {
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    feed(intake, std::string(SerialIntake::kLineSize + 10, 'x') + "\nOK\n", 0);
+    TEST_ASSERT_EQUAL(1, sink.commands.size());
+    TEST_ASSERT_EQUAL_STRING("OK", sink.commands[0].c_str());
+}
+
+void test_an_upload_ends_when_its_braces_balance() {
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    feed(intake, std::string("\r\n") + kPrettyConfig + "\nREAD_CONFIG\n", 0);
+    TEST_ASSERT_EQUAL(1, sink.uploads.size());
+    TEST_ASSERT_EQUAL_STRING(kPrettyConfig, sink.uploads[0].c_str());
+    TEST_ASSERT_TRUE(sink.complete[0]);
+    TEST_ASSERT_EQUAL(1, sink.commands.size());
+    TEST_ASSERT_EQUAL_STRING("READ_CONFIG", sink.commands[0].c_str());
+}
+
+void test_any_split_gives_the_same_upload() {
+    for (size_t chunk = 1; chunk <= strlen(kPrettyConfig); chunk++) {
+        RecordingSink sink;
+        SerialIntake intake(sink);
+        feedChunked(intake, kPrettyConfig, chunk, 0);
+        TEST_ASSERT_EQUAL(1, sink.complete.size());
+        TEST_ASSERT_EQUAL_STRING(kPrettyConfig, sink.uploads[0].c_str());
+    }
+}
+
+void test_a_stalled_upload_is_abandoned() {
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    feed(intake, "{\"layouts\": [", 0);
+    intake.poll(SerialIntake::kStallMs - 1);
+    TEST_ASSERT_TRUE(sink.open);
+    intake.poll(SerialIntake::kStallMs);
+    TEST_ASSERT_FALSE(sink.open);
+    TEST_ASSERT_FALSE(sink.complete[0]);
+    // The port is back to commands
+    feed(intake, "READ_CONFIG\n", SerialIntake::kStallMs + 10);
+    TEST_ASSERT_EQUAL(1, sink.commands.size());
+}
+
+void test_blank_lines_are_not_commands() {
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    feed(intake, "\n\r\n   \n", 0);
+    intake.poll(1000);
+    TEST_ASSERT_EQUAL(0, sink.commands.size());
+}
+
+// Bench: a 64 KB pretty-printed upload fed in 64-byte UART reads. Reports
+// the pieces handed on and the host-side scan rate.
+void test_bench_large_upload() {
+    std::string config = "{\"layouts\": [\n";
+    while (config.size() < 64 * 1024) {
+        config += "  {\"title\": \"Layer {x}\", ";
+        config += "\"keyInfo\": [\"a\", \"b\"]},\n";
+    }
+    config += "  {}\n]}";
+    RecordingSink sink;
+    SerialIntake intake(sink);
+    auto start = std::chrono::steady_clock::now();
+    feedChunked(intake, config, 64, 0);
+    auto took = std::chrono::steady_clock::now() - start;
+    double mbs = config.size() /
+                 std::chrono::duration<double, std::micro>(took).count();
+
+    char line[96];
+    snprintf(line, sizeof(line), "%u byte upload: %u pieces, %.0f MB/s",
+             (unsigned)config.size(), (unsigned)sink.pieces, mbs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(1, sink.complete.size());
+    TEST_ASSERT_TRUE(sink.complete[0]);
+    TEST_ASSERT_TRUE(sink.uploads[0] == config);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_end_at_a_newline);
+    RUN_TEST(test_a_bare_command_ends_when_the_line_goes_quiet);
+    RUN_TEST(test_an_overlong_command_is_dropped_whole);
+    RUN_TEST(test_an_upload_ends_when_its_braces_balance);
+    RUN_TEST(test_any_split_gives_the_same_upload);
+    RUN_TEST(test_a_stalled_upload_is_abandoned);
+    RUN_TEST(test_blank_lines_are_not_commands);
+    RUN_TEST(test_bench_large_upload);
+    return UNITY_END();
+}
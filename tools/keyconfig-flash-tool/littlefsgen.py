@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+#
+# Build a LittleFS image of a directory for the keypad's data partition.
+#
+# The geometry matches what PlatformIO's mklittlefs produces for ESP32
+# (4096 byte blocks, 256 byte pages) and what the Arduino LittleFS driver
+# mounts: file names up to 64 characters, on-disk format 2.0.
+#
+#   python3 littlefsgen.py 0x1E0000 ./data littlefs.bin
+#
+# Needs littlefs-python (pip install littlefs-python).
+#
+import argparse
+import os
+import sys
+
+try:
+    from littlefs import LittleFS
+except ImportError:
+    sys.exit("littlefs-python is required: pip install littlefs-python")
+
+BLOCK_SIZE = 4096
+PAGE_SIZE = 256
+NAME_MAX = 64
+DISK_VERSION = 0x00020000
+
+
+def build(image_size, base_dir):
+    fs = LittleFS(block_size=BLOCK_SIZE,
+                  block_count=image_size // BLOCK_SIZE,
+                  read_size=PAGE_SIZE,
+                  prog_size=PAGE_SIZE,
+                  name_max=NAME_MAX,
+                  disk_version=DISK_VERSION)
+    for root, dirs, files in os.walk(base_dir):
+        relative = os.path.relpath(root, base_dir)
+        target = "" if relative == "." else "/" + relative.replace(os.sep, "/")
+        for name in sorted(dirs):
+            fs.makedirs(target + "/" + name, exist_ok=True)
+        for name in sorted(files):
+            with open(os.path.join(root, name), "rb") as source:
+                data = source.read()
+            with fs.open(target + "/" + name, "wb") as out:
+                out.write(data)
+            print("  %s/%s (%d bytes)" % (target, name, len(data)))
+    return bytes(fs.context.buffer)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Build a LittleFS image for the keypad.")
+    parser.add_argument("image_size",
+                        help="data partition size, e.g. 0x1E0000")
+    parser.add_argument("base_dir", help="directory to put in the image")
+    parser.add_argument("output_file", help="image file to write")
+    args = parser.parse_args()
+
+    image_size = int(args.image_size, 0)
+    if image_size % BLOCK_SIZE:
+        sys.exit("image size must be a multiple of %d" % BLOCK_SIZE)
+    image = build(image_size, args.base_dir)
+    with open(args.output_file, "wb") as out:
+        out.write(image)
+
+
+if __name__ == "__main__":
+    main()
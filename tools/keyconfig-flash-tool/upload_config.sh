@@ -1,6 +1,6 @@
 #!/bin/bash
 # This script reads keyconfig.json file from ./data directory
-# It creates an SPIFFS image and flash it to selected ESP32 device
+# It creates a LittleFS image and flash it to selected ESP32-S3 device
 
 # Renders a text based list of options that can be selected by the
 # user using up, down and enter keys and returns the chosen option.
@@ -75,16 +75,17 @@ function main() {
     shopt -u nullglob # Turn off nullglob to make sure it doesn't interfere with anything later
 
     # Target device selection
-    echo "Select a target device to flash SPIFFS: "
+    echo "Select a target device to flash LittleFS: "
     echo
     select_option "${deviceList[@]}"
     choice=$?
     device="${deviceList[$choice]}"
     echo "Selected device: $device"
 
-    # Generate SPIFFS image and flash it to target ESP32 device
-    python3 ./spiffsgen.py 0x170000  ./data spiffs.bin 
-    python3 ./esptool.py --chip esp32 --port $device --baud 460800 write_flash --flash_mode dio --flash_size 4MB 0x00290000 spiffs.bin
+    # Generate LittleFS image and flash it to the data partition of the
+    # no-OTA layout (0x210000, 0x1E0000 bytes)
+    python3 ./littlefsgen.py 0x1E0000 ./data littlefs.bin
+    python3 ./esptool.py --chip esp32s3 --port $device --baud 460800 write_flash --flash_mode dio --flash_size 4MB 0x210000 littlefs.bin
 }
 
 main
\ No newline at end of file